@@ -11,7 +11,7 @@ R_CallMethodDef calledMethods[] = {
 	{"SXP_get_group_data", (DL_FUNC) &SXP_get_group_data, 3},	
 	{"SXP_get_groups", (DL_FUNC) &SXP_get_groups, 1},	
 	{"SXP_group_eval", (DL_FUNC) &SXP_group_eval, 2},	
-	{"SXP_one_cross", (DL_FUNC) &SXP_one_cross, 13},	
+	{"SXP_one_cross", (DL_FUNC) &SXP_one_cross, 15},	
 	{"SXP_save_GEBVs", (DL_FUNC) &SXP_save_GEBVs, 3},	
 	{"SXP_save_chrsplit_block_effects", (DL_FUNC) &SXP_save_chrsplit_block_effects, 4},
 	{"SXP_save_counts", (DL_FUNC) &SXP_save_counts, 4},	
@@ -19,23 +19,27 @@ R_CallMethodDef calledMethods[] = {
 	{"SXP_save_genotypes", (DL_FUNC) &SXP_save_genotypes, 4},	
 	{"SXP_save_pedigrees", (DL_FUNC) &SXP_save_pedigrees, 4},	
 	{"SXP_save_simdata", (DL_FUNC) &SXP_save_simdata, 2},	
-	{"SXP_selfing", (DL_FUNC) &SXP_selfing, 14},	
+	{"SXP_save_snapshot", (DL_FUNC) &SXP_save_snapshot, 2},
+	{"SXP_selfing", (DL_FUNC) &SXP_selfing, 16},	
 	{"SXP_simple_selection", (DL_FUNC) &SXP_simple_selection, 5},	
 	{"SXP_simple_selection_bypercent", (DL_FUNC) &SXP_simple_selection_bypercent, 5},	
 	{"SXP_split_familywise", (DL_FUNC) &SXP_split_familywise, 2},	
 	{"SXP_split_individuals", (DL_FUNC) &SXP_split_individuals, 2},	
 	{"SXP_split_out", (DL_FUNC) &SXP_split_out, 3},	
-	{"SXP_cross_combinations", (DL_FUNC) &SXP_cross_combinations, 12},
-	{"SXP_cross_randomly", (DL_FUNC) &SXP_cross_randomly, 14},
-	{"SXP_cross_Rcombinations", (DL_FUNC) &SXP_cross_Rcombinations, 13},
-	{"SXP_cross_unidirectional", (DL_FUNC) &SXP_cross_unidirectional, 13},
-	{"SXP_dcross_combinations", (DL_FUNC) &SXP_dcross_combinations, 12},
-	{"SXP_doubled", (DL_FUNC) &SXP_doubled, 13},
+	{"SXP_cross_combinations", (DL_FUNC) &SXP_cross_combinations, 14},
+	{"SXP_cross_randomly", (DL_FUNC) &SXP_cross_randomly, 16},
+	{"SXP_cross_Rcombinations", (DL_FUNC) &SXP_cross_Rcombinations, 15},
+	{"SXP_cross_unidirectional", (DL_FUNC) &SXP_cross_unidirectional, 15},
+	{"SXP_dcross_combinations", (DL_FUNC) &SXP_dcross_combinations, 14},
+	{"SXP_doubled", (DL_FUNC) &SXP_doubled, 15},
 	{"SXP_find_crossovers", (DL_FUNC) &SXP_find_crossovers, 5},
-	{"SXP_load_data", (DL_FUNC) &SXP_load_data, 2},
-	{"SXP_load_data_weff", (DL_FUNC) &SXP_load_data_weff, 3},
-	{"SXP_load_more_genotypes", (DL_FUNC) &SXP_load_more_genotypes, 2},
+	{"SXP_load_data", (DL_FUNC) &SXP_load_data, 6},
+	{"SXP_load_data_weff", (DL_FUNC) &SXP_load_data_weff, 7},
+	{"SXP_load_from_matrix", (DL_FUNC) &SXP_load_from_matrix, 7},
+	{"SXP_load_more_genotypes", (DL_FUNC) &SXP_load_more_genotypes, 4},
 	{"SXP_load_new_effects", (DL_FUNC) &SXP_load_new_effects, 2},
+	{"SXP_load_pedigrees", (DL_FUNC) &SXP_load_pedigrees, 2},
+	{"SXP_load_snapshot", (DL_FUNC) &SXP_load_snapshot, 1},
 	{"SXP_send_map", (DL_FUNC) &SXP_send_map, 1},
 	{NULL}
 };
@@ -2,11 +2,55 @@
 
 /*-------------------------- Loaders -------------------------*/
 
-SEXP SXP_load_data(SEXP alleleFile, SEXP mapFile) {
+/* Check if a genotype file is a VCF, compressed or not. */
+static int is_vcf_file(const char* filename) {
+	return has_file_extension(filename, ".vcf") || has_file_extension(filename, ".vcf.gz");
+}
+
+/* Check the genotype and map file parameters of the load.data functions, 
+ * before anything is allocated. */
+static void check_data_files(SEXP alleleFile, SEXP mapFile) {
+	const char* allele_file = CHAR(asChar(alleleFile));
+	if (isNull(mapFile) && !has_file_extension(allele_file, ".bed") && !is_vcf_file(allele_file)) {
+		error("A `map.file` is needed unless the genotypes are a PLINK .bed file or a VCF.\n");
+	}
+}
+
+/* Load genotypes and a map for the load.data functions. A genotype file ending
+ * in .bed is loaded as a PLINK fileset, and one ending in .vcf or .vcf.gz as
+ * a VCF. Both also supply the map if there is no map file. Otherwise the 
+ * genotype file is a table, transposed or individual-major. */
+static void load_data_files(SimData* d, SEXP alleleFile, SEXP mapFile, SEXP transposed) {
+	const char* allele_file = CHAR(asChar(alleleFile));
+	if (is_vcf_file(allele_file)) {
+		load_vcf_to_simdata(d, allele_file, isNull(mapFile) ? NULL : CHAR(asChar(mapFile)));
+		return;
+	} else if (has_file_extension(allele_file, ".bed")) {
+		load_plink_genes_to_simdata(d, allele_file);
+		if (isNull(mapFile)) {
+			load_plink_map_to_simdata(d, allele_file);
+			return;
+		}
+	} else if (asLogical(transposed)) {
+		load_transposed_genes_to_simdata(d, allele_file);
+	} else {
+		load_genes_to_simdata(d, allele_file);
+	}
+	load_genmap_to_simdata(d, CHAR(asChar(mapFile)));
+}
+
+SEXP SXP_load_data(SEXP alleleFile, SEXP mapFile, SEXP packed, SEXP threads, SEXP transposed, SEXP blockSize) {
+	int n_threads = asInteger(threads);
+	if (n_threads == NA_INTEGER || n_threads < 1) { error("`threads` parameter is invalid.\n"); }
+	int block_size = asInteger(blockSize);
+	if (block_size == NA_INTEGER || block_size < 1) { error("`block.size` parameter is invalid.\n"); }
+	check_data_files(alleleFile, mapFile);
 	SimData* d = create_empty_simdata();
+	d->packed_alleles = asLogical(packed);
+	d->n_threads = n_threads;
+	d->block_capacity = block_size;
 	//d->current_id = 0; // reset ID counts
-	load_transposed_genes_to_simdata(d, CHAR(asChar(alleleFile)));
-	load_genmap_to_simdata(d, CHAR(asChar(mapFile)));
+	load_data_files(d, alleleFile, mapFile, transposed);
 	
 	get_sorted_markers(d, d->n_markers);
 	get_chromosome_locations(d);
@@ -17,11 +61,18 @@ SEXP SXP_load_data(SEXP alleleFile, SEXP mapFile) {
 	return sdptr;
 }
 
-SEXP SXP_load_data_weff(SEXP alleleFile, SEXP mapFile, SEXP effectFile) {
+SEXP SXP_load_data_weff(SEXP alleleFile, SEXP mapFile, SEXP effectFile, SEXP packed, SEXP threads, SEXP transposed, SEXP blockSize) {
+	int n_threads = asInteger(threads);
+	if (n_threads == NA_INTEGER || n_threads < 1) { error("`threads` parameter is invalid.\n"); }
+	int block_size = asInteger(blockSize);
+	if (block_size == NA_INTEGER || block_size < 1) { error("`block.size` parameter is invalid.\n"); }
+	check_data_files(alleleFile, mapFile);
 	SimData* d = create_empty_simdata();
+	d->packed_alleles = asLogical(packed);
+	d->n_threads = n_threads;
+	d->block_capacity = block_size;
 	//d->current_id = 0; // reset ID counts
-	load_transposed_genes_to_simdata(d, CHAR(asChar(alleleFile)));
-	load_genmap_to_simdata(d, CHAR(asChar(mapFile)));
+	load_data_files(d, alleleFile, mapFile, transposed);
 	load_effects_to_simdata(d, CHAR(asChar(effectFile)));
 
 	get_sorted_markers(d, d->n_markers);
@@ -33,8 +84,121 @@ SEXP SXP_load_data_weff(SEXP alleleFile, SEXP mapFile, SEXP effectFile) {
 	return sdptr;
 }
 
-SEXP SXP_load_more_genotypes(SEXP exd, SEXP alleleFile) {
+SEXP SXP_load_snapshot(SEXP filename) {
+	// the finalizer is registered first so that a SimData left partly filled
+	// by an invalid snapshot is still freed.
+	SimData* d = create_empty_simdata();
+	SEXP sdptr = PROTECT(R_MakeExternalPtr((void*) d, R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(sdptr, SXP_delete_simdata, 1);
+	
+	load_simdata_snapshot(d, CHAR(asChar(filename)));
+	UNPROTECT(1);
+	return sdptr;
+}
+
+SEXP SXP_load_pedigrees(SEXP exd, SEXP filename) {
+	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
+	return ScalarInteger(load_binary_pedigree_to_simdata(d, CHAR(asChar(filename))));
+}
+
+/* Get the strings of a character vector as C strings that point into R's 
+ * memory, with NA as NULL. The array is freed by R at the end of the .Call. */
+static const char** get_string_pointers(SEXP strings) {
+	R_xlen_t n = xlength(strings);
+	const char** out = (const char**) R_alloc(n > 0 ? n : 1, sizeof(char*));
+	for (R_xlen_t i = 0; i < n; ++i) {
+		SEXP s = STRING_ELT(strings, i);
+		out[i] = s == NA_STRING ? NULL : CHAR(s);
+	}
+	return out;
+}
+
+/* Get the first character of each string of a character vector. */
+static const char* get_string_initials(SEXP strings) {
+	R_xlen_t n = xlength(strings);
+	char* out = R_alloc(n > 0 ? n : 1, sizeof(char));
+	for (R_xlen_t i = 0; i < n; ++i) {
+		SEXP s = STRING_ELT(strings, i);
+		out[i] = s == NA_STRING ? '\0' : CHAR(s)[0];
+	}
+	return out;
+}
+
+/* Fill the genotypes of a SimData from a character matrix of allele pairs with 
+ * a row per marker. The pairs are passed on a tile of genotypes at a time, as 
+ * pointers into R's strings. Returns the number of cells that were not pairs. */
+static int load_pair_matrix(SimData* d, SEXP genotypes, int n_genotypes) {
+	const int genotypes_per_tile = 256;
+	const char** pairs = (const char**) R_alloc((size_t) d->n_markers * genotypes_per_tile, sizeof(char*));
+	int bad_cells = 0;
+	for (int tile = 0; tile < n_genotypes; tile += genotypes_per_tile) {
+		R_CheckUserInterrupt();
+		int tile_size = n_genotypes - tile < genotypes_per_tile ? n_genotypes - tile : genotypes_per_tile;
+		R_xlen_t offset = (R_xlen_t) tile * d->n_markers;
+		for (R_xlen_t k = 0; k < (R_xlen_t) tile_size * d->n_markers; ++k) {
+			SEXP s = STRING_ELT(genotypes, offset + k);
+			pairs[k] = s == NA_STRING ? NULL : CHAR(s);
+		}
+		bad_cells += load_pairs_to_simdata(d, tile, tile_size, pairs);
+	}
+	return bad_cells;
+}
+
+SEXP SXP_load_from_matrix(SEXP genotypes, SEXP alleles, SEXP map, SEXP effects, SEXP packed, SEXP threads, SEXP blockSize) {
+	int n_threads = asInteger(threads);
+	if (n_threads == NA_INTEGER || n_threads < 1) { error("`threads` parameter is invalid.\n"); }
+	int block_size = asInteger(blockSize);
+	if (block_size == NA_INTEGER || block_size < 1) { error("`block.size` parameter is invalid.\n"); }
+	if (!isMatrix(genotypes) || !(isString(genotypes) || isInteger(genotypes))) {
+		error("`genotypes` must be a character or integer matrix.\n");
+	}
+	int n_markers = INTEGER(getAttrib(genotypes, R_DimSymbol))[0];
+	int n_genotypes = INTEGER(getAttrib(genotypes, R_DimSymbol))[1];
+	SEXP dimnames = getAttrib(genotypes, R_DimNamesSymbol);
+	if (n_markers < 1 || n_genotypes < 1) { error("`genotypes` is empty.\n"); }
+	if (isNull(dimnames) || isNull(VECTOR_ELT(dimnames, 0))) {
+		error("The rows of `genotypes` must be named after their markers.\n");
+	}
+	
+	SimData* d = create_empty_simdata();
+	d->packed_alleles = asLogical(packed);
+	d->n_threads = n_threads;
+	d->block_capacity = block_size;
+	create_genotypes_in_simdata(d, n_markers, get_string_pointers(VECTOR_ELT(dimnames, 0)), n_genotypes, 
+			isNull(VECTOR_ELT(dimnames, 1)) ? NULL : get_string_pointers(VECTOR_ELT(dimnames, 1)));
+	if (isString(genotypes)) {
+		int bad_cells = load_pair_matrix(d, genotypes, n_genotypes);
+		Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles could not be loaded\n", n_genotypes, n_markers, bad_cells);
+	} else {
+		int n_missing = load_dosages_to_simdata(d, INTEGER(genotypes), 
+				get_string_initials(VECTOR_ELT(alleles, 0)), get_string_initials(VECTOR_ELT(alleles, 1)));
+		Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles were missing\n", n_genotypes, n_markers, n_missing);
+	}
+	
+	load_genmap_from_arrays(d, length(VECTOR_ELT(map, 0)), get_string_pointers(VECTOR_ELT(map, 0)), 
+			INTEGER(VECTOR_ELT(map, 1)), REAL(VECTOR_ELT(map, 2)));
+	if (!isNull(effects)) {
+		load_effects_from_arrays(d, length(VECTOR_ELT(effects, 0)), get_string_pointers(VECTOR_ELT(effects, 0)),
+				get_string_initials(VECTOR_ELT(effects, 1)), REAL(VECTOR_ELT(effects, 2)));
+	}
+	
+	get_sorted_markers(d, d->n_markers);
+	get_chromosome_locations(d);
+	
+	SEXP sdptr = PROTECT(R_MakeExternalPtr((void*) d, R_NilValue, R_NilValue));
+	R_RegisterCFinalizerEx(sdptr, SXP_delete_simdata, 1);
+	UNPROTECT(1);
+	return sdptr;
+}
+
+SEXP SXP_load_more_genotypes(SEXP exd, SEXP alleleFile, SEXP threads, SEXP transposed) {
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
+	int n_threads = asInteger(threads);
+	if (n_threads == NA_INTEGER || n_threads < 1) { error("`threads` parameter is invalid.\n"); }
+	d->n_threads = n_threads;
+	if (!asLogical(transposed)) {
+		return ScalarInteger(load_more_genes_to_simdata(d, CHAR(asChar(alleleFile))));
+	}
 	return ScalarInteger(load_more_transposed_genes_to_simdata(d, CHAR(asChar(alleleFile))));
 	//return ScalarInteger(load_more_transposed_genes_to_simdata(&GlobalSim, CHAR(asChar(alleleFile))));
 }
@@ -49,7 +213,7 @@ SEXP SXP_load_new_effects(SEXP exd, SEXP effectFile) {
 /*-------------------------------- Crossers ---------------------------*/
 GenOptions create_genoptions(SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions go = BASIC_OPT;
 	int b;
 	
@@ -87,15 +251,23 @@ GenOptions create_genoptions(SEXP name, SEXP namePrefix, SEXP familySize,
 	if (b == NA_LOGICAL) { error("`retain` parameter is of invalid type.\n"); }
 	go.will_save_to_simdata = b;
 	
+	b = asInteger(threads);
+	if (b == NA_INTEGER || b < 1) { error("`threads` parameter is invalid.\n"); }
+	go.n_threads = b;
+	
+	b = asLogical(compressFiles);
+	if (b == NA_LOGICAL) { error("`compress.files` parameter is of invalid type.\n"); }
+	go.will_compress_files = b;
+	
 	return go;
 }
 
 SEXP SXP_cross_randomly(SEXP exd, SEXP glen, SEXP groups, SEXP crosses, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 
 	int len = asInteger(glen);
 	int *gps = INTEGER(groups); 
@@ -129,7 +301,7 @@ SEXP SXP_cross_randomly(SEXP exd, SEXP glen, SEXP groups, SEXP crosses, SEXP nam
 SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 		SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
 	if (length(firstparents) != length(secondparents)) {
@@ -144,7 +316,7 @@ SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 	if (TYPEOF(firstparents) == STRSXP) {	
 		for (int i = 0; i < ncrosses; ++i) {
 			strncpy(pname, CHAR(STRING_ELT(firstparents, i)), sizeof(char)*100);
-			combinations[0][i] = get_index_of_name(d->m, pname);
+			combinations[0][i] = get_index_of_name(d, pname);
 		}
 	} else if (TYPEOF(firstparents) == INTSXP) {
 		int* indexes = INTEGER(firstparents);
@@ -158,7 +330,7 @@ SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 	if (TYPEOF(secondparents) == STRSXP) {
 		for (int i = 0; i < ncrosses; ++i) {
 			strncpy(pname, CHAR(STRING_ELT(secondparents, i)), sizeof(char)*100);
-			combinations[1][i] = get_index_of_name(d->m, pname);
+			combinations[1][i] = get_index_of_name(d, pname);
 		}
 		
 	} else if (TYPEOF(secondparents) == INTSXP) {
@@ -172,7 +344,7 @@ SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 								 giveIds, filePrefix, savePedigree, saveEffects,
-								 saveGenes, retain);
+								 saveGenes, retain, threads, compressFiles);
 
 	return ScalarInteger(cross_these_combinations(d, ncrosses, combinations, g));
 	
@@ -180,10 +352,10 @@ SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 
 SEXP SXP_cross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 	
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
@@ -194,10 +366,10 @@ SEXP SXP_cross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix,
 
 SEXP SXP_dcross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 									 
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
@@ -209,10 +381,10 @@ SEXP SXP_dcross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix
 
 SEXP SXP_cross_unidirectional(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 	int len = asInteger(glen);
 	int *gps = INTEGER(groups); 
 	if (len == NA_INTEGER) { 
@@ -240,10 +412,10 @@ SEXP SXP_cross_unidirectional(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP
 
 /*SEXP cross_top(SEXP exd, SEXP group, SEXP percent, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 	int grp = asInteger(group);
 	if (grp < 0 || grp == NA_INTEGER) { error("`group` parameter is invalid.\n"); }
 	
@@ -258,10 +430,10 @@ SEXP SXP_cross_unidirectional(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP
 
 SEXP SXP_selfing(SEXP exd, SEXP glen, SEXP groups, SEXP n, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 	int len = asInteger(glen);
 	int *gps = INTEGER(groups); 
 	if (len == NA_INTEGER) { 
@@ -292,10 +464,10 @@ SEXP SXP_selfing(SEXP exd, SEXP glen, SEXP groups, SEXP n, SEXP name, SEXP nameP
 
 SEXP SXP_doubled(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 	int len = asInteger(glen);
 	int *gps = INTEGER(groups); 
 	if (len == NA_INTEGER) { 
@@ -323,10 +495,10 @@ SEXP SXP_doubled(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP namePrefix, S
 
 SEXP SXP_one_cross(SEXP exd, SEXP parent1_index, SEXP parent2_index, SEXP name, 
 		SEXP namePrefix, SEXP familySize, SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, 
-		SEXP savePedigree, SEXP saveEffects, SEXP saveGenes, SEXP retain) {
+		SEXP savePedigree, SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles) {
 	GenOptions g = create_genoptions(name, namePrefix, familySize, trackPedigree,
 									 giveIds, filePrefix, savePedigree, saveEffects,
-									 saveGenes, retain);
+									 saveGenes, retain, threads, compressFiles);
 									 
 	int p1 = asInteger(parent1_index);
 	if (p1 == NA_INTEGER) { error("`parent1.index` parameter is of invalid type.\n"); }
@@ -683,8 +855,9 @@ SEXP SXP_get_group_data(SEXP exd, SEXP group, SEXP whatData) {
 			data = get_malloc(sizeof(char*) * group_size);
 			for (int i = 0; i < group_size; ++i) {
 				data[i] = get_malloc(sizeof(char) * (glen + 1));
-				for (int j = 0; j < glen; ++j) {
-					data[i][j] = rawdata[i][j];
+				for (int j = 0; j < d->n_markers; ++j) {
+					data[i][2*j] = get_allele(d, rawdata[i], j, 0);
+					data[i][2*j + 1] = get_allele(d, rawdata[i], j, 1);
 				}
 				data[i][glen] = '\0';
 			}
@@ -732,135 +905,126 @@ SEXP SXP_get_group_data(SEXP exd, SEXP group, SEXP whatData) {
 /*--------------------------------Printing-----------------------------------*/
 
 SEXP SXP_save_simdata(SEXP exd, SEXP filename) {
-	FILE* f;
-	const char* fname = CHAR(asChar(filename));
-	if ((f = fopen(fname, "w")) == NULL) {
-		error( "Failed to open file %s.\n", fname);
-	}
+	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
+	save_simdata(&f, d);
+	
+	close_output_buffer(&f);
+	return ScalarInteger(0);
+}
+
+SEXP SXP_save_snapshot(SEXP exd, SEXP filename) {
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
-	save_simdata(f, d);
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
+	save_simdata_snapshot(&f, d);
 	
-	fclose(f);
+	close_output_buffer(&f);
 	return ScalarInteger(0);
 }
 
-SEXP SXP_save_genotypes(SEXP exd, SEXP filename, SEXP group, SEXP type) {
-	FILE* f;
-	const char* fname = CHAR(asChar(filename));
-	if ((f = fopen(fname, "w")) == NULL) {
-		error( "Failed to open file %s.\n", fname);
+/* Raise an R error if `group` is neither NULL (meaning every genotype) nor 
+ * a valid group number. Called before a save function opens its file, so 
+ * that an invalid call leaves no file behind. */
+static void check_group_to_save(SEXP group) {
+	if (!isNull(group) && (asInteger(group) == NA_INTEGER || asInteger(group) < 0)) {
+		error("Supplied group number is invalid.");
 	}
-	
+}
+
+SEXP SXP_save_genotypes(SEXP exd, SEXP filename, SEXP group, SEXP type) {
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
 	const char t = CHAR(asChar(type))[0];	
+	if (t != 'R' && t != 'r' && t != 'T' && t != 't') {
+		error("Supplied printing format is invalid.");
+	}
+	check_group_to_save(group);
+	
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
 	if (t == 'R' || t == 'r') {
 		if (isNull(group)) {
-			save_allele_matrix(f, d->m, d->markers);
-		} else if (asInteger(group) >= 0) {
-			save_group_alleles(f, d, asInteger(group));
+			save_allele_matrix(&f, d->m, d);
 		} else {
-			fclose(f);
-			error("Supplied group number is invalid.");
+			save_group_alleles(&f, d, asInteger(group));
 		}
-	} else if (t == 'T' || t == 't') {
+	} else { // transposed
 		if (isNull(group)) {
-			save_transposed_allele_matrix(f, d->m, d->markers);
-		} else if (asInteger(group) >= 0) {
-			save_transposed_group_alleles(f, d, asInteger(group));
+			save_transposed_allele_matrix(&f, d->m, d);
 		} else {
-			fclose(f);
-			error("Supplied group number is invalid.");
+			save_transposed_group_alleles(&f, d, asInteger(group));
 		}
-	} else {
-		fclose(f);
-		error("Supplied printing format is invalid.");
 	}
 	
-	fclose(f);
+	close_output_buffer(&f);
 	return ScalarInteger(0);
 }
 
 SEXP SXP_save_counts(SEXP exd, SEXP filename, SEXP group, SEXP allele) {
-	FILE* f;
-	const char* fname = CHAR(asChar(filename));
-	if ((f = fopen(fname, "w")) == NULL) {
-		error( "Failed to open file %s.\n", fname);
-	}
-	
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
 	const char t = CHAR(asChar(allele))[0];	
+	check_group_to_save(group);
+	
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
 	if (isNull(group)) {
-		save_count_matrix(f, d, t);
-	} else if (asInteger(group) >= 0) {
-		save_count_matrix_of_group(f, d, t, asInteger(group));
+		save_count_matrix(&f, d, t);
 	} else {
-		fclose(f);
-		error("Supplied group number is invalid.");
+		save_count_matrix_of_group(&f, d, t, asInteger(group));
 	}
 	
-	fclose(f);
+	close_output_buffer(&f);
 	return ScalarInteger(0);
 }
 
 SEXP SXP_save_pedigrees(SEXP exd, SEXP filename, SEXP group, SEXP type) {
-	FILE* f;
-	const char* fname = CHAR(asChar(filename));
-	if ((f = fopen(fname, "w")) == NULL) {
-		error( "Failed to open file %s.\n", fname);
-	}
-	
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	
 	const char t = CHAR(asChar(type))[0];	
+	if (t != 'R' && t != 'r' && t != 'P' && t != 'p' && t != 'B' && t != 'b') {
+		error("Supplied printing format is invalid.");
+	}
+	check_group_to_save(group);
+	
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
 	if (t == 'R' || t == 'r') { // full/recursive
 		if (isNull(group)) {
-			save_full_pedigree(f, d);
-		} else if (asInteger(group) >= 0) {
-			save_group_full_pedigree(f, d, asInteger(group));
+			save_full_pedigree(&f, d);
 		} else {
-			error("Supplied group number is invalid.");
+			save_group_full_pedigree(&f, d, asInteger(group));
 		}
 	} else if (t == 'P' || t == 'p') { // one-step/parents
 		if (isNull(group)) {
-			save_one_step_pedigree(f, d);
-		} else if (asInteger(group) >= 0) {
-			save_group_one_step_pedigree(f, d, asInteger(group));
+			save_one_step_pedigree(&f, d);
 		} else {
-			error("Supplied group number is invalid.");
+			save_group_one_step_pedigree(&f, d, asInteger(group));
+		}
+	} else { // binary
+		if (isNull(group)) {
+			save_binary_pedigree(&f, d);
+		} else {
+			save_group_binary_pedigree(&f, d, asInteger(group));
 		}
-	} else {
-		fclose(f);
-		error("Supplied printing format is invalid.");
 	}
 	
-	fclose(f);
+	close_output_buffer(&f);
 	return ScalarInteger(0);	
 }
 
 SEXP SXP_save_GEBVs(SEXP exd, SEXP filename, SEXP group) {
-	FILE* f;
-	const char* fname = CHAR(asChar(filename));
-	if ((f = fopen(fname, "w")) == NULL) {
-		error( "Failed to open file %s.\n", fname);
-	}
-	
 	SimData* d = (SimData*) R_ExternalPtrAddr(exd);
 	if (d->e.effects.matrix == NULL) { error("Need to load effect values before running this function.\n"); } 
+	check_group_to_save(group);
 	
+	OutputBuffer f = open_output_buffer(CHAR(asChar(filename)), FALSE);
 	if (isNull(group)) {
-		save_all_fitness(f, d);
-	} else if (asInteger(group) >= 0) {
-		save_group_fitness(f, d, asInteger(group));
+		save_all_fitness(&f, d);
 	} else {
-		fclose(f);
-		error("Supplied group number is invalid.");
+		save_group_fitness(&f, d, asInteger(group));
 	}
 	
-	fclose(f);
+	close_output_buffer(&f);
 	return ScalarInteger(0);
 }
 
@@ -6,43 +6,46 @@
 
 /*-------------------------- Loaders -------------------------*/
 
-SEXP SXP_load_data(SEXP alleleFile, SEXP mapFile);
-SEXP SXP_load_data_weff(SEXP alleleFile, SEXP mapFile, SEXP effectFile);
-SEXP SXP_load_more_genotypes(SEXP exd, SEXP alleleFile);
+SEXP SXP_load_data(SEXP alleleFile, SEXP mapFile, SEXP packed, SEXP threads, SEXP transposed, SEXP blockSize);
+SEXP SXP_load_data_weff(SEXP alleleFile, SEXP mapFile, SEXP effectFile, SEXP packed, SEXP threads, SEXP transposed, SEXP blockSize);
+SEXP SXP_load_from_matrix(SEXP genotypes, SEXP alleles, SEXP map, SEXP effects, SEXP packed, SEXP threads, SEXP blockSize);
+SEXP SXP_load_more_genotypes(SEXP exd, SEXP alleleFile, SEXP threads, SEXP transposed);
 SEXP SXP_load_new_effects(SEXP exd, SEXP effectFile);
+SEXP SXP_load_snapshot(SEXP filename);
+SEXP SXP_load_pedigrees(SEXP exd, SEXP filename);
 
 /*----------------Crossing-----------------*/
 GenOptions create_genoptions(SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_cross_randomly(SEXP exd, SEXP glen, SEXP groups, SEXP crosses, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_cross_Rcombinations(SEXP exd, SEXP firstparents, SEXP secondparents,
 		SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_cross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_dcross_combinations(SEXP exd, SEXP filename, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_cross_unidirectional(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 /*SEXP cross_top(SEXP exd, SEXP group, SEXP percent, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);*/
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads);*/
 SEXP SXP_selfing(SEXP exd, SEXP glen, SEXP groups, SEXP n, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_doubled(SEXP exd, SEXP glen, SEXP groups, SEXP name, SEXP namePrefix, SEXP familySize,
 		SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, SEXP savePedigree,
-		SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 SEXP SXP_one_cross(SEXP exd, SEXP parent1_index, SEXP parent2_index, SEXP name, 
 		SEXP namePrefix, SEXP familySize, SEXP trackPedigree, SEXP giveIds, SEXP filePrefix, 
-		SEXP savePedigree, SEXP saveEffects, SEXP saveGenes, SEXP retain);
+		SEXP savePedigree, SEXP saveEffects, SEXP saveGenes, SEXP retain, SEXP threads, SEXP compressFiles);
 
 /*-----------------------------------Groups----------------------------------*/
 SEXP SXP_combine_groups(SEXP exd, SEXP len, SEXP groups);
@@ -68,6 +71,7 @@ SEXP SXP_get_group_data(SEXP exd, SEXP group, SEXP whatData);
 
 /*--------------------------------Printing-----------------------------------*/
 SEXP SXP_save_simdata(SEXP exd, SEXP filename);
+SEXP SXP_save_snapshot(SEXP exd, SEXP filename);
 SEXP SXP_save_genotypes(SEXP exd, SEXP filename, SEXP group, SEXP type);
 SEXP SXP_save_counts(SEXP exd, SEXP filename, SEXP group, SEXP allele);
 SEXP SXP_save_pedigrees(SEXP exd, SEXP filename, SEXP group, SEXP type);
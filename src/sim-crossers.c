@@ -2,6 +2,66 @@
 
 /*--------------------------------Crossing-----------------------------------*/
 
+/** Find the first marker in a range of a chromosome whose map position is 
+ * greater than a given position, by bisection search. The markers must be
+ * sorted by position, as after sort_markers().
+ *
+ * @param d pointer to the SimData object containing the map positions.
+ * @param from index of the first marker to consider.
+ * @param to index one past the last marker to consider.
+ * @param position the map position to search for.
+ * @returns the index of the first marker in [from, to) with a position 
+ * greater than `position`, or `to` if there is none.
+ */
+int get_first_marker_after(SimData* d, int from, int to, float position) {
+	int mid;
+	while (from < to) {
+		mid = from + ((to - from) >> 1);
+		if (d->map.positions[mid].position > position) {
+			to = mid;
+		} else {
+			from = mid + 1;
+		}
+	}
+	return from;
+}
+
+/** Fill one haplotype of a chromosome of `output` with a recombined copy of 
+ * the two haplotypes of a parent, given the crossover positions.
+ *
+ * Each crossover position is converted to the index of the first marker 
+ * after it by a bisection search, and the runs of markers between 
+ * consecutive crossovers are each copied from the parent in one block 
+ * (@see copy_haplotype_segment()). A chromosome with no crossovers is copied
+ * whole. The cost therefore grows with the number of crossovers, not markers.
+ *
+ * @param d pointer to the SimData object containing map positions for the markers.
+ * sort_markers() and locate_chromosomes() should have been called previously.
+ * @param chr the chromosome to fill, counting from 1.
+ * @param parent_genome the genotype of the parent.
+ * @param which 0 or 1, the parent haplotype to start copying from.
+ * @param crossover_where the positions of the crossovers in this chromosome, 
+ * sorted in ascending order.
+ * @param num_crossovers the length of `crossover_where`.
+ * @param output the genotype to write to.
+ * @param copy 0 or 1, which haplotype of `output` to fill.
+ */
+void copy_recombined_chromosome(SimData* d, int chr, const char* parent_genome, int which,
+		const float* crossover_where, int num_crossovers, char* output, int copy) {
+	int chr_start = d->map.chr_ends[chr - 1];
+	int chr_end = d->map.chr_ends[chr];
+	
+	int segment_start = chr_start, breakpoint;
+	for (int i = 0; i < num_crossovers; ++i) {
+		// crossovers are sorted, so the search can start from the last breakpoint.
+		breakpoint = get_first_marker_after(d, segment_start, chr_end, crossover_where[i]);
+		copy_haplotype_segment(d, output, copy, parent_genome, which, segment_start, breakpoint);
+		segment_start = breakpoint;
+		which = 1 - which;
+	}
+	copy_haplotype_segment(d, output, copy, parent_genome, which, segment_start, chr_end);
+}
+
 /** Fills a char* with the simulated result of meiosis (reduction and
  * recombination) from the marker alleles of a given parent.
  *
@@ -18,27 +78,31 @@
  * @param d pointer to the SimData object containing map positions for the markers
  * that make up the rows of `parent_table`. sort_markers() and locate_chromosomes()
  * should have been called previously.
- * @param parent_genome the char* containing the parent's genome as a character string
- * made up of sequential pairs of alleles for each marker in d->markers.
- * @param output the char* to which to save the gamete. It saves the alleles every second
- * character, starting at 0, so that calling generate_gamete(..., offspring_genome) & 
- * generate_gamete(..., offspring_genome + 1) can be used to generate both halves of its genome.
+ * @param parent_genome the char* containing the parent's genome, stored as two 
+ * haplotypes of alleles for each marker in d->markers (the layout of an AlleleMatrix).
+ * @param output the char* to which to save the gamete. It saves the alleles 
+ * as the `copy`th allele of each marker, so that calling 
+ * generate_gamete(..., offspring_genome, 0) & generate_gamete(..., offspring_genome, 1) 
+ * can be used to generate both halves of its genome.
+ * @param copy 0 or 1, which of the two alleles at each marker of `output` to fill.
+ * @param rng pointer to the RandomStream from which to draw the crossover 
+ * counts, positions and starting haplotypes.
 */
-void generate_gamete(SimData* d, char* parent_genome, char* output) {
-	// assumes rand is already seeded
+void generate_gamete(SimData* d, char* parent_genome, char* output, int copy, RandomStream* rng) {
+	// all random draws come from the caller's stream
 	if (parent_genome == NULL) {
 		warning("Could not generate this gamete\n");
 		return;
 	}
 	
-	int num_crossovers, up_to_crossover, which;
+	int num_crossovers, which;
 	float crossover_where[100];
 	float* p_crossover_where;
 	
 	// treat each chromosome separately.
 	for (int chr = 1; chr <= d->map.n_chr; ++chr) {
 		// use Poisson distribution to choose the number of crossovers in this chromosome
-		num_crossovers = Rf_rpois(d->map.chr_lengths[chr - 1] / 100);
+		num_crossovers = get_random_poisson(rng, d->map.chr_lengths[chr - 1] / 100);
 		
 		// in the rare case where it could be >100, get enough space
 		// to be able to store the crossover positions we're about to create
@@ -51,7 +115,7 @@ void generate_gamete(SimData* d, char* parent_genome, char* output) {
 		// TASK 3: choose points where those crossovers occur
 		// by randomly generating a point along the length of the chromosome
 		for (int i = 0; i < num_crossovers; ++i) {
-			p_crossover_where[i] = ((double)rand() / (double)RAND_MAX) 
+			p_crossover_where[i] = get_random_unif(rng) 
 				* d->map.chr_lengths[chr - 1] 
 				+ d->map.positions[d->map.chr_ends[chr - 1]].position;
 		}
@@ -63,21 +127,10 @@ void generate_gamete(SimData* d, char* parent_genome, char* output) {
 		}
 		
 		// pick a parent genome half at random
-		which = (unif_rand() > 0.5); // if this is 0, we start with the left.
+		which = (get_random_unif(rng) > 0.5); // if this is 0, we start with the left.
 		
 		// TASK 4: Figure out the gamete that those numbers produce.
-		up_to_crossover = 0; // which crossovers we've dealt with
-		for (int i = d->map.chr_ends[chr - 1]; i < d->map.chr_ends[chr]; ++i) {
-			// loop through every marker for this chromosome
-			if (up_to_crossover < num_crossovers && 
-					d->map.positions[i].position > p_crossover_where[up_to_crossover]) {
-				// if we're here then between last loop and this one we crossed over.
-				// invert which and update up_to_crossover;
-				which = 1 - which;
-				up_to_crossover += 1;
-			}
-			output[2*i] = parent_genome[2*i + which];
-		}
+		copy_recombined_chromosome(d, chr, parent_genome, which, p_crossover_where, num_crossovers, output, copy);
 		
 		if (num_crossovers > 100) {
 			free(p_crossover_where);
@@ -101,23 +154,25 @@ void generate_gamete(SimData* d, char* parent_genome, char* output) {
  * alleles of the second parent.
  * @param output a 2x(n_marker) array of chars which will be overwritten
  * with the offspring genome.
+ * @param rng pointer to the RandomStream from which to draw the crossover 
+ * counts, positions and starting haplotypes.
 */
-void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char* output) {
-	// assumes rand is already seeded
+void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char* output, RandomStream* rng) {
+	// all random draws come from the caller's stream
 	if (parent1_genome == NULL || parent2_genome == NULL) {
 		warning("Could not generate this cross\n");
 		return;
 	}
 	
-	int num_crossovers[2], up_to_crossover[2], which[2];
+	int num_crossovers[2], which[2];
 	float* p_crossover_where[2];
 	float crossover_where[2][50];
 	
 	// treat each chromosome separately.
 	for (int chr = 1; chr <= d->map.n_chr; ++chr) {
 		// use Poisson distribution to choose the number of crossovers in this chromosome
-		num_crossovers[0] = Rf_rpois(d->map.chr_lengths[chr - 1] / 100);
-		num_crossovers[1] = Rf_rpois(d->map.chr_lengths[chr - 1] / 100);
+		num_crossovers[0] = get_random_poisson(rng, d->map.chr_lengths[chr - 1] / 100);
+		num_crossovers[1] = get_random_poisson(rng, d->map.chr_lengths[chr - 1] / 100);
 		
 		// in the rare case where it could be >100, get enough space
 		// to be able to store the crossover positions we're about to create
@@ -127,7 +182,7 @@ void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char
 			p_crossover_where[0] = get_malloc(sizeof(float) * num_crossovers[0]);
 		}
 		if (num_crossovers[1] <= 50) { 
-			p_crossover_where[1] = crossover_where[0]; // point to start of array
+			p_crossover_where[1] = crossover_where[1]; // point to start of array
 		} else {
 			p_crossover_where[1] = get_malloc(sizeof(float) * num_crossovers[1]);
 		}
@@ -135,12 +190,12 @@ void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char
 		// TASK 3: choose points where those crossovers occur
 		// by randomly generating a point along the length of the chromosome
 		for (int i = 0; i < num_crossovers[0]; ++i) {
-			p_crossover_where[0][i] = ((double)rand() / (double)RAND_MAX) 
+			p_crossover_where[0][i] = get_random_unif(rng) 
 				* d->map.chr_lengths[chr - 1] 
 				+ d->map.positions[d->map.chr_ends[chr - 1]].position;
 		}
 		for (int i = 0; i < num_crossovers[1]; ++i) {
-			p_crossover_where[1][i] = ((double)rand() / (double)RAND_MAX) 
+			p_crossover_where[1][i] = get_random_unif(rng) 
 				* d->map.chr_lengths[chr - 1] 
 				+ d->map.positions[d->map.chr_ends[chr - 1]].position;
 		}
@@ -156,27 +211,11 @@ void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char
 		}
 		
 		// pick a parent genome half at random
-		which[0] = (unif_rand() > 0.5); which[1] = (unif_rand() > 0.5); // if this is 0, we start with the left.
+		which[0] = (get_random_unif(rng) > 0.5); which[1] = (get_random_unif(rng) > 0.5); // if this is 0, we start with the left.
 		
 		// TASK 4: Figure out the gamete that those numbers produce.
-		up_to_crossover[0] = 0; up_to_crossover[1] = 0; // which crossovers we've dealt with
-		for (int i = d->map.chr_ends[chr - 1]; i < d->map.chr_ends[chr]; ++i) {
-			// loop through every marker for this chromosome
-			if (up_to_crossover[0] < num_crossovers[0] && 
-					d->map.positions[i].position > p_crossover_where[0][up_to_crossover[0]]) {
-				// between last loop and this one we crossed over.
-				// invert which and update up_to_crossover;
-				which[0] = 1 - which[0];
-				up_to_crossover[0] += 1;
-			}
-			if (up_to_crossover[1] < num_crossovers[1] && 
-					d->map.positions[i].position > p_crossover_where[1][up_to_crossover[1]]) {
-				which[1] = 1 - which[1];
-				up_to_crossover[1] += 1;
-			}
-			output[2*i] = parent1_genome[2*i + which[0]];
-			output[2*i + 1] = parent2_genome[2*i + which[1]];
-		}
+		copy_recombined_chromosome(d, chr, parent1_genome, which[0], p_crossover_where[0], num_crossovers[0], output, 0);
+		copy_recombined_chromosome(d, chr, parent2_genome, which[1], p_crossover_where[1], num_crossovers[1], output, 1);
 		
 		if (num_crossovers[0] > 50) {
 			free(p_crossover_where[0]);
@@ -203,22 +242,24 @@ void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char
  * alleles of the first parent
  * @param output a 2x(n_marker) array of chars which will be overwritten
  * with the offspring genome.
+ * @param rng pointer to the RandomStream from which to draw the crossover 
+ * counts, positions and starting haplotypes.
 */
-void generate_doubled_haploid(SimData* d, char* parent_genome, char* output) {
-	// assumes rand is already seeded
+void generate_doubled_haploid(SimData* d, char* parent_genome, char* output, RandomStream* rng) {
+	// all random draws come from the caller's stream
 	if (parent_genome == NULL) {
 		warning("Could not make this doubled haploid\n");
 		return;
 	}
 	
-	int num_crossovers, up_to_crossover, which;
+	int num_crossovers, which;
 	float crossover_where[100];
 	float* p_crossover_where;
 	
 	// treat each chromosome separately.
 	for (int chr = 1; chr <= d->map.n_chr; ++chr) {
 		// use Poisson distribution to choose the number of crossovers in this chromosome
-		num_crossovers = Rf_rpois(d->map.chr_lengths[chr - 1] / 100);
+		num_crossovers = get_random_poisson(rng, d->map.chr_lengths[chr - 1] / 100);
 		
 		// in the rare case where it could be >100, get enough space
 		// to be able to store the crossover positions we're about to create
@@ -231,7 +272,7 @@ void generate_doubled_haploid(SimData* d, char* parent_genome, char* output) {
 		// TASK 3: choose points where those crossovers occur
 		// by randomly generating a point along the length of the chromosome
 		for (int i = 0; i < num_crossovers; ++i) {
-			p_crossover_where[i] = ((double)rand() / (double)RAND_MAX) 
+			p_crossover_where[i] = get_random_unif(rng) 
 				* d->map.chr_lengths[chr - 1] 
 				+ d->map.positions[d->map.chr_ends[chr - 1]].position;
 		}
@@ -243,22 +284,12 @@ void generate_doubled_haploid(SimData* d, char* parent_genome, char* output) {
 		}
 		
 		// pick a parent genome half at random
-		which = (unif_rand() > 0.5); // if this is 0, we start with the left.
+		which = (get_random_unif(rng) > 0.5); // if this is 0, we start with the left.
 		
 		// TASK 4: Figure out the gamete that those numbers produce.
-		up_to_crossover = 0; // which crossovers we've dealt with
-		for (int i = d->map.chr_ends[chr - 1]; i < d->map.chr_ends[chr]; ++i) {
-			// loop through every marker for this chromosome
-			if (up_to_crossover < num_crossovers && 
-					d->map.positions[i].position > p_crossover_where[up_to_crossover]) {
-				// if we're here then between last loop and this one we crossed over.
-				// invert which and update up_to_crossover;
-				which = 1 - which;
-				up_to_crossover += 1;
-			}
-			output[2*i] = parent_genome[2*i + which];
-			output[2*i + 1] = parent_genome[2*i + which];
-		}
+		copy_recombined_chromosome(d, chr, parent_genome, which, p_crossover_where, num_crossovers, output, 0);
+		// the second haplotype is a duplicate of the first.
+		copy_haplotype_segment(d, output, 1, output, 0, d->map.chr_ends[chr - 1], d->map.chr_ends[chr]);
 		
 		if (num_crossovers > 100) {
 			free(p_crossover_where);
@@ -268,6 +299,113 @@ void generate_doubled_haploid(SimData* d, char* parent_genome, char* output) {
 	return;
 }
 
+/** Generate the genotypes of a batch of offspring whose parents have already 
+ * been chosen. Offspring are independent of each other, so if the package 
+ * was built with OpenMP support the batch is split across `n_threads` threads.
+ *
+ * The `i`th job draws all its random numbers from its own RandomStream, 
+ * number `first_stream + i` of the set seeded by `seed`, so the genotypes
+ * produced do not depend on how many threads were used or which thread 
+ * ran which job.
+ *
+ * Jobs with a missing parent are warned about and skipped before the 
+ * parallel section, as R's API cannot be called from other threads.
+ *
+ * @param d pointer to the SimData object that includes genetic map data 
+ * needed to simulate meiosis.
+ * @param method 'C' to cross the two parents of each job, 'S' to self 
+ * parent 1 `n_selfs` times, or 'D' to make a doubled haploid from parent 1.
+ * @param n_selfs number of generations of selfing, if `method` is 'S'.
+ * @param jobs array of parents and output locations, one per offspring.
+ * @param n_jobs length of `jobs`
+ * @param seed seed shared by the streams of all offspring in this operation.
+ * @param first_stream stream number to use for the first job in `jobs`.
+ * @param n_threads maximum number of threads to use.
+ */
+void generate_offspring_batch(SimData* d, char method, int n_selfs, OffspringJob* jobs, 
+		int n_jobs, uint64_t seed, unsigned int first_stream, int n_threads) {
+	for (int i = 0; i < n_jobs; ++i) {
+		if (jobs[i].parent1_genome == NULL || (method == 'C' && jobs[i].parent2_genome == NULL)) {
+			warning("Could not generate this offspring\n");
+			jobs[i].output = NULL;
+		}
+	}
+	
+	int n_workers = 1;
+#ifdef _OPENMP
+	if (n_threads > 1) {
+		n_workers = n_threads;
+	}
+#else
+	(void) n_threads;
+#endif
+	// scratch space for alternate rounds of selfing, one genotype per thread
+	char* scratch = NULL;
+	if (method == 'S' && n_selfs > 1) {
+		scratch = get_malloc(sizeof(char) * get_genotype_length(d) * n_workers);
+	}
+	
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(n_workers) schedule(dynamic, 16) if(n_workers > 1)
+#endif
+	for (int i = 0; i < n_jobs; ++i) {
+		if (jobs[i].output == NULL) {
+			continue;
+		}
+		RandomStream rng = create_random_stream(seed, first_stream + i);
+		
+		if (method == 'D') {
+			generate_doubled_haploid(d, jobs[i].parent1_genome, jobs[i].output, &rng);
+		} else if (method == 'S') {
+			generate_cross(d, jobs[i].parent1_genome, jobs[i].parent1_genome, jobs[i].output, &rng);
+			if (n_selfs > 1) {
+				int t = 0;
+#ifdef _OPENMP
+				t = omp_get_thread_num();
+#endif
+				char* genes = scratch + (size_t) t * get_genotype_length(d);
+				for (int j = 1; j < n_selfs; ++j) {
+					if (j % 2) {
+						generate_cross(d, jobs[i].output, jobs[i].output, genes, &rng);
+					} else {
+						generate_cross(d, genes, genes, jobs[i].output, &rng);
+					}
+				}
+				// after an even number of rounds the final generation is in the scratch space
+				if (n_selfs % 2 == 0) {
+					memcpy(jobs[i].output, genes, sizeof(char) * get_genotype_length(d));
+				}
+			}
+		} else {
+			generate_cross(d, jobs[i].parent1_genome, jobs[i].parent2_genome, jobs[i].output, &rng);
+		}
+	}
+	
+	if (scratch != NULL) {
+		free(scratch);
+	}
+}
+
+/** Open one of the save-as-you-go files of a crossing function, named
+ * "[g.filename_prefix][suffix]", with ".gz" added if g.will_compress_files is set.
+ *
+ * @param g options for the genotypes created. @see GenOptions
+ * @param suffix the part of the filename after the prefix, eg "-pedigree".
+ * @returns an OutputBuffer for the open file. Close it with close_output_buffer().
+ */
+static OutputBuffer open_cross_output_file(GenOptions g, const char* suffix) {
+	size_t prefix_length = strlen(g.filename_prefix);
+	size_t suffix_length = strlen(suffix);
+	char* fname = get_malloc(sizeof(char) * (prefix_length + suffix_length + 4));
+	memcpy(fname, g.filename_prefix, prefix_length);
+	memcpy(fname + prefix_length, suffix, suffix_length);
+	strcpy(fname + prefix_length + suffix_length, g.will_compress_files ? ".gz" : "");
+	
+	OutputBuffer f = open_output_buffer(fname, g.will_compress_files);
+	free(fname);
+	return f;
+}
+
 /** Performs random crosses among members of a group. If the group does not 
  * have at least two members, the simulation exits. Selfing/crossing an individual
  * with itself is not permitted. The resulting genotypes are allocated to a new group.
@@ -300,12 +438,12 @@ int cross_random_individuals(SimData* d, int from_group, int n_crosses, GenOptio
 	AlleleMatrix* crosses;
 	int n_combinations = n_crosses * g.family_size;
 	int n_to_go = n_combinations;
-	if (n_to_go < 1000) {
-		crosses = create_empty_allelematrix(d->n_markers, n_to_go);
+	if (n_to_go < d->block_capacity) {
+		crosses = create_empty_allelematrix(d, n_to_go);
 		n_to_go = 0;
 	} else {
-		crosses = create_empty_allelematrix(d->n_markers, 1000);
-		n_to_go -= 1000;
+		crosses = create_empty_allelematrix(d, d->block_capacity);
+		n_to_go -= d->block_capacity;
 	}
 	int fullness = 0;
 	int parent1;
@@ -334,79 +472,87 @@ int cross_random_individuals(SimData* d, int from_group, int n_crosses, GenOptio
 	}
 	
 	// open the output files, if applicable
-	char fname[100];
-	FILE* fp = NULL, * fe = NULL, * fg = NULL;
+	OutputBuffer fp, fe, fg;
+	PedigreeCache pedigree_cache;
 	DecimalMatrix eff;
 	if (g.will_save_pedigree_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-pedigree");
-		fp = fopen(fname, "w");
+		fp = open_cross_output_file(g, "-pedigree");
+		pedigree_cache = create_pedigree_cache();
 	}
 	if (g.will_save_effects_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-eff");
-		fe = fopen(fname, "w");
+		fe = open_cross_output_file(g, "-eff");
 	}
 	if (g.will_save_genes_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-genome");
-		fg = fopen(fname, "w");
+		fg = open_cross_output_file(g, "-genome");
 	}
 	
 	GetRNGstate();
+	// the offspring's genotypes are generated in batches, one per block, after 
+	// their parents are chosen. Each offspring gets its own random stream.
+	uint64_t seed = get_seed_from_R();
+	RandomStream rng = create_random_stream(seed, 0);
+	OffspringJob* jobs = get_malloc(sizeof(OffspringJob) * (n_combinations < d->block_capacity ? n_combinations : d->block_capacity));
+	unsigned int n_generated = 0;
 	// loop through each combination
 	for (int i = 0; i < n_crosses; ++i) {
 		R_CheckUserInterrupt();
 		
 		// get parents, randomly.
-		parent1 = round(unif_rand() * (g_size - 1));
+		parent1 = get_random_index(&rng, g_size);
 		do {
-			parent2 = round(unif_rand() * (g_size - 1));
+			parent2 = get_random_index(&rng, g_size);
 		} while (parent1 == parent2);
 		
 		// do the cross.
 		for (int f = 0; f < g.family_size; ++f, ++fullness) {
 			// when cross buffer is full, save these outcomes to the file.
-			if (fullness >= 1000) {
-				crosses->n_subjects = 1000;
+			if (fullness >= d->block_capacity) {
+				generate_offspring_batch(d, 'C', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+				n_generated += fullness;
+				crosses->n_subjects = d->block_capacity;
 				// give the subjects their ids and names
 				if (g.will_name_subjects) {
 					set_subject_names(crosses, g.subject_prefix, *cross_current_id, 0);
 				}
-				for (int j = 0; j < 1000; ++j) {
+				for (int j = 0; j < d->block_capacity; ++j) {
 					++ *cross_current_id;
 					crosses->ids[j] = *cross_current_id;
 				}
 				
 				// save the subjects to files if appropriate
 				if (g.will_save_pedigree_to_file) {
-					save_AM_pedigree( fp, crosses, d);
+					save_AM_pedigree( &fp, crosses, d, &pedigree_cache);
 				}
 				if (g.will_save_effects_to_file) {
-					eff = calculate_fitness_metric( crosses, &(d->e));
-					save_fitness( fe, &eff, crosses->ids, crosses->subject_names);
+					eff = calculate_fitness_metric( d, crosses);
+					save_fitness( &fe, &eff, crosses->ids, crosses->subject_names);
 					delete_dmatrix( &eff);
 				}
 				if (g.will_save_genes_to_file) {
-					save_allele_matrix( fg, crosses, d->markers);
+					save_allele_matrix( &fg, crosses, d);
 				}
 				
 				if (g.will_save_to_simdata) {	
 					last->next = crosses;
+					if (g.will_allocate_ids) {
+						index_subject_ids(d, crosses);
+					}
 					last = last->next;
-					if (n_to_go < 1000) {
-						crosses = create_empty_allelematrix(d->n_markers, n_to_go);
+					if (n_to_go < d->block_capacity) {
+						crosses = create_empty_allelematrix(d, n_to_go);
 						n_to_go = 0;
 					} else {
-						crosses = create_empty_allelematrix(d->n_markers, 1000);
-						n_to_go -= 1000;
+						crosses = create_empty_allelematrix(d, d->block_capacity);
+						n_to_go -= d->block_capacity;
 					}
 				}
 				
 				fullness = 0; //reset the count and start refilling the matrix
 			}
 			
-			generate_cross( d, group_genes[parent1] , group_genes[parent2] , crosses->alleles[fullness] );
+			jobs[fullness].parent1_genome = group_genes[parent1];
+			jobs[fullness].parent2_genome = group_genes[parent2];
+			jobs[fullness].output = crosses->alleles[fullness];
 			crosses->groups[fullness] = output_group;
 			if (g.will_track_pedigree) {
 				crosses->pedigrees[0][fullness] = group_ids[parent1];
@@ -415,6 +561,8 @@ int cross_random_individuals(SimData* d, int from_group, int n_crosses, GenOptio
 		}
 		
 	}
+	generate_offspring_batch(d, 'C', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+	free(jobs);
 	PutRNGstate();
 	
 	// save the rest of the crosses to the file.
@@ -433,21 +581,25 @@ int cross_random_individuals(SimData* d, int from_group, int n_crosses, GenOptio
 	
 	// save the subjects to files if appropriate
 	if (g.will_save_pedigree_to_file) {
-		save_AM_pedigree( fp, crosses, d);
-		fclose(fp);
+		save_AM_pedigree( &fp, crosses, d, &pedigree_cache);
+		close_output_buffer(&fp);
+		delete_pedigree_cache(&pedigree_cache);
 	}
 	if (g.will_save_effects_to_file) {
-		eff = calculate_fitness_metric( crosses, &(d->e));
-		save_fitness( fe, &eff, crosses->ids, crosses->subject_names);
+		eff = calculate_fitness_metric( d, crosses);
+		save_fitness( &fe, &eff, crosses->ids, crosses->subject_names);
 		delete_dmatrix( &eff);
-		fclose(fe);
+		close_output_buffer(&fe);
 	}
 	if (g.will_save_genes_to_file) {
-		save_allele_matrix( fg, crosses, d->markers);
-		fclose(fg);
+		save_allele_matrix( &fg, crosses, d);
+		close_output_buffer(&fg);
 	}
 	if (g.will_save_to_simdata) {
 		last->next = crosses;
+		if (g.will_allocate_ids) {
+			index_subject_ids(d, crosses);
+		}
 		condense_allele_matrix( d );
 		return output_group;
 		
@@ -480,12 +632,12 @@ int cross_these_combinations(SimData* d, int n_combinations, int combinations[2]
 	// create the buffer we'll use to save the output crosses before they're printed.
 	AlleleMatrix* crosses;
 	int n_to_go = n_combinations * g.family_size;
-	if (n_to_go < 1000) {
-		crosses = create_empty_allelematrix(d->n_markers, n_to_go);
+	if (n_to_go < d->block_capacity) {
+		crosses = create_empty_allelematrix(d, n_to_go);
 		n_to_go = 0;
 	} else {
-		crosses = create_empty_allelematrix(d->n_markers, 1000);
-		n_to_go -= 1000;
+		crosses = create_empty_allelematrix(d, d->block_capacity);
+		n_to_go -= d->block_capacity;
 	}
 	int fullness = 0, parent1id, parent2id;
 	char* parent1genes, * parent2genes;
@@ -509,26 +661,26 @@ int cross_these_combinations(SimData* d, int n_combinations, int combinations[2]
 	}
 	
 	// open the output files, if applicable
-	char fname[100];
-	FILE* fp = NULL, * fe = NULL, * fg = NULL;
+	OutputBuffer fp, fe, fg;
+	PedigreeCache pedigree_cache;
 	DecimalMatrix eff;
 	if (g.will_save_pedigree_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-pedigree");
-		fp = fopen(fname, "w");
+		fp = open_cross_output_file(g, "-pedigree");
+		pedigree_cache = create_pedigree_cache();
 	}
 	if (g.will_save_effects_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-eff");
-		fe = fopen(fname, "w");
+		fe = open_cross_output_file(g, "-eff");
 	}
 	if (g.will_save_genes_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-genome");
-		fg = fopen(fname, "w");
+		fg = open_cross_output_file(g, "-genome");
 	}
 	
 	GetRNGstate();
+	// the offspring's genotypes are generated in batches, one per block. 
+	// Each offspring gets its own random stream.
+	uint64_t seed = get_seed_from_R();
+	OffspringJob* jobs = get_malloc(sizeof(OffspringJob) * crosses->n_subjects);
+	unsigned int n_generated = 0;
 	// loop through each combination
 	for (int i = 0; i < n_combinations; ++i) {
 		R_CheckUserInterrupt();
@@ -543,46 +695,53 @@ int cross_these_combinations(SimData* d, int n_combinations, int combinations[2]
 			
 			for (int f = 0; f < g.family_size; ++f, ++fullness) {
 				// when cross buffer is full, save these outcomes to the file.
-				if (fullness >= 1000) {
+				if (fullness >= d->block_capacity) {
+					generate_offspring_batch(d, 'C', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+					n_generated += fullness;
 					// give the subjects their ids and names
 					if (g.will_name_subjects) {
 						set_subject_names(crosses, g.subject_prefix, *cross_current_id, 0);
 					}
-					for (int j = 0; j < 1000; ++j) {
+					for (int j = 0; j < d->block_capacity; ++j) {
 						++ *cross_current_id;
 						crosses->ids[j] = *cross_current_id;
 					}
 					
 					// save the subjects to files if appropriate
 					if (g.will_save_pedigree_to_file) {
-						save_AM_pedigree( fp, crosses, d);
+						save_AM_pedigree( &fp, crosses, d, &pedigree_cache);
 					}
 					if (g.will_save_effects_to_file) {
-						eff = calculate_fitness_metric( crosses, &(d->e));
-						save_fitness( fe, &eff, crosses->ids, crosses->subject_names);
+						eff = calculate_fitness_metric( d, crosses);
+						save_fitness( &fe, &eff, crosses->ids, crosses->subject_names);
 						delete_dmatrix( &eff);
 					}
 					if (g.will_save_genes_to_file) {
-						save_allele_matrix( fg, crosses, d->markers);
+						save_allele_matrix( &fg, crosses, d);
 					}
 					
 					if (g.will_save_to_simdata) {
 						last->next = crosses;
+						if (g.will_allocate_ids) {
+							index_subject_ids(d, crosses);
+						}
 						last = last->next;
 						// get the new crosses matrix, of the right size.
-						if (n_to_go < 1000) {
-							crosses = create_empty_allelematrix(d->n_markers, n_to_go);
+						if (n_to_go < d->block_capacity) {
+							crosses = create_empty_allelematrix(d, n_to_go);
 							n_to_go = 0;
 						} else {
-							crosses = create_empty_allelematrix(d->n_markers, 1000);
-							n_to_go -= 1000;
+							crosses = create_empty_allelematrix(d, d->block_capacity);
+							n_to_go -= d->block_capacity;
 						}
 					}
 					fullness = 0; //reset the count and start refilling the matrix
 				}
 				
 				
-				generate_cross(d, parent1genes, parent2genes, crosses->alleles[fullness]);
+				jobs[fullness].parent1_genome = parent1genes;
+				jobs[fullness].parent2_genome = parent2genes;
+				jobs[fullness].output = crosses->alleles[fullness];
 				crosses->groups[fullness] = output_group;
 				if (g.will_track_pedigree) {
 					crosses->pedigrees[0][fullness] = parent1id;
@@ -591,6 +750,8 @@ int cross_these_combinations(SimData* d, int n_combinations, int combinations[2]
 			}	
 		}
 	}
+	generate_offspring_batch(d, 'C', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+	free(jobs);
 	PutRNGstate();
 	
 	// save the rest of the crosses to the file.
@@ -605,21 +766,25 @@ int cross_these_combinations(SimData* d, int n_combinations, int combinations[2]
 	
 	// save the subjects to files if appropriate
 	if (g.will_save_pedigree_to_file) {
-		save_AM_pedigree( fp, crosses, d);
-		fclose(fp);
+		save_AM_pedigree( &fp, crosses, d, &pedigree_cache);
+		close_output_buffer(&fp);
+		delete_pedigree_cache(&pedigree_cache);
 	}
 	if (g.will_save_effects_to_file) {
-		eff = calculate_fitness_metric( crosses, &(d->e));
-		save_fitness( fe, &eff, crosses->ids, crosses->subject_names);
+		eff = calculate_fitness_metric( d, crosses);
+		save_fitness( &fe, &eff, crosses->ids, crosses->subject_names);
 		delete_dmatrix( &eff);
-		fclose(fe);
+		close_output_buffer(&fe);
 	}
 	if (g.will_save_genes_to_file) {
-		save_allele_matrix( fg, crosses, d->markers);
-		fclose(fg);
+		save_allele_matrix( &fg, crosses, d);
+		close_output_buffer(&fg);
 	}
 	if (g.will_save_to_simdata) {
 		last->next = crosses;
+		if (g.will_allocate_ids) {
+			index_subject_ids(d, crosses);
+		}
 		condense_allele_matrix( d ); 
 		return output_group;
 		
@@ -658,15 +823,15 @@ int self_n_times(SimData* d, int n, int group, GenOptions g) {
 	
 	AlleleMatrix* outcome;
 	int n_to_go = group_size * g.family_size;
-	if (n_to_go < 1000) {
-		outcome = create_empty_allelematrix(d->n_markers, n_to_go);
+	if (n_to_go < d->block_capacity) {
+		outcome = create_empty_allelematrix(d, n_to_go);
 		n_to_go = 0;
 	} else {
-		outcome = create_empty_allelematrix(d->n_markers, 1000);
-		n_to_go -= 1000;
+		outcome = create_empty_allelematrix(d, d->block_capacity);
+		n_to_go -= d->block_capacity;
 	}
 	char** group_genes = get_group_genes( d, group, group_size);
-	int i, j, f, fullness = 0;
+	int i, f, fullness = 0;
 
 	// set up pedigree/id allocation, if applicable
 	unsigned int cid = 0;
@@ -691,162 +856,88 @@ int self_n_times(SimData* d, int n, int group, GenOptions g) {
 	}
 	
 	// open the output files, if applicable
-	char fname[100];
-	FILE* fp = NULL, * fe = NULL, * fg = NULL;
+	OutputBuffer fp, fe, fg;
+	PedigreeCache pedigree_cache;
 	DecimalMatrix eff;
 	if (g.will_save_pedigree_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-pedigree");
-		fp = fopen(fname, "w");
+		fp = open_cross_output_file(g, "-pedigree");
+		pedigree_cache = create_pedigree_cache();
 	}
 	if (g.will_save_effects_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-eff");
-		fe = fopen(fname, "w");
+		fe = open_cross_output_file(g, "-eff");
 	}
 	if (g.will_save_genes_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-genome");
-		fg = fopen(fname, "w");
+		fg = open_cross_output_file(g, "-genome");
 	}
 
 	GetRNGstate();
+	// the offspring's genotypes are generated in batches, one per block, after 
+	// their parents are listed. Each offspring gets its own random stream.
+	uint64_t seed = get_seed_from_R();
+	OffspringJob* jobs = get_malloc(sizeof(OffspringJob) * outcome->n_subjects);
+	unsigned int n_generated = 0;
 	for (i = 0; i < group_size; ++i) {	
 		R_CheckUserInterrupt();	
-		// do n rounds of selfing (j-indexed loops) g.family_size times per individual (f-indexed loops)
-		if (n == 1)  {
-			//find the parent genes, save a shallow copy to set
-			char* genes = group_genes[i];
-			for (f = 0; f < g.family_size; ++f, ++fullness) {
-				
-				// when cross buffer is full, save these outcomes to the file.
-				if (fullness >= 1000) {
-					outcome->n_subjects = 1000;
-					// give the subjects their ids and names
-					if (g.will_name_subjects) {
-						set_subject_names(outcome, g.subject_prefix, *cross_current_id, 0);
-					}
-					for (int j = 0; j < 1000; ++j) {
-						++ *cross_current_id;
-						outcome->ids[j] = *cross_current_id;
-					}
-					
-					// save the subjects to files if appropriate
-					if (g.will_save_pedigree_to_file) {
-						save_AM_pedigree( fp, outcome, d);
-					}
-					if (g.will_save_effects_to_file) {
-						eff = calculate_fitness_metric( outcome, &(d->e));
-						save_fitness( fe, &eff, outcome->ids, outcome->subject_names);
-						delete_dmatrix( &eff);
-					}
-					if (g.will_save_genes_to_file) {
-						save_allele_matrix( fg, outcome, d->markers);
-					}
-					
-					if (g.will_save_to_simdata) {
-						last->next = outcome;
-						last = last->next;
-						if (n_to_go < 1000) {
-							outcome = create_empty_allelematrix(d->n_markers, n_to_go);
-							n_to_go = 0;
-						} else {
-							outcome = create_empty_allelematrix(d->n_markers, 1000);
-							n_to_go -= 1000;
-						}
-					}
-					fullness = 0; //reset the count and start refilling the matrix
+		// do n rounds of selfing g.family_size times per individual (f-indexed loops)
+		//find the parent genes, save a shallow copy to set
+		char* genes = group_genes[i];
+		for (f = 0; f < g.family_size; ++f, ++fullness) {
+			// when cross buffer is full, save these outcomes to the file.
+			if (fullness >= d->block_capacity) {
+				generate_offspring_batch(d, 'S', n, jobs, fullness, seed, n_generated + 1, g.n_threads);
+				n_generated += fullness;
+				outcome->n_subjects = d->block_capacity;
+				// give the subjects their ids and names
+				if (g.will_name_subjects) {
+					set_subject_names(outcome, g.subject_prefix, *cross_current_id, 0);
+				}
+				for (int j = 0; j < d->block_capacity; ++j) {
+					++ *cross_current_id;
+					outcome->ids[j] = *cross_current_id;
 				}
 				
-				generate_cross( d, genes, genes, outcome->alleles[fullness] );
-			}
-			
-		} else {
-			//find the parent genes, save a deep copy to set
-			char* genes = get_malloc(sizeof(char) * (d->n_markers<<1));
-			for (j = 0; j < d->n_markers; ++j) {
-				genes[2*j] = group_genes[i][2*j];
-				genes[2*j + 1] = group_genes[i][2*j + 1];
-			}
-			
-			for (f = 0; f < g.family_size; ++f, ++fullness) {
-				// when cross buffer is full, save these outcomes to the file.
-				if (fullness >= 1000) {
-					outcome->n_subjects = 1000;
-					// give the subjects their ids and names
-					if (g.will_name_subjects) {
-						set_subject_names(outcome, g.subject_prefix, *cross_current_id, 0);
-					}
-					for (int j = 0; j < 1000; ++j) {
-						++ *cross_current_id;
-						outcome->ids[j] = *cross_current_id;
-					}
-					
-					// save the subjects to files if appropriate
-					if (g.will_save_pedigree_to_file) {
-						save_AM_pedigree( fp, outcome, d);
-					}
-					if (g.will_save_effects_to_file) {
-						eff = calculate_fitness_metric( outcome, &(d->e));
-						save_fitness( fe, &eff, outcome->ids, outcome->subject_names);
-						delete_dmatrix( &eff);
-					}
-					if (g.will_save_genes_to_file) {
-						save_allele_matrix( fg, outcome, d->markers);
-					}
-					
-					if (g.will_save_to_simdata) {
-						last->next = outcome;
-						last = last->next;
-						if (n_to_go < 1000) {
-							outcome = create_empty_allelematrix(d->n_markers, n_to_go);
-							n_to_go = 0;
-						} else {
-							outcome = create_empty_allelematrix(d->n_markers, 1000);
-							n_to_go -= 1000;
-						}
-					}
-					fullness = 0; //reset the count and start refilling the matrix
+				// save the subjects to files if appropriate
+				if (g.will_save_pedigree_to_file) {
+					save_AM_pedigree( &fp, outcome, d, &pedigree_cache);
+				}
+				if (g.will_save_effects_to_file) {
+					eff = calculate_fitness_metric( d, outcome);
+					save_fitness( &fe, &eff, outcome->ids, outcome->subject_names);
+					delete_dmatrix( &eff);
+				}
+				if (g.will_save_genes_to_file) {
+					save_allele_matrix( &fg, outcome, d);
 				}
 				
-				for (j = 0; j < n; ++j) {
-					R_CheckUserInterrupt();
-					if (j % 2) {
-						generate_cross( d, outcome->alleles[fullness], outcome->alleles[fullness], genes);
-					} else {
-						generate_cross( d, genes, genes, outcome->alleles[fullness] );
+				if (g.will_save_to_simdata) {
+					last->next = outcome;
+					if (g.will_allocate_ids) {
+						index_subject_ids(d, outcome);
 					}
-				}
-				if (n % 2) {
-					free(outcome->alleles[fullness]);
-					outcome->alleles[fullness] = genes;
-					
-					// make a new deep copy if we're still going.
-					if (f + 1 < g.family_size) {
-						genes = get_malloc(sizeof(char) * (d->n_markers<<1));
-						for (j = 0; j < d->n_markers; ++j) {
-							genes[2*j] = group_genes[i][2*j];
-							genes[2*j + 1] = group_genes[i][2*j + 1];
-						}
+					last = last->next;
+					if (n_to_go < d->block_capacity) {
+						outcome = create_empty_allelematrix(d, n_to_go);
+						n_to_go = 0;
+					} else {
+						outcome = create_empty_allelematrix(d, d->block_capacity);
+						n_to_go -= d->block_capacity;
 					}
-				} else {
-					free(genes);
 				}
-				
-				outcome->groups[fullness] = output_group;
-				
+				fullness = 0; //reset the count and start refilling the matrix
 			}
-		}
-		
-		if (g.will_track_pedigree) {
-			fullness -= g.family_size;
-			int id = group_ids[i];
-			for (f = 0; f < g.family_size; ++f, ++fullness) {
-				outcome->pedigrees[0][fullness] = id;
-				outcome->pedigrees[1][fullness] = id;
+			
+			jobs[fullness].parent1_genome = genes;
+			jobs[fullness].parent2_genome = genes;
+			jobs[fullness].output = outcome->alleles[fullness];
+			outcome->groups[fullness] = output_group;
+			if (g.will_track_pedigree) {
+				outcome->pedigrees[0][fullness] = group_ids[i];
+				outcome->pedigrees[1][fullness] = group_ids[i];
 			}
 		}
 	}
+	generate_offspring_batch(d, 'S', n, jobs, fullness, seed, n_generated + 1, g.n_threads);
+	free(jobs);
 	PutRNGstate();
 	
 	free(group_genes);
@@ -866,21 +957,25 @@ int self_n_times(SimData* d, int n, int group, GenOptions g) {
 	
 	// save the subjects to files if appropriate
 	if (g.will_save_pedigree_to_file) {
-		save_AM_pedigree( fp, outcome, d);
-		fclose(fp);
+		save_AM_pedigree( &fp, outcome, d, &pedigree_cache);
+		close_output_buffer(&fp);
+		delete_pedigree_cache(&pedigree_cache);
 	}
 	if (g.will_save_effects_to_file) {
-		eff = calculate_fitness_metric( outcome, &(d->e));
-		save_fitness( fe, &eff, outcome->ids, outcome->subject_names);
+		eff = calculate_fitness_metric( d, outcome);
+		save_fitness( &fe, &eff, outcome->ids, outcome->subject_names);
 		delete_dmatrix( &eff);
-		fclose(fe);
+		close_output_buffer(&fe);
 	}
 	if (g.will_save_genes_to_file) {
-		save_allele_matrix( fg, outcome, d->markers);
-		fclose(fg);
+		save_allele_matrix( &fg, outcome, d);
+		close_output_buffer(&fg);
 	}
 	if (g.will_save_to_simdata) {
 		last->next = outcome;
+		if (g.will_allocate_ids) {
+			index_subject_ids(d, outcome);
+		}
 		condense_allele_matrix( d ); 
 		return output_group;	
 	} else {
@@ -911,12 +1006,12 @@ int make_doubled_haploids(SimData* d, int group, GenOptions g) {
 	
 	AlleleMatrix* outcome;
 	int n_to_go = group_size * g.family_size;
-	if (n_to_go < 1000) {
-		outcome = create_empty_allelematrix(d->n_markers, n_to_go);
+	if (n_to_go < d->block_capacity) {
+		outcome = create_empty_allelematrix(d, n_to_go);
 		n_to_go = 0;
 	} else {
-		outcome = create_empty_allelematrix(d->n_markers, 1000);
-		n_to_go -= 1000;
+		outcome = create_empty_allelematrix(d, d->block_capacity);
+		n_to_go -= d->block_capacity;
 	}
 	char** group_genes = get_group_genes( d, group, group_size);
 	int i, f, fullness = 0;
@@ -944,80 +1039,88 @@ int make_doubled_haploids(SimData* d, int group, GenOptions g) {
 	}
 	
 	// open the output files, if applicable
-	char fname[100];
-	FILE* fp = NULL, * fe = NULL, * fg = NULL;
+	OutputBuffer fp, fe, fg;
+	PedigreeCache pedigree_cache;
 	DecimalMatrix eff;
 	if (g.will_save_pedigree_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-pedigree");
-		fp = fopen(fname, "w");
+		fp = open_cross_output_file(g, "-pedigree");
+		pedigree_cache = create_pedigree_cache();
 	}
 	if (g.will_save_effects_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-eff");
-		fe = fopen(fname, "w");
+		fe = open_cross_output_file(g, "-eff");
 	}
 	if (g.will_save_genes_to_file) {
-		strcpy(fname, g.filename_prefix);
-		strcat(fname, "-genome");
-		fg = fopen(fname, "w");
+		fg = open_cross_output_file(g, "-genome");
 	}
 
 	GetRNGstate();
+	// the offspring's genotypes are generated in batches, one per block, after 
+	// their parents are listed. Each offspring gets its own random stream.
+	uint64_t seed = get_seed_from_R();
+	OffspringJob* jobs = get_malloc(sizeof(OffspringJob) * outcome->n_subjects);
+	unsigned int n_generated = 0;
 	for (i = 0; i < group_size; ++i) {	
 		R_CheckUserInterrupt();	
-		// do n rounds of selfing (j-indexed loops) g.family_size times per individual (f-indexed loops)
+		// make g.family_size doubled haploids per individual (f-indexed loops)
 		//find the parent genes, save a shallow copy to set
 		char* genes = group_genes[i];
-		int id = group_ids[i];
 		for (f = 0; f < g.family_size; ++f, ++fullness) {
 			// when cross buffer is full, save these outcomes to the file.
-			if (fullness >= 1000) {
-				outcome->n_subjects = 1000;
+			if (fullness >= d->block_capacity) {
+				generate_offspring_batch(d, 'D', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+				n_generated += fullness;
+				outcome->n_subjects = d->block_capacity;
 				// give the subjects their ids and names
 				if (g.will_name_subjects) {
 					set_subject_names(outcome, g.subject_prefix, *cross_current_id, 0);
 				}
-				for (int j = 0; j < 1000; ++j) {
+				for (int j = 0; j < d->block_capacity; ++j) {
 					++ *cross_current_id;
 					outcome->ids[j] = *cross_current_id;
 				}
 				
 				// save the subjects to files if appropriate
 				if (g.will_save_pedigree_to_file) {
-					save_AM_pedigree( fp, outcome, d);
+					save_AM_pedigree( &fp, outcome, d, &pedigree_cache);
 				}
 				if (g.will_save_effects_to_file) {
-					eff = calculate_fitness_metric( outcome, &(d->e));
-					save_fitness( fe, &eff, outcome->ids, outcome->subject_names);
+					eff = calculate_fitness_metric( d, outcome);
+					save_fitness( &fe, &eff, outcome->ids, outcome->subject_names);
 					delete_dmatrix( &eff);
 				}
 				if (g.will_save_genes_to_file) {
-					save_allele_matrix( fg, outcome, d->markers);
+					save_allele_matrix( &fg, outcome, d);
 				}
 				
 				if (g.will_save_to_simdata) {
 					last->next = outcome;
+					if (g.will_allocate_ids) {
+						index_subject_ids(d, outcome);
+					}
 					last = last->next;
-					if (n_to_go < 1000) {
-						outcome = create_empty_allelematrix(d->n_markers, n_to_go);
+					if (n_to_go < d->block_capacity) {
+						outcome = create_empty_allelematrix(d, n_to_go);
 						n_to_go = 0;
 					} else {
-						outcome = create_empty_allelematrix(d->n_markers, 1000);
-						n_to_go -= 1000;
+						outcome = create_empty_allelematrix(d, d->block_capacity);
+						n_to_go -= d->block_capacity;
 					}
 				}
 				fullness = 0; //reset the count and start refilling the matrix
 			}
 			
-			generate_doubled_haploid( d, genes, outcome->alleles[fullness] );
+			jobs[fullness].parent1_genome = genes;
+			jobs[fullness].parent2_genome = genes;
+			jobs[fullness].output = outcome->alleles[fullness];
 			outcome->groups[fullness] = output_group;
 			if (g.will_track_pedigree) {
-				outcome->pedigrees[0][fullness] = id;
-				outcome->pedigrees[1][fullness] = id;
+				outcome->pedigrees[0][fullness] = group_ids[i];
+				outcome->pedigrees[1][fullness] = group_ids[i];
 			}
 		}
 	}
+	generate_offspring_batch(d, 'D', 0, jobs, fullness, seed, n_generated + 1, g.n_threads);
+	free(jobs);
 	PutRNGstate();
 	
 	free(group_genes);
@@ -1037,21 +1140,25 @@ int make_doubled_haploids(SimData* d, int group, GenOptions g) {
 	
 	// save the subjects to files if appropriate
 	if (g.will_save_pedigree_to_file) {
-		save_AM_pedigree( fp, outcome, d);
-		fclose(fp);
+		save_AM_pedigree( &fp, outcome, d, &pedigree_cache);
+		close_output_buffer(&fp);
+		delete_pedigree_cache(&pedigree_cache);
 	}
 	if (g.will_save_effects_to_file) {
-		eff = calculate_fitness_metric( outcome, &(d->e));
-		save_fitness( fe, &eff, outcome->ids, outcome->subject_names);
+		eff = calculate_fitness_metric( d, outcome);
+		save_fitness( &fe, &eff, outcome->ids, outcome->subject_names);
 		delete_dmatrix( &eff);
-		fclose(fe);
+		close_output_buffer(&fe);
 	}
 	if (g.will_save_genes_to_file) {
-		save_allele_matrix( fg, outcome, d->markers);
-		fclose(fg);
+		save_allele_matrix( &fg, outcome, d);
+		close_output_buffer(&fg);
 	}
 	if (g.will_save_to_simdata) {
 		last->next = outcome;
+		if (g.will_allocate_ids) {
+			index_subject_ids(d, outcome);
+		}
 		condense_allele_matrix( d ); 
 		return output_group;	
 	} else {
@@ -1146,7 +1253,8 @@ int make_n_crosses_from_top_m_percent(SimData* d, int n, int m, int group, GenOp
  *
  * ...
  *
- * where each row represents a separate cross to carry out.
+ * where each row represents a separate cross to carry out. The file may be 
+ * gzip-compressed.
  *
  * Preferences in GenOptions are applied to this cross. 
  *
@@ -1162,22 +1270,20 @@ int make_crosses_from_file(SimData* d, const char* input_file, GenOptions g) {
 	}
 	
 	//open file
-	FILE* fp;
-	if ((fp = fopen(input_file, "r")) == NULL) {
-		error( "Failed to open file %s.\n", input_file);
-	}
+	gzFile fp = open_input_file(input_file);
 	
 	int combinations[2][t.num_rows];
 	char buffer[2][50];
 	// for each row in file
 	for (int i = 0; i < t.num_rows; ++i) {
 		// load the four grandparents
-		fscanf(fp, "%s %s \n", buffer[0], buffer[1]);
-		combinations[0][i] = get_index_of_name(d->m, buffer[0]);
-		combinations[1][i] = get_index_of_name(d->m, buffer[1]);		
+		read_file_word(fp, buffer[0], 49);
+		read_file_word(fp, buffer[1], 49);
+		combinations[0][i] = get_index_of_name(d, buffer[0]);
+		combinations[1][i] = get_index_of_name(d, buffer[1]);		
 	}
 	
-	fclose(fp);
+	gzclose(fp);
 	return cross_these_combinations(d, t.num_rows, combinations, g);
 }
 	
@@ -1193,7 +1299,8 @@ int make_crosses_from_file(SimData* d, const char* input_file, GenOptions g) {
  *
  * ...
  *
- * where each row represents a separate cross to carry out.
+ * where each row represents a separate cross to carry out. The file may be 
+ * gzip-compressed.
  *
  * Results of the cross [gparent1 name] x [gparent2 name] and 
  * [gparent3 name] x [gparent4 name] must have already been generated 
@@ -1215,10 +1322,7 @@ int make_double_crosses_from_file(SimData* d, const char* input_file, GenOptions
 	}
 	
 	//open file
-	FILE* fp;
-	if ((fp = fopen(input_file, "r")) == NULL) {
-		error( "Failed to open file %s.\n", input_file);
-	}
+	gzFile fp = open_input_file(input_file);
 	
 	int combinations[2][t.num_rows];
 	char buffer[4][50];
@@ -1228,8 +1332,10 @@ int make_double_crosses_from_file(SimData* d, const char* input_file, GenOptions
 	// for each row in file
 	for (int i = 0; i < t.num_rows; ++i) {
 		// load the four grandparents
-		fscanf(fp, "%s %s %s %s \n", buffer[0], buffer[1], buffer[2], buffer[3]);
-		get_ids_of_names(d->m, 4, to_buffer, g0_id);
+		for (int j = 0; j < 4; ++j) {
+			read_file_word(fp, buffer[j], 49);
+		}
+		get_ids_of_names(d, 4, to_buffer, g0_id);
 		if (g0_id[0] < 0 || g0_id[1] < 0 || g0_id[2] < 0 || g0_id[3] < 0) {
 			warning("Could not go ahead with the line %d cross - g0 names not in records\n", i);
 			combinations[0][i] = -1;
@@ -1238,15 +1344,15 @@ int make_double_crosses_from_file(SimData* d, const char* input_file, GenOptions
 		}
 		
 		// identify two parents
-		f1_i[0] = get_index_of_child(d->m, g0_id[0], g0_id[1]);
-		f1_i[1] = get_index_of_child(d->m, g0_id[2], g0_id[3]);
+		f1_i[0] = get_index_of_child(d, g0_id[0], g0_id[1]);
+		f1_i[1] = get_index_of_child(d, g0_id[2], g0_id[3]);
 		if (f1_i[0] < 0 || f1_i[1] < 0) {
 			// try different permutations of the four grandparents.
-			f1_i[0] = get_id_of_child(d->m, g0_id[0], g0_id[2]);
-			f1_i[1] = get_id_of_child(d->m, g0_id[1], g0_id[3]);
+			f1_i[0] = get_index_of_child(d, g0_id[0], g0_id[2]);
+			f1_i[1] = get_index_of_child(d, g0_id[1], g0_id[3]);
 			if (f1_i[0] < 0 || f1_i[1] < 0) {
-				f1_i[0] = get_index_of_child(d->m, g0_id[0], g0_id[3]);
-				f1_i[1] = get_index_of_child(d->m, g0_id[1], g0_id[2]);
+				f1_i[0] = get_index_of_child(d, g0_id[0], g0_id[3]);
+				f1_i[1] = get_index_of_child(d, g0_id[1], g0_id[2]);
 				if (f1_i[0] < 0 || f1_i[1] < 0) {
 					warning("Could not go ahead with the line %d cross - f1 children do not exist for this quartet\n", i);
 					combinations[0][i] = -1;
@@ -1262,7 +1368,7 @@ int make_double_crosses_from_file(SimData* d, const char* input_file, GenOptions
 		
 	}
 	
-	fclose(fp);
+	gzclose(fp);
 	return cross_these_combinations(d, t.num_rows, combinations, g);
 	
 }
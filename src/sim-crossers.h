@@ -5,11 +5,33 @@
 #include "sim-fitness.h"
 #include "sim-printers.h"
 #include "sim-groups.h"
+#include "sim-rng.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** The parents and destination of one offspring to be generated by
+ * generate_offspring_batch().
+ *
+ * @param parent1_genome the genome of the first (or only) parent.
+ * @param parent2_genome the genome of the second parent, if there is one.
+ * @param output the location to which to save the offspring's genome.
+ */
+typedef struct {
+	char* parent1_genome;
+	char* parent2_genome;
+	char* output;
+} OffspringJob;
 
 /* Crossers */
-void generate_gamete(SimData* d, char* parent_genome, char* output);
-void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char* output);
-void generate_doubled_haploid(SimData* d, char* parent_genome, char* output);
+int get_first_marker_after(SimData* d, int from, int to, float position);
+void copy_recombined_chromosome(SimData* d, int chr, const char* parent_genome, int which,
+		const float* crossover_where, int num_crossovers, char* output, int copy);
+void generate_gamete(SimData* d, char* parent_genome, char* output, int copy, RandomStream* rng);
+void generate_cross(SimData* d, char* parent1_genome, char* parent2_genome, char* output, RandomStream* rng);
+void generate_doubled_haploid(SimData* d, char* parent_genome, char* output, RandomStream* rng);
+void generate_offspring_batch(SimData* d, char method, int n_selfs, OffspringJob* jobs, 
+		int n_jobs, uint64_t seed, unsigned int first_stream, int n_threads);
 
 int cross_this_pair(SimData* d, int parent1_index, int parent2_index, GenOptions g);
 int cross_random_individuals(SimData* d, int from_group, int n_crosses, GenOptions g);
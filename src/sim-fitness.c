@@ -43,14 +43,116 @@ int split_group_by_fitness(SimData* d, int group, int top_n, int lowIsBest) {
 	return split_from_group(d, top_n, top_subjects);
 }
 
+/** Build the EffectTable of the effect values currently loaded in a SimData,
+ * for use with calculate_genotype_fitness().
+ *
+ * If alleles are stored as chars, each different allele in `d->e.effect_names`
+ * gets its own column. If they are packed, the columns are the 2-bit stored codes,
+ * and the entry for code c at marker j is the effect of the allele 
+ * `d->allele_dictionary[3*j + c - 1]`. Either way, an allele with more than one 
+ * row in the effect matrix gets the sum of its rows.
+ *
+ * @param d pointer to the SimData whose effect values and storage settings to use.
+ * @returns the EffectTable. Free it with delete_effect_table().
+ */
+EffectTable create_effect_table(SimData* d) {
+	EffectMatrix* e = &(d->e);
+	EffectTable t;
+	memset(t.codes, 0, sizeof(t.codes));
+	if (d->packed_alleles) {
+		t.width = 4;
+	} else {
+		t.width = 1;
+		for (int i = 0; i < e->effects.rows; ++i) {
+			unsigned char allele = (unsigned char) e->effect_names[i];
+			if (t.codes[allele] == 0) {
+				t.codes[allele] = t.width;
+				++ t.width;
+			}
+		}
+	}
+	
+	size_t n_entries = (size_t) d->n_markers * t.width;
+	t.effects = get_malloc(sizeof(double) * n_entries);
+	for (size_t k = 0; k < n_entries; ++k) {
+		t.effects[k] = 0;
+	}
+	
+	for (int j = 0; j < d->n_markers; ++j) {
+		double* row = t.effects + (size_t) j * t.width;
+		for (int i = 0; i < e->effects.rows; ++i) {
+			if (d->packed_alleles) {
+				for (int c = 1; c < 4; ++c) {
+					if (d->allele_dictionary[3*j + c - 1] == e->effect_names[i]) {
+						row[c] += e->effects.matrix[i][j];
+					}
+				}
+			} else {
+				row[t.codes[(unsigned char) e->effect_names[i]]] += e->effects.matrix[i][j];
+			}
+		}
+	}
+	return t;
+}
+
+/** Free the effect values of an EffectTable.
+ *
+ * @param t pointer to the EffectTable to delete.
+ */
+void delete_effect_table(EffectTable* t) {
+	free(t->effects);
+	t->effects = NULL;
+	t->width = 0;
+}
+
+/** Calculate the fitness metric/GEBV of one genotype, by walking both of its 
+ * haplotype planes once and adding up the EffectTable entries of the alleles 
+ * found at each marker.
+ *
+ * Packed genotypes are decoded a byte (4 markers) at a time.
+ *
+ * @param d pointer to the SimData whose storage settings apply to `genes`.
+ * @param t pointer to an EffectTable from create_effect_table() on `d`.
+ * @param genes the genotype, as stored in AlleleMatrix.alleles. 
+ * @returns the GEBV of the genotype.
+ */
+double calculate_genotype_fitness(const SimData* d, const EffectTable* t, const char* genes) {
+	const unsigned char* first = (const unsigned char*) get_haplotype(d, genes, 0);
+	const unsigned char* second = (const unsigned char*) get_haplotype(d, genes, 1);
+	const double* row = t->effects;
+	double fitness = 0;
+	
+	if (d->packed_alleles) {
+		int n_whole_bytes = d->n_markers >> 2;
+		for (int b = 0; b < n_whole_bytes; ++b, row += 16) {
+			unsigned int a = first[b];
+			unsigned int z = second[b];
+			fitness += row[a & 3] + row[z & 3]
+					+ row[4 + ((a >> 2) & 3)] + row[4 + ((z >> 2) & 3)]
+					+ row[8 + ((a >> 4) & 3)] + row[8 + ((z >> 4) & 3)]
+					+ row[12 + (a >> 6)] + row[12 + (z >> 6)];
+		}
+		for (int j = n_whole_bytes << 2; j < d->n_markers; ++j, row += 4) {
+			fitness += row[get_stored_allele(d, genes, j, 0)] + row[get_stored_allele(d, genes, j, 1)];
+		}
+	} else {
+		for (int j = 0; j < d->n_markers; ++j, row += t->width) {
+			fitness += row[t->codes[first[j]]] + row[t->codes[second[j]]];
+		}
+	}
+	return fitness;
+}
+
 /** Calculates the fitness metric/GEBV for each genotype in the AlleleMatrix
 * in a certain group, and returns the results in a DecimalMatrix struct.
 *
 * The GEBV is calculated for each genotype by taking the sum of (number of 
 * copies of this allele at this marker times this allele's effect at this marker) 
-* for each marker for each different allele. To do
-* this, the vector containing each allele's effect values is multiplied by a matrix 
-* containing the counts of that allele at each marker. 
+* for each marker for each different allele. This is done in one pass over each
+* genotype using an EffectTable. @see calculate_genotype_fitness()
+*
+* If the package was built with OpenMP, the group members are split between 
+* `d->n_threads` threads.
 *
 * The function exits with error code 1 if no marker effect file is loaded.
 *
@@ -66,30 +168,22 @@ DecimalMatrix calculate_fitness_metric_of_group(SimData* d, int group) {
 	}
 	
 	int group_size = get_group_size( d, group );
-	unsigned int* group_members = get_group_ids( d, group, group_size);
-	DecimalMatrix sum, counts, effect_row, product;
-	// sum is the sum of the product across all alleles. 
-	// Its dimensions are the same as those from multiplying a row of d->e.effects by
-	// a counts matrix the size of d->m.alleles
-	sum = generate_zero_dmatrix(1, group_size); 
-	
-	for (int i = 0; i < d->e.effects.rows; i++) {
-		// get the product for this allele
-		counts = calculate_count_matrix_of_allele_for_ids( d->m, group_members, group_size, d->e.effect_names[i]);
-		effect_row = subset_dmatrix_row(&(d->e.effects), i);
-		product = multiply_dmatrices(&effect_row, &counts);
-		delete_dmatrix(&counts);
-		delete_dmatrix(&effect_row);
-		
-		// add it to the total effect GEBV sum
-		add_to_dmatrix(&sum, &product);
-		///counts = sum; // use counts as a temp
-		//sum = add_dmatrices(&counts, &product);
-		//delete_dmatrix(&counts);
-		delete_dmatrix(&product);
+	char** group_genes = get_group_genes( d, group, group_size);
+	DecimalMatrix sum = generate_zero_dmatrix(1, group_size); 
+	EffectTable t = create_effect_table(d);
+	
+	R_CheckUserInterrupt();
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(d->n_threads) schedule(static) if(d->n_threads > 1)
+#endif
+	for (int i = 0; i < group_size; ++i) {
+		if (group_genes[i] != NULL) {
+			sum.matrix[0][i] = calculate_genotype_fitness(d, &t, group_genes[i]);
+		}
 	}
 	
-	free(group_members);
+	delete_effect_table(&t);
+	free(group_genes);
 	return sum;
 }
 
@@ -98,43 +192,39 @@ DecimalMatrix calculate_fitness_metric_of_group(SimData* d, int group) {
  *
  * The GEBV is calculated for each genotype by taking the sum of (number of 
  * copies of this allele at this marker times this allele's effect at this marker) 
- * for each marker for each different allele. To do
- * this, the vector containing each allele's effect values is multiplied by a matrix 
- * containing the counts of that allele at each marker. 
+ * for each marker for each different allele. This is done in one pass over each
+ * genotype using an EffectTable. @see calculate_genotype_fitness()
+ *
+ * If the package was built with OpenMP, the genotypes are split between 
+* `d->n_threads` threads.
  *
  * The function exits with error code 1 if no marker effect file is loaded.
  *
+ * @param d pointer to the SimData object whose effect values (`d->e`) are to be 
+ * used and whose storage settings apply to `m`.
  * @param m pointer to the AlleleMatrix object to which the genotypes belong.
- * @param e pointer to the EffectMatrix that effect values have been loaded into.
  * @returns A DecimalMatrix containing the score for each individual in the group.
  */
-DecimalMatrix calculate_fitness_metric( AlleleMatrix* m, EffectMatrix* e) {
+DecimalMatrix calculate_fitness_metric( SimData* d, AlleleMatrix* m) {
 	// check that both of the items to be multiplied exist.
-	if (e->effects.rows < 1 || m->alleles == NULL) {
+	if (d->e.effects.rows < 1 || m->alleles == NULL) {
 		error("Either effect matrix or allele matrix does not exist\n");
 	}
 	
-	DecimalMatrix sum, counts, effect_row, product;
-	// sum is the sum of the product across all alleles. 
-	// Its dimensions are the same as those from multiplying a row of d->e.effects by
-	// a counts matrix the size of d->m.alleles
-	sum = generate_zero_dmatrix(1, m->n_subjects); 
+	DecimalMatrix sum = generate_zero_dmatrix(1, m->n_subjects); 
+	EffectTable t = create_effect_table(d);
 	
-	for (int i = 0; i < e->effects.rows; i++) {
-		// get the product for this allele
-		counts = calculate_full_count_matrix_of_allele( m, e->effect_names[i]);
-		effect_row = subset_dmatrix_row(&(e->effects), i);
-		product = multiply_dmatrices(&effect_row, &counts);
-		delete_dmatrix(&counts);
-		delete_dmatrix(&effect_row);
-		
-		// add it to the total effect GEBV sum
-		counts = sum; // use counts as a temp
-		sum = add_dmatrices(&counts, &product);
-		delete_dmatrix(&counts);
-		delete_dmatrix(&product);
+	R_CheckUserInterrupt();
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(d->n_threads) schedule(static) if(d->n_threads > 1)
+#endif
+	for (int i = 0; i < m->n_subjects; ++i) {
+		if (m->alleles[i] != NULL) {
+			sum.matrix[0][i] = calculate_genotype_fitness(d, &t, m->alleles[i]);
+		}
 	}
 	
+	delete_effect_table(&t);
 	return sum;
 }
 
@@ -143,8 +233,8 @@ DecimalMatrix calculate_fitness_metric( AlleleMatrix* m, EffectMatrix* e) {
  * Returns the result as a DecimalMatrix. Useful for multiplying to effect matrix
  * to calculate GEBVs.
  *
- * @param m pointer to the start of a linked list that contains the alleles 
- * of each genotype in `for_ids`.
+ * @param d pointer to the SimData whose linked list of AlleleMatrix contains
+ * the alleles of each genotype in `for_ids`.
  * @param for_ids poinder to an array of ids of different genotypes. 
  * @param n_ids number of genotypes to calculate the counts of/length of 
  * `for_ids`
@@ -152,14 +242,15 @@ DecimalMatrix calculate_fitness_metric( AlleleMatrix* m, EffectMatrix* e) {
  * @returns A DecimalMatrix countaining the number of `allele` occurences at 
  * each row/marker for each column/genotype in `for_ids`.
  * */
-DecimalMatrix calculate_count_matrix_of_allele_for_ids( AlleleMatrix* m, unsigned int* for_ids, unsigned int n_ids, char allele) {
+DecimalMatrix calculate_count_matrix_of_allele_for_ids( SimData* d, unsigned int* for_ids, unsigned int n_ids, char allele) {
+	AlleleMatrix* m = d->m;
 	DecimalMatrix counts = generate_zero_dmatrix(m->n_markers, n_ids);
 	double cell_sum;
 	char* genes;
 
 	for (int i = 0; i < n_ids; i++) {
 		R_CheckUserInterrupt();
-		genes = get_genes_of_id( m, for_ids[i] );
+		genes = get_genes_of_id( d, for_ids[i] );
 		
 		cell_sum = 0;
 		if (genes == NULL) {
@@ -168,10 +259,10 @@ DecimalMatrix calculate_count_matrix_of_allele_for_ids( AlleleMatrix* m, unsigne
 		
 		for (int j = 0; j < m->n_markers; j++) {
 			cell_sum = 0;
-			if (genes[2*j] == allele) {
+			if (get_allele(d, genes, j, 0) == allele) {
 				cell_sum += 1;
 			}
-			if (genes[2*j + 1] == allele) {
+			if (get_allele(d, genes, j, 1) == allele) {
 				cell_sum += 1;
 			}
 			counts.matrix[j][i] = cell_sum;
@@ -185,12 +276,13 @@ DecimalMatrix calculate_count_matrix_of_allele_for_ids( AlleleMatrix* m, unsigne
  * Returns the result as a DecimalMatrix. Useful for multiplying to effect matrix
  * to calculate GEBVs.
  *
+ * @param d pointer to the SimData to which the AlleleMatrix belongs.
  * @param m pointer to the AlleleMatrix that contains the genotypes to count alleles.
  * @param allele the single-character allele to be counting.
  * @returns A DecimalMatrix countaining the number of `allele` occurences at 
  * each row/marker for each column/genotype in the AlleleMatrix.
  * */
-DecimalMatrix calculate_full_count_matrix_of_allele( AlleleMatrix* m, char allele) {
+DecimalMatrix calculate_full_count_matrix_of_allele( SimData* d, AlleleMatrix* m, char allele) {
 	DecimalMatrix counts = generate_zero_dmatrix(m->n_markers, m->n_subjects);
 	double cell_sum;
 	char* genes;
@@ -206,10 +298,10 @@ DecimalMatrix calculate_full_count_matrix_of_allele( AlleleMatrix* m, char allel
 		
 		for (int j = 0; j < m->n_markers; j++) {
 			cell_sum = 0;
-			if (genes[2*j] == allele) {
+			if (get_allele(d, genes, j, 0) == allele) {
 				cell_sum += 1;
 			}
-			if (genes[2*j + 1] == allele) {
+			if (get_allele(d, genes, j, 1) == allele) {
 				cell_sum += 1;
 			}
 			counts.matrix[j][i] = cell_sum;
@@ -329,7 +421,8 @@ MarkerBlocks create_n_blocks_by_chr(SimData* d, int n) {
  *
  * @param d pointer to the SimData object to which the groups and individuals belong.
  * It must have a marker effect file loaded to successfully run this function.
- * @param block_file string containing filename of the file with blocks
+ * @param block_file string containing filename of the file with blocks. It 
+ * may be gzip-compressed.
  * @returns a struct containing the markers identified as belonging to each block
  * according to their definitions in the file.
  */
@@ -341,10 +434,7 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
 	blocks.num_markers_in_block = get_malloc(sizeof(int) * blocks.num_blocks);
 	blocks.markers_in_block = get_malloc(sizeof(int*) * blocks.num_blocks);
 	
-	FILE* infile;
-	if ((infile = fopen(block_file, "r")) == NULL) {
-		error("Failed to open file %s.\n", block_file);
-	}
+	gzFile infile = open_input_file(block_file);
 	
 	int bufferlen = d->n_markers;
 	char markername[bufferlen];
@@ -352,10 +442,15 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
 	int bi = 0; // block number
 	
 	// Ignore the first line
-	fscanf(infile, "%*[^\n]\n");
+	int c;
+	while ((c = gzgetc(infile)) != -1 && c != '\n');
   
-	// Loop through rows of the file (each row corresponds to a block)
-	while (fscanf(infile, "%*d %*f %*s %*s ") != EOF) {
+	// Loop through rows of the file (each row corresponds to a block), 
+	// skipping the four ignored columns at the start of each
+	while (bi < blocks.num_blocks && read_file_word(infile, markername, 0) >= 0) {
+		for (int i = 1; i < 4; ++i) {
+			read_file_word(infile, markername, 0);
+		}
 	//for (int bi = 0; bi < n_blocks; ++bi) { 
 	
 		// Indexes in play:
@@ -363,15 +458,15 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
 		//		ni: number of characters so far in the name of the next marker being read from the file
 		//		mi: number of markers that have so far been read from the file for this block
 		blocks.num_markers_in_block[bi] = 0;
-		int c, ni = 0, mi = 0;
+		int ni = 0, mi = 0;
 		
 		memset(markerbuffer, 0, sizeof(int) * bufferlen);
-		while ((c = fgetc(infile)) != EOF && c !='\n') {
+		while ((c = gzgetc(infile)) != -1 && c !='\n') {
 			if (c == ';') {
 				markername[ni] = '\0';
         
 				// identify the index of this marker and save it in the temporary marker buffer `markerbuffer`
-				int markerindex = get_from_unordered_str_list(markername, d->markers, d->n_markers);
+				int markerindex = get_index_of_marker(d, markername);
 				if (markerindex >= 0) {
 					++(blocks.num_markers_in_block[bi]);
 					markerbuffer[mi] = markerindex;
@@ -379,7 +474,7 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
 				}
         
 				ni = 0;
-			} else {
+			} else if (!isspace(c)) {
 				markername[ni] = c;
 				++ni;
 			}
@@ -394,7 +489,7 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
 		++bi;
 	}
 
-	fclose(infile);
+	gzclose(infile);
 	return blocks;
 }
 
@@ -419,30 +514,30 @@ MarkerBlocks read_block_file(SimData* d, const char* block_file) {
  * It must have a marker effect file loaded to successfully run this function.
  * @param b struct containing the blocks to use
  * @param output_file string containing the filename of the file to which output 
- * block effects/local GEBVs will be saved.
+ * block effects/local GEBVs will be saved. If it ends in ".gz", the output is 
+ * gzip-compressed.
  * @param group group number from which to split the top individuals.
  */
 void calculate_group_block_effects(SimData* d, MarkerBlocks b, const char* output_file, int group) {
 	
-	FILE* outfile;
-	if ((outfile = fopen(output_file, "w")) == NULL) {
-		error("Failed to open file %s.\n", output_file);
-	}
-	
-	int bufferlen = 100;
-	char buffer[bufferlen];
+	OutputBuffer outfile = open_output_buffer(output_file, FALSE);
 	
 	int gsize = get_group_size(d, group);
 	char** ggenos = get_group_genes(d, group, gsize);
 	char** gnames = get_group_names(d, group, gsize);
+	unsigned int* gids = get_group_ids(d, group, gsize);
 	
 	double beffect;
 	
 	// for each group member
 	for (int i = 0; i < gsize; ++i) {
 		// for each block
-		sprintf(buffer, "%s_1", gnames[i]);
-		fwrite(buffer, sizeof(char), strlen(buffer), outfile);
+		if (gnames[i] != NULL) {
+			write_string(&outfile, gnames[i]);
+		} else {
+			write_uint(&outfile, gids[i]);
+		}
+		write_chars(&outfile, "_1", 2);
 		
 		// for each block
 		for (int j = 0; j < b.num_blocks; ++j) {
@@ -451,19 +546,24 @@ void calculate_group_block_effects(SimData* d, MarkerBlocks b, const char* outpu
 			// calculate the local GEBV
 			for (int k = 0; k < b.num_markers_in_block[j]; ++k) {	
 				for (int q = 0; q < d->e.effects.rows; ++q) {			
-					if (ggenos[i][2 * b.markers_in_block[j][k]] == d->e.effect_names[q]) {
+					if (get_allele(d, ggenos[i], b.markers_in_block[j][k], 0) == d->e.effect_names[q]) {
 						beffect += d->e.effects.matrix[q][b.markers_in_block[j][k]];
 					}
 				}	
 			}
 			
 			// print the local GEBV
-			fprintf(outfile, " %lf", beffect);
-			fflush(outfile);
+			write_char(&outfile, ' ');
+			write_decimal(&outfile, beffect);
 		}
 		
-		sprintf(buffer, "\n%s_2", gnames[i]);
-		fwrite(buffer, sizeof(char), strlen(buffer), outfile);
+		write_char(&outfile, '\n');
+		if (gnames[i] != NULL) {
+			write_string(&outfile, gnames[i]);
+		} else {
+			write_uint(&outfile, gids[i]);
+		}
+		write_chars(&outfile, "_2", 2);
 		
 		// for each block for the second haplotype
 		for (int j = 0; j < b.num_blocks; ++j) {
@@ -471,24 +571,24 @@ void calculate_group_block_effects(SimData* d, MarkerBlocks b, const char* outpu
 			// calculate the local GEBV
 			for (int k = 0; k < b.num_markers_in_block[j]; ++k) {	
 				for (int q = 0; q < d->e.effects.rows; ++q) {			
-					if (ggenos[i][2 * b.markers_in_block[j][k] + 1] == d->e.effect_names[q]) {
+					if (get_allele(d, ggenos[i], b.markers_in_block[j][k], 1) == d->e.effect_names[q]) {
 						beffect += d->e.effects.matrix[q][b.markers_in_block[j][k]];
 					}		
 				}	
 			}
 			
 			// print the local GEBV
-			fprintf(outfile, " %lf", beffect);
-			fflush(outfile);
+			write_char(&outfile, ' ');
+			write_decimal(&outfile, beffect);
 		}
-		fwrite("\n", sizeof(char), 1, outfile);
+		write_char(&outfile, '\n');
 	}
 	
 	free(ggenos);
 	free(gnames);
+	free(gids);
 	
-	fflush(outfile);
-	fclose(outfile);
+	close_output_buffer(&outfile);
 	return;
 }
 
@@ -513,16 +613,11 @@ void calculate_group_block_effects(SimData* d, MarkerBlocks b, const char* outpu
  * It must have a marker effect file loaded to successfully run this function.
  * @param b struct containing the blocks to use
  * @param output_file string containing the filename of the file to which output 
- * block effects/local GEBVs will be saved.
+ * block effects/local GEBVs will be saved. If it ends in ".gz", the output is 
+ * gzip-compressed.
  */
 void calculate_all_block_effects(SimData* d, MarkerBlocks b, const char* output_file) {
-	FILE* outfile;
-	if ((outfile = fopen(output_file, "w")) == NULL) {
-		error( "Failed to open file %s.\n", output_file);
-	}
-	
-	int bufferlen = 100;
-	char buffer[bufferlen];
+	OutputBuffer outfile = open_output_buffer(output_file, FALSE);
 	
 	int gsize = 0;
 	AlleleMatrix* m = d->m;
@@ -538,8 +633,12 @@ void calculate_all_block_effects(SimData* d, MarkerBlocks b, const char* output_
 	do {
 		for (int i = 0; i < m->n_subjects; ++i, ++total_i) {
 			// for each block
-			sprintf(buffer, "%s_1", m->subject_names[i]);
-			fwrite(buffer, sizeof(char), strlen(buffer), outfile);
+			if (m->subject_names[i] != NULL) {
+				write_string(&outfile, m->subject_names[i]);
+			} else {
+				write_uint(&outfile, m->ids[i]);
+			}
+			write_chars(&outfile, "_1", 2);
 			
 			// for each block
 			for (int j = 0; j < b.num_blocks; ++j) {
@@ -548,19 +647,24 @@ void calculate_all_block_effects(SimData* d, MarkerBlocks b, const char* output_
 				// calculate the local GEBV
 				for (int k = 0; k < b.num_markers_in_block[j]; ++k) {	
 					for (int q = 0; q < d->e.effects.rows; ++q) {			
-						if (m->alleles[i][2 * b.markers_in_block[j][k]] == d->e.effect_names[q]) {
+						if (get_allele(d, m->alleles[i], b.markers_in_block[j][k], 0) == d->e.effect_names[q]) {
 							beffect += d->e.effects.matrix[q][b.markers_in_block[j][k]];
 						}
 					}	
 				}
 				
 				// print the local GEBV
-				fprintf(outfile, " %lf", beffect);
-				fflush(outfile);
+				write_char(&outfile, ' ');
+				write_decimal(&outfile, beffect);
 			}
 			
-			sprintf(buffer, "\n%s_2", m->subject_names[i]);
-			fwrite(buffer, sizeof(char), strlen(buffer), outfile);
+			write_char(&outfile, '\n');
+			if (m->subject_names[i] != NULL) {
+				write_string(&outfile, m->subject_names[i]);
+			} else {
+				write_uint(&outfile, m->ids[i]);
+			}
+			write_chars(&outfile, "_2", 2);
 			
 			// for each block for the second haplotype
 			for (int j = 0; j < b.num_blocks; ++j) {
@@ -568,22 +672,21 @@ void calculate_all_block_effects(SimData* d, MarkerBlocks b, const char* output_
 				// calculate the local GEBV
 				for (int k = 0; k < b.num_markers_in_block[j]; ++k) {	
 					for (int q = 0; q < d->e.effects.rows; ++q) {			
-						if (m->alleles[i][2 * b.markers_in_block[j][k] + 1] == d->e.effect_names[q]) {
+						if (get_allele(d, m->alleles[i], b.markers_in_block[j][k], 1) == d->e.effect_names[q]) {
 							beffect += d->e.effects.matrix[q][b.markers_in_block[j][k]];
 						}		
 					}	
 				}
 				
 				// print the local GEBV
-				fprintf(outfile, " %lf", beffect);
-				fflush(outfile);
+				write_char(&outfile, ' ');
+				write_decimal(&outfile, beffect);
 			}
-			fwrite("\n", sizeof(char), 1, outfile);
+			write_char(&outfile, '\n');
 		}
 	} while ((m = m->next) != NULL);
 	
-	fflush(outfile);
-	fclose(outfile);
+	close_output_buffer(&outfile);
 	return;
 }
 
@@ -711,8 +814,8 @@ int* calculate_min_recombinations_fw1(SimData* d, char* parent1, unsigned int p1
 		R_CheckUserInterrupt();
 		previous = 0;
 		for (int i = d->map.chr_ends[chr - 1]; i < d->map.chr_ends[chr]; ++i) {
-			p1match = has_same_alleles(parent1, offspring, i);
-			p2match = has_same_alleles(parent2, offspring, i);
+			p1match = has_same_alleles(d, parent1, offspring, i);
+			p2match = has_same_alleles(d, parent2, offspring, i);
 			if (p1match && !p2match) {
 				origins[i] = p1num;
 				previous = p1num;
@@ -774,6 +877,9 @@ int* calculate_min_recombinations_fwn(SimData* d, char* parent1, unsigned int p1
 	int* origins = malloc(sizeof(int) * d->n_markers);
 	int p1match, p2match;
 	int previous = 0, window_range = (window_size - 1)/2, i;
+	// the window checked for marker i covers markers i - window_range to 
+	// i - window_range + window_size - 1 inclusive.
+	int window_after = window_size - 1 - window_range;
 	int lookable_bounds[2];
 	
 	// treat each chromosome separately.
@@ -781,15 +887,15 @@ int* calculate_min_recombinations_fwn(SimData* d, char* parent1, unsigned int p1
 		R_CheckUserInterrupt();
 		previous = 0;
 		lookable_bounds[0] = d->map.chr_ends[chr - 1] + window_range;
-		lookable_bounds[1] = d->map.chr_ends[chr] - window_range;
+		lookable_bounds[1] = d->map.chr_ends[chr] - window_after;
 		
 		for (i = d->map.chr_ends[chr - 1]; i < lookable_bounds[0]; ++i) {
 			origins[i] = 0;
 		}
 		for (; i < lookable_bounds[1]; ++i) {
 			
-			p1match = has_same_alleles_window(parent1, offspring, i, window_size);
-			p2match = has_same_alleles_window(parent2, offspring, i, window_size);
+			p1match = has_same_alleles_window(d, parent1, offspring, i - window_range, window_size);
+			p2match = has_same_alleles_window(d, parent2, offspring, i - window_range, window_size);
 			if (p1match && !p2match) {
 				origins[i] = p1num;
 				previous = p1num;
@@ -854,8 +960,9 @@ static inline int has_same_alleles_window(char* g1, char* g2, int start, int w)
  *
  * @param d pointer to the SimData struct containing the genotypes and map under consideration.
  * @param input_file string containing the name of the file with the pairs of parents
- * and offsprings of which to calculate recombinations
+ * and offsprings of which to calculate recombinations. It may be gzip-compressed.
  * @param output_file string containing the filename to which to save the results.
+ * If it ends in ".gz", the output is gzip-compressed.
  * @param window_len an odd integer representing the number of markers to check for known parentage
  * around each marker
  * @param certain TRUE to fill locations where parentage is unknown with 0, FALSE
@@ -866,18 +973,13 @@ int calculate_recombinations_from_file(SimData* d, const char* input_file, const
 		int window_len, int certain) {
 	struct TableSize t = get_file_dimensions(input_file, '\t');
 	//open file
-	FILE* fp;
-	if ((fp = fopen(input_file, "r")) == NULL) {
-		error( "Failed to open file %s.\n", input_file);
-	}
-	FILE* fpo;
-	if ((fpo = fopen(output_file, "w")) == NULL) {
-		error( "Failed to open file %s.\n", output_file);
-	}
+	gzFile fp = open_input_file(input_file);
+	OutputBuffer fpo = open_output_buffer(output_file, FALSE);
 	
 	// print header.
 	for (int j = 0; j < d->n_markers; ++j) {
-		fprintf(fpo, "\t%s", d->markers[j]);
+		write_char(&fpo, '\t');
+		write_string(&fpo, d->markers[j]);
 	}
 	
 	int combin_i[3];
@@ -887,10 +989,12 @@ int calculate_recombinations_from_file(SimData* d, const char* input_file, const
 	// for each row in file
 	for (int i = 0; i < t.num_rows; ++i) {
 		// load the four grandparents
-		fscanf(fp, "%s %s %s \n", buffer[0], buffer[1], buffer[2]);
-		combin_i[0] = get_index_of_name(d->m, buffer[0]);
-		combin_i[1] = get_index_of_name(d->m, buffer[1]);
-		combin_i[2] = get_index_of_name(d->m, buffer[2]);
+		for (int j = 0; j < 3; ++j) {
+			read_file_word(fp, buffer[j], 49);
+		}
+		combin_i[0] = get_index_of_name(d, buffer[0]);
+		combin_i[1] = get_index_of_name(d, buffer[1]);
+		combin_i[2] = get_index_of_name(d, buffer[2]);
 		combin_genes[0] = get_genes_of_index(d->m, combin_i[0]);
 		combin_genes[1] = get_genes_of_index(d->m, combin_i[1]);
 		combin_genes[2] = get_genes_of_index(d->m, combin_i[2]);
@@ -904,16 +1008,17 @@ int calculate_recombinations_from_file(SimData* d, const char* input_file, const
 					get_id_of_index(d->m, combin_i[1]), combin_genes[2], 
 					get_id_of_index(d->m, combin_i[2]), combin_genes[0], window_len, certain);
 		}
-		fprintf(fpo, "\n%s", buffer[0]);
+		write_char(&fpo, '\n');
+		write_string(&fpo, buffer[0]);
 		for (int j = 0; j < d->n_markers; ++j) {
-			fprintf(fpo, "\t%d", r[j]);
+			write_char(&fpo, '\t');
+			write_int(&fpo, r[j]);
 		}
 		free(r);
 	}
 	
-	fclose(fp);
-	fwrite("\n", sizeof(char), 1, fpo);
-	fflush(fpo);
-	fclose(fpo);
+	gzclose(fp);
+	write_char(&fpo, '\n');
+	close_output_buffer(&fpo);
 	return 0;
 }
\ No newline at end of file
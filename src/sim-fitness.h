@@ -3,13 +3,37 @@
 
 #include "sim-utils.h"
 #include "sim-groups.h"
+#include "sim-output.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** A table of the effect of every possible stored allele value at every marker,
+ * used to calculate GEBVs in one pass over each genotype.
+ *
+ * @param width the number of table entries per marker. 
+ * @param codes maps each allele char to its column in the table, if alleles are 
+ * stored as chars. Alleles with no effect map to column 0. Unused if alleles are 
+ * packed, as the 2-bit stored codes are used as columns directly.
+ * @param effects heap array of `width` effect values per marker. The summed effect
+ * of the allele with column c at marker j is at index j * width + c. Column 0 is
+ * always zero.
+ */
+typedef struct {
+	int width;
+	unsigned char codes[256];
+	double* effects;
+} EffectTable;
 
 /* Fitness calculators */
+EffectTable create_effect_table(SimData* d);
+void delete_effect_table(EffectTable* t);
+double calculate_genotype_fitness(const SimData* d, const EffectTable* t, const char* genes);
 int split_group_by_fitness(SimData* d, int group, int top_n, int lowIsBest);
 DecimalMatrix calculate_fitness_metric_of_group(SimData* d, int group);
-DecimalMatrix calculate_fitness_metric( AlleleMatrix* m, EffectMatrix* e);
-DecimalMatrix calculate_count_matrix_of_allele_for_ids( AlleleMatrix* m, unsigned int* for_ids, unsigned int n_ids, char allele);
-DecimalMatrix calculate_full_count_matrix_of_allele( AlleleMatrix* m, char allele);
+DecimalMatrix calculate_fitness_metric( SimData* d, AlleleMatrix* m);
+DecimalMatrix calculate_count_matrix_of_allele_for_ids( SimData* d, unsigned int* for_ids, unsigned int n_ids, char allele);
+DecimalMatrix calculate_full_count_matrix_of_allele( SimData* d, AlleleMatrix* m, char allele);
 
 MarkerBlocks create_n_blocks_by_chr(SimData* d, int n);
 MarkerBlocks read_block_file(SimData* d, const char* block_file);
@@ -33,15 +57,17 @@ int calculate_recombinations_from_file(SimData* d, const char* input_file, const
  * one allele. Checks only 3 of four possible permutations because assumes
  * there cannot be more than two alleles at a given marker.
  *
+ * @param d pointer to the SimData whose storage settings apply to the genotypes.
  * @param p1 pointer to a character array genotype of the type stored in an AlleleMatrix
- * (2*n_markers long, representing the two alleles at a marker consecutively) for the first
- * of the genotypes to compare.
+ * for the first of the genotypes to compare.
  * @param p2 pointer to a character array genotype for the second of the genotypes to compare.
  * @param i index of the marker at which to perform the check
  * @returns boolean result of the check
  */
-static inline int has_same_alleles(char* p1, char* p2, int i) {
-	return (p1[i<<1] == p2[i<<1] || p1[(i<<1) + 1] == p2[i] || p1[i] == p2[(i<<1) + 1]);
+static inline int has_same_alleles(const SimData* d, const char* p1, const char* p2, int i) {
+	unsigned char a0 = get_stored_allele(d, p1, i, 0);
+	unsigned char b0 = get_stored_allele(d, p2, i, 0);
+	return (a0 == b0 || get_stored_allele(d, p1, i, 1) == b0 || a0 == get_stored_allele(d, p2, i, 1));
 }
 // w is window length, i is start value
 /** Simple operator to determine if at markers with indexes i to i+w inclusive, two genotypes 
@@ -49,20 +75,18 @@ static inline int has_same_alleles(char* p1, char* p2, int i) {
  * because assumes there cannot be more than two alleles at a given marker. For the return value
  * to be true, there must be at least one match at every one of the markers in the window.
  *
+ * @param d pointer to the SimData whose storage settings apply to the genotypes.
  * @param g1 pointer to a character array genotype of the type stored in an AlleleMatrix
- * (2*n_markers long, representing the two alleles at a marker consecutively) for the first
- * of the genotypes to compare.
+ * for the first of the genotypes to compare.
  * @param g2 pointer to a character array genotype for the second of the genotypes to compare.
  * @param start index of the first marker in the window over which to perform the check
  * @param w length of the window over which to perform the check
  * @returns boolean result of the check
  */
-static inline int has_same_alleles_window(char* g1, char* g2, int start, int w) {
+static inline int has_same_alleles_window(const SimData* d, const char* g1, const char* g2, int start, int w) {
 	int same = TRUE;
-	int i;
 	for (int j = 0; j < w; ++j) {
-		i = start + j;
-		same = same && (g1[i<<1] == g2[i<<1] || g1[(i<<1) + 1] == g2[i] || g1[i] == g2[(i<<1) + 1]);
+		same = same && has_same_alleles(d, g1, g2, start + j);
 	}
 	return same;
 }
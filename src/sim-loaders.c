@@ -1,5 +1,413 @@
 #include "sim-loaders.h"
 
+/*--------------------------------File reading-------------------------------*/
+
+/** Find the start and end of every non-blank line in a file's contents.
+ *
+ * Lines are found with memchr, so this is a quick scan at memory speed 
+ * that does not look inside the lines. A line containing only spaces, tabs
+ * or a carriage return counts as blank.
+ *
+ * @param f the file contents to split into lines.
+ * @returns a TextLines listing the non-blank lines in order. It should be 
+ * released with delete_text_lines().
+ */
+TextLines find_text_lines(const MappedFile* f) {
+	TextLines lines = { .n_lines = 0, .starts = NULL, .ends = NULL };
+	int capacity = 0;
+	const char* pos = f->data;
+	const char* file_end = f->data + f->length;
+	
+	while (pos < file_end) {
+		const char* line_end = memchr(pos, '\n', file_end - pos);
+		if (line_end == NULL) {
+			line_end = file_end;
+		}
+		
+		const char* check = pos;
+		while (check < line_end && is_cell_separator(*check)) {
+			++check;
+		}
+		if (check < line_end) {
+			if (lines.n_lines >= capacity) {
+				capacity = capacity > 0 ? 2 * capacity : 1024;
+				lines.starts = get_realloc(lines.starts, sizeof(char*) * capacity);
+				lines.ends = get_realloc(lines.ends, sizeof(char*) * capacity);
+			}
+			lines.starts[lines.n_lines] = pos;
+			lines.ends[lines.n_lines] = line_end;
+			++ lines.n_lines;
+		}
+		
+		pos = line_end + 1;
+	}
+	return lines;
+}
+
+/** Deletes a TextLines and frees its memory. The file contents it pointed 
+ * into are not touched. 
+ *
+ * @param lines pointer to the TextLines to be cleared.
+ */
+void delete_text_lines(TextLines* lines) {
+	if (lines->starts != NULL) {
+		free(lines->starts);
+	}
+	if (lines->ends != NULL) {
+		free(lines->ends);
+	}
+	lines->starts = NULL;
+	lines->ends = NULL;
+	lines->n_lines = 0;
+}
+
+/** Copy a cell found by next_cell() into a new null-terminated string.
+ *
+ * @param cell pointer to the first character of the cell.
+ * @param length the number of characters in the cell.
+ * @returns a heap string containing the cell.
+ */
+char* copy_cell(const char* cell, int length) {
+	char* s = get_malloc(sizeof(char) * (length + 1));
+	memcpy(s, cell, length);
+	s[length] = '\0';
+	return s;
+}
+
+/** Open a text file, which may be gzip-compressed, to be read line by line.
+ * Compression is detected from the file's contents, not its name.
+ *
+ * @param filename name/path of the file.
+ * @returns a LineStream positioned at the start of the file. It should be 
+ * released with close_line_stream().
+ */
+LineStream open_line_stream(const char* filename) {
+	LineStream s;
+	s.file = open_input_file(filename);
+	s.capacity = 1 << 20;
+	s.buffer = get_malloc(sizeof(char) * s.capacity);
+	s.start = 0;
+	s.end = 0;
+	s.at_eof = FALSE;
+	return s;
+}
+
+/** Get the next line of a LineStream. Blank lines are returned too.
+ *
+ * The line stays valid until the next call. Lines can be of any length: the 
+ * stream's buffer grows to fit the longest line read.
+ *
+ * @param s pointer to the LineStream to read from.
+ * @param line_start location to save a pointer to the first character of the line.
+ * @param line_end location to save a pointer to the character just past the 
+ * end of the line (not including its newline).
+ * @returns TRUE if a line was found, FALSE if the end of the file was reached.
+ */
+int next_line(LineStream* s, const char** line_start, const char** line_end) {
+	size_t searched = s->start;
+	while (1) {
+		char* newline = memchr(s->buffer + searched, '\n', s->end - searched);
+		if (newline != NULL) {
+			*line_start = s->buffer + s->start;
+			*line_end = newline;
+			s->start = newline + 1 - s->buffer;
+			return TRUE;
+		}
+		if (s->at_eof) {
+			if (s->start == s->end) {
+				return FALSE;
+			}
+			// the last line has no newline
+			*line_start = s->buffer + s->start;
+			*line_end = s->buffer + s->end;
+			s->start = s->end;
+			return TRUE;
+		}
+		
+		// make room for more of the file, keeping the part-line we have
+		searched = s->end - s->start;
+		if (s->start > 0) {
+			memmove(s->buffer, s->buffer + s->start, searched);
+			s->start = 0;
+			s->end = searched;
+		}
+		if (s->end == s->capacity) {
+			s->capacity *= 2;
+			s->buffer = get_realloc(s->buffer, sizeof(char) * s->capacity);
+		}
+		int n_read = gzread(s->file, s->buffer + s->end, s->capacity - s->end);
+		if (n_read < 0) {
+			int errnum;
+			error( "Failed to read file: %s\n", gzerror(s->file, &errnum));
+		}
+		if (n_read == 0) {
+			s->at_eof = TRUE;
+		}
+		s->end += n_read;
+	}
+}
+
+/** Close a LineStream and free its buffer.
+ *
+ * @param s pointer to the LineStream to close.
+ */
+void close_line_stream(LineStream* s) {
+	if (s->file != NULL) {
+		gzclose(s->file);
+		s->file = NULL;
+	}
+	if (s->buffer != NULL) {
+		free(s->buffer);
+		s->buffer = NULL;
+	}
+}
+
+/** Create a new, unlinked chain of empty AlleleMatrix blocks with space for
+ * a given number of genotypes, each block holding up to `d->block_capacity`.
+ *
+ * @param d pointer to the SimData the blocks are for.
+ * @param n_genotypes the total number of genotypes the chain should hold.
+ * @returns pointer to the first AlleleMatrix in the chain.
+ */
+static AlleleMatrix* create_allelematrix_chain(SimData* d, int n_genotypes) {
+	AlleleMatrix* first = create_empty_allelematrix(d, 
+			n_genotypes < d->block_capacity ? n_genotypes : d->block_capacity);
+	AlleleMatrix* current_am = first;
+	for (int n_to_go = n_genotypes - first->n_subjects; n_to_go > 0; n_to_go -= current_am->n_subjects) {
+		current_am->next = create_empty_allelematrix(d, 
+				n_to_go < d->block_capacity ? n_to_go : d->block_capacity);
+		current_am = current_am->next;
+	}
+	return first;
+}
+
+/** Save the genotype names from the header line of a transposed genotype table
+ * into a chain of AlleleMatrix blocks, and put all of them in a group.
+ *
+ * @param first pointer to the first AlleleMatrix of the chain to fill.
+ * @param pos pointer to the start of the header line.
+ * @param line_end pointer to the end of the header line.
+ * @param group the group number to give the genotypes.
+ */
+static void load_transposed_header(AlleleMatrix* first, const char* pos, const char* line_end, int group) {
+	int length;
+	next_cell(&pos, line_end, &length); // discard the column title that is not a line
+	
+	for (AlleleMatrix* current_am = first; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am) {
+			const char* cell = next_cell(&pos, line_end, &length);
+			current_am->subject_names[i_am] = copy_cell(cell, length);
+			current_am->groups[i_am] = group;
+		}
+	}
+}
+
+/** Save one allele of a genotype being loaded. Like set_allele(), but reports
+ * a marker with too many alleles to be stored packed instead of exiting, so 
+ * that it can be used inside a parallel region.
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype to modify.
+ * @param marker index of the marker at which to write the allele.
+ * @param copy 0 to write the first allele at that marker, 1 to write the second.
+ * @param allele the allele to save.
+ * @returns TRUE if the allele was saved, FALSE if it could not be stored packed.
+ */
+static inline int load_allele(SimData* d, char* genes, int marker, int copy, char allele) {
+	if (d->packed_alleles) {
+		int code = find_allele_code(d, marker, allele);
+		if (code < 0) {
+			return FALSE;
+		}
+		set_stored_allele(d, genes, marker, copy, code);
+	} else {
+		set_stored_allele(d, genes, marker, copy, (unsigned char) allele);
+	}
+	return TRUE;
+}
+
+/** Parse one marker's row of a transposed genotype table of allele pairs, 
+ * saving the alleles to a chain of AlleleMatrix blocks.
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param first pointer to the first AlleleMatrix of the chain to fill. The chain
+ * holds one genotype for each cell of the row.
+ * @param marker index of the marker in `d->markers` this row describes.
+ * @param pos pointer to the first cell after the marker name in the row.
+ * @param line_end pointer to the end of the row.
+ * @param bad_cells pointer to a count, which is increased by the number of 
+ * cells in the row that were not allele pairs.
+ * @returns TRUE if the row was loaded, FALSE if the marker had too many 
+ * alleles to be stored packed.
+ */
+static int load_transposed_row(SimData* d, AlleleMatrix* first, int marker, const char* pos, const char* line_end, int* bad_cells) {
+	int length;
+	for (AlleleMatrix* current_am = first; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am) {
+			const char* cell = next_cell(&pos, line_end, &length);
+			if (length != 2) {
+				++ *bad_cells;
+			}
+			if (!load_allele(d, current_am->alleles[i_am], marker, 0, length > 0 ? cell[0] : '\0') ||
+					!load_allele(d, current_am->alleles[i_am], marker, 1, length > 1 ? cell[1] : '\0')) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/** Parse one marker's row of a transposed genotype table of IUPAC codes, 
+ * saving the alleles to a chain of AlleleMatrix blocks. 
+ * @see load_transposed_encoded_genes_to_simdata()
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param first pointer to the first AlleleMatrix of the chain to fill. The chain
+ * holds one genotype for each cell of the row.
+ * @param marker index of the marker in `d->markers` this row describes.
+ * @param pos pointer to the first cell after the marker name in the row.
+ * @param line_end pointer to the end of the row.
+ * @param r pointer to the RandomStream used to choose the phase of heterozygotes.
+ * @returns TRUE if the row was loaded, FALSE if the marker had too many 
+ * alleles to be stored packed.
+ */
+static int load_transposed_encoded_row(SimData* d, AlleleMatrix* first, int marker, const char* pos, const char* line_end, RandomStream* r) {
+	char c, decoded[2];
+	int length, first_copy;
+	for (AlleleMatrix* current_am = first; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am) {
+			const char* cell = next_cell(&pos, line_end, &length);
+			c = length > 0 ? cell[0] : '\0';
+			
+			// if it's a homozygous code, just copy directly over.
+			if (c == 'A' || c == 'C' || c == 'G' || c == 'T') {
+				if (!load_allele(d, current_am->alleles[i_am], marker, 0, c) ||
+						!load_allele(d, current_am->alleles[i_am], marker, 1, c)) {
+					return FALSE;
+				}
+				continue;
+			} 
+			
+			// choose a random order for the two alleles.
+			first_copy = (get_random_unif(r) > 0.5); 
+			// identify the two alleles
+			switch (c) {
+				case 'R':
+					decoded[0] = 'A'; decoded[1] = 'G'; break;
+				case 'Y':
+					decoded[0] = 'C'; decoded[1] = 'T'; break;
+				case 'S':
+					decoded[0] = 'C'; decoded[1] = 'G'; break;
+				case 'W':
+					decoded[0] = 'A'; decoded[1] = 'T'; break;
+				case 'K':
+					decoded[0] = 'G'; decoded[1] = 'T'; break;
+				case 'M':
+					decoded[0] = 'A'; decoded[1] = 'C'; break;
+				default:
+					decoded[0] = 0; decoded[1] = 0; break;
+			}
+			
+			if (!load_allele(d, current_am->alleles[i_am], marker, 0, decoded[first_copy]) ||
+					!load_allele(d, current_am->alleles[i_am], marker, 1, decoded[1-first_copy])) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/** Parse the marker rows of a transposed genotype table, saving the alleles to 
+ * a chain of AlleleMatrix blocks.
+ *
+ * Rows are independent, so they are parsed in parallel using up to 
+ * `d->n_threads` threads. Rows are handed out in tasks of a multiple of four,
+ * so that when alleles are packed, no two threads write to the same byte. 
+ * Interrupts are polled between batches of rows. 
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param first pointer to the first AlleleMatrix of the chain to fill. The chain
+ * holds one genotype for each cell of a row.
+ * @param lines the lines of the table. The first is the header, and each 
+ * following line is a marker name followed by one cell per genotype.
+ * @param row_markers if NULL, line j+1 describes marker j, and its name is 
+ * saved to `d->markers[j]`. Otherwise, line j+1 describes marker `row_markers[j]`,
+ * or is skipped if that is negative. When alleles are packed, the caller must 
+ * make sure rows in the same task do not share bytes with rows in other tasks.
+ * @param encoded FALSE if the cells are allele pairs (eg TA), TRUE if they 
+ * are IUPAC codes. @see load_transposed_encoded_genes_to_simdata()
+ * @param n_threads the greatest number of threads to use.
+ * @returns the number of cells that were not allele pairs. Always 0 if `encoded`.
+ */
+static int load_transposed_rows(SimData* d, AlleleMatrix* first, const TextLines* lines, 
+		const int* row_markers, int encoded, int n_threads) {
+	const int rows_per_batch = 1024;
+	const int rows_per_task = 16;
+	int n_rows = lines->n_lines - 1;
+	int bad_cells = 0;
+	int failed_marker = -1;
+#ifdef _OPENMP
+	int n_workers = (n_threads > 1) ? n_threads : 1;
+#else
+	(void) n_threads;
+#endif
+	
+	// each row of an encoded file gets its own stream, so the phases chosen
+	// do not depend on the number of threads.
+	uint64_t seed = 0;
+	if (encoded) {
+		GetRNGstate();
+		seed = get_seed_from_R();
+		PutRNGstate();
+	}
+	
+	for (int batch_start = 0; batch_start < n_rows; batch_start += rows_per_batch) {
+		R_CheckUserInterrupt();
+		int batch_end = batch_start + rows_per_batch < n_rows ? batch_start + rows_per_batch : n_rows;
+		int n_tasks = (batch_end - batch_start + rows_per_task - 1) / rows_per_task;
+		
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(n_workers) schedule(dynamic, 1) reduction(+:bad_cells) if(n_workers > 1)
+#endif
+		for (int task = 0; task < n_tasks; ++task) {
+			int task_start = batch_start + task * rows_per_task;
+			int task_end = task_start + rows_per_task < batch_end ? task_start + rows_per_task : batch_end;
+			for (int j = task_start; j < task_end; ++j) {
+				const char* pos = lines->starts[j + 1];
+				const char* line_end = lines->ends[j + 1];
+				int length, marker = j, loaded;
+				
+				// get the row name, and store it if this is a new set of markers
+				const char* cell = next_cell(&pos, line_end, &length);
+				if (row_markers == NULL) {
+					d->markers[j] = copy_cell(cell, length);
+				} else if ((marker = row_markers[j]) < 0) {
+					continue;
+				}
+				
+				if (encoded) {
+					RandomStream r = create_random_stream(seed, j);
+					loaded = load_transposed_encoded_row(d, first, marker, pos, line_end, &r);
+				} else {
+					loaded = load_transposed_row(d, first, marker, pos, line_end, &bad_cells);
+				}
+				if (!loaded) {
+#ifdef _OPENMP
+					#pragma omp atomic write
+#endif
+					failed_marker = marker;
+				}
+			}
+		}
+		
+		if (failed_marker >= 0) {
+			error("Marker %s has more than three alleles, so its genotypes cannot be stored packed.\n", 
+					d->markers[failed_marker]);
+		}
+	}
+	return bad_cells;
+}
+
 /*-------------------------------SimData loaders-----------------------------*/
 
 /** Populates a SimData combination with marker allele data.
@@ -17,7 +425,7 @@
  * ...
  *
  * Where [line] is a code for a line, [marker] is a code for a marker, and 
- * [SNP pair] is eg TT, TA. 
+ * [SNP pair] is eg TT, TA. The file may be gzip-compressed.
  *
  * Note: this function should be called first when populating a SimData object -
  * it clears everything in the SimData. This is because all the data in SimData
@@ -30,117 +438,36 @@
  * the same group.
 */
 int load_transposed_genes_to_simdata(SimData* d, const char* filename) {	
-	struct TableSize t = get_file_dimensions(filename, '\t');
-  char cell[4] = "\t%s";
-  if (t.num_columns == 1) {
-    t = get_file_dimensions(filename, ' ');
-    cell[0] = ' ';
-  }
-  if (t.num_columns == 1) {
-    warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
-  }
-  
-	FILE* fp;
-	const int gp = 1;
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
+	MappedFile f = open_mapped_file(filename);
+	TextLines lines = find_text_lines(&f);
+	if (lines.n_lines < 1) {
+		error( "No genotypes were found in file %s.\n", filename);
 	}
-	// we have successfully opened the file.
 	
-	// discard the column title that is not a line
-	char word[30];
-
-	fscanf(fp, "%s", word);
-	
-	// now we want to read the header columns. 
-	// There are num_columns-1 of these because of the 'name' entry	
-	// this will also create our unique ids
-	AlleleMatrix* current_am;
-	int n_to_go = t.num_columns - 1;
-	if (n_to_go < 1000) {
-		current_am = create_empty_allelematrix(t.num_rows - 1, n_to_go);
-		d->m = current_am;
-		n_to_go = 0;
-	} else {
-		current_am = create_empty_allelematrix(t.num_rows - 1, 1000);
-		d->m = current_am;
-		n_to_go -= 1000;
-		while (n_to_go) {
-			if (n_to_go < 1000) {
-				current_am->next = create_empty_allelematrix(t.num_rows - 1, n_to_go);
-				n_to_go = 0;
-			} else {
-				current_am->next = create_empty_allelematrix(t.num_rows - 1, 1000);
-				current_am = current_am->next;
-				n_to_go -= 1000;
-			}
-		}
-		current_am = d->m;
-	}
-	
-	// load in the subject names from the header
-	for (int i = 0, i_am = 0; i < (t.num_columns-1); ++i, ++i_am) {
-		R_CheckUserInterrupt();
-		fscanf(fp, cell, word);
-		
-		if (i_am >= current_am->n_subjects) {
-			i_am = 0;
-			current_am = current_am->next;
-		}
-		
-		current_am->subject_names[i_am] = get_malloc(sizeof(char) * strlen(word) + 1);
-		strcpy(current_am->subject_names[i_am], word);
-		
+	const int gp = 1;
+	int n_genotypes = count_cells(lines.starts[0], lines.ends[0]) - 1;
+	if (n_genotypes < 1) {
+		warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
 	}
 	
-	// get the rest of the line, to be clean
-	fscanf(fp, "%*[^\n]\n");
-	
-	// set the ids for the subjects we loaded
-	set_subject_ids(d, 0, t.num_columns - 2);
+	// create the blocks that will hold the genotypes, and name them from the header.
+	// this will also create our unique ids
+	d->n_markers = lines.n_lines - 1;
+	create_allele_dictionary(d);
+	d->m = create_allelematrix_chain(d, n_genotypes);
+	load_transposed_header(d->m, lines.starts[0], lines.ends[0], gp);
+	set_subject_ids(d, 0, n_genotypes - 1);
 	
 	// get space to put marker names and data we gathered
-	d->n_markers = t.num_rows - 1;
-	d->markers = get_malloc(sizeof(char*) * (t.num_rows-1));
-	//memset(d->markers, '\0', sizeof(char*) * (t.num_rows-1));
+	d->markers = get_malloc(sizeof(char*) * d->n_markers);
+	delete_string_index(&(d->marker_index));
 
 	// now read the rest of the table.
-	char word2[30];
-	int badRows = 0;
-	for (int j = 0; j < (t.num_rows - 1); ++j) {
-		R_CheckUserInterrupt();
-		// looping through rows in the table.
-		
-		// get the row name, store in markers
-		fscanf(fp, "%s", word);
-		d->markers[j] = get_malloc(sizeof(char) * strlen(word) + 1);
-		strncpy(d->markers[j], word, strlen(word) + 1);
-		
-		current_am = d->m;
-		//d->m->alleles[j] = get_malloc(sizeof(char) * d->m[0].n_subjects * 2);
-		for (int i = 0, i_am = 0; i < (t.num_columns - 1); ++i, ++i_am) {
-			// looping through the remaining columns in this row.
-			fscanf(fp, cell, word2);
-			
-			// save the two alleles.
-			if (strlen(word2) != 2) {
-				++badRows;
-				//warning("This file is invalid, but nothing will be done about it.\n");
-			}
-			
-			if (i_am >= current_am->n_subjects) {
-				i_am = 0;
-				current_am = current_am->next;
-			}
-			
-			current_am->alleles[i_am][2*j] = word2[0];
-			current_am->alleles[i_am][2*j + 1] = word2[1];
-			current_am->groups[i_am] = gp;
-		}
-	}	
+	int badRows = load_transposed_rows(d, d->m, &lines, NULL, FALSE, d->n_threads);
 	
-	fclose(fp);
-	Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles could not be loaded\n", (t.num_columns - 1), (t.num_rows - 1), badRows);
+	delete_text_lines(&lines);
+	close_mapped_file(&f);
+	Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles could not be loaded\n", n_genotypes, d->n_markers, badRows);
 	return gp;
 }
 
@@ -161,7 +488,7 @@ int load_transposed_genes_to_simdata(SimData* d, const char* filename) {
  * Where [line] is a code for a line, [marker] is a code for a marker, and 
  * [encoded] is the standard IUPAC encoding for a particular pair. Because this simulation
  * tracks phase, and this encoding does not, the phase at heterozygous markers is 
- * chosen randomly.
+ * chosen randomly. The file may be gzip-compressed.
  *
  * Code => Alleles key: 
  * A => AA    ; C => CC    ; G => GG    ; T => TT   ;
@@ -181,142 +508,36 @@ int load_transposed_genes_to_simdata(SimData* d, const char* filename) {
  * the same group.
 */
 int load_transposed_encoded_genes_to_simdata(SimData* d, const char* filename) {
+	MappedFile f = open_mapped_file(filename);
+	TextLines lines = find_text_lines(&f);
+	if (lines.n_lines < 1) {
+		error( "No genotypes were found in file %s.\n", filename);
+	}
 	
-	struct TableSize t = get_file_dimensions(filename, '\t');
-  char cell[4] = "\t%s";
-  if (t.num_columns == 1) {
-    t = get_file_dimensions(filename, ' ');
-    cell[0] = ' ';
-  }
-  if (t.num_columns == 1) {
-    warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
-  }
-  
-	FILE* fp;
 	const int gp = 1;
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
+	int n_genotypes = count_cells(lines.starts[0], lines.ends[0]) - 1;
+	if (n_genotypes < 1) {
+		warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
 	}
-	// we have successfully opened the file.
-	
-	// discard the column title that is not a line
-	char word[30];
-
-	fscanf(fp, "%s", word);
 	
-	// now we want to read the header columns. 
-	// There are num_columns-1 of these because of the 'name' entry	
+	// create the blocks that will hold the genotypes, and name them from the header.
 	// this will also create our unique ids
-	AlleleMatrix* current_am;
-	int n_to_go = t.num_columns - 1;
-	if (n_to_go < 1000) {
-		current_am = create_empty_allelematrix(t.num_rows - 1, n_to_go);
-		d->m = current_am;
-		n_to_go = 0;
-	} else {
-		current_am = create_empty_allelematrix(t.num_rows - 1, 1000);
-		d->m = current_am;
-		n_to_go -= 1000;
-		while (n_to_go) {
-			if (n_to_go < 1000) {
-				current_am->next = create_empty_allelematrix(t.num_rows - 1, n_to_go);
-				n_to_go = 0;
-			} else {
-				current_am->next = create_empty_allelematrix(t.num_rows - 1, 1000);
-				current_am = current_am->next;
-				n_to_go -= 1000;
-			}
-		}
-		current_am = d->m;
-	}
-	
-	
-	// load in the subject names from the header
-	for (int i = 0, i_am = 0; i < (t.num_columns-1); ++i, ++i_am) {
-		R_CheckUserInterrupt();
-		fscanf(fp, cell, word);
-		
-		if (i_am >= current_am->n_subjects) {
-			i_am = 0;
-			current_am = current_am->next;
-		}
-		
-		current_am->subject_names[i_am] = get_malloc(sizeof(char) * strlen(word) + 1);
-		strcpy(current_am->subject_names[i_am], word);
-	}
-	
-	// get the rest of the line, to be clean
-	fscanf(fp, "%*[^\n]\n");
-	
-	// set the ids for the subjects we loaded
-	set_subject_ids(d, 0, t.num_columns - 2);
+	d->n_markers = lines.n_lines - 1;
+	create_allele_dictionary(d);
+	d->m = create_allelematrix_chain(d, n_genotypes);
+	load_transposed_header(d->m, lines.starts[0], lines.ends[0], gp);
+	set_subject_ids(d, 0, n_genotypes - 1);
 	
 	// get space to put marker names and data we gathered
-	d->n_markers = t.num_rows - 1;
-	d->markers = get_malloc(sizeof(char*) * (t.num_rows-1));
-	//memset(d->markers, '\0', sizeof(char*) * (t.num_rows-1));
+	d->markers = get_malloc(sizeof(char*) * d->n_markers);
+	delete_string_index(&(d->marker_index));
 
 	// now read the rest of the table.
-	GetRNGstate();
-	char c, decoded[2];
-	int r;
-	cell[2] = 'c';
-	for (int j = 0; j < (t.num_rows - 1); ++j) {
-		R_CheckUserInterrupt();
-		// looping through rows in the table.
-		
-		// get the row name, store in markers
-		fscanf(fp, "%s", word);
-		d->markers[j] = get_malloc(sizeof(char) * strlen(word) + 1);
-		strncpy(d->markers[j], word, strlen(word) + 1);
-		
-		current_am = d->m;
-		//d->m->alleles[j] = get_malloc(sizeof(char) * d->m[0].n_subjects * 2);
-		for (int i = 0, i_am = 0; i < (t.num_columns - 1); ++i, ++i_am) {
-			// looping through the remaining columns in this row.
-			fscanf(fp, cell, &c);
-			
-			if (i_am >= current_am->n_subjects) {
-				i_am = 0;
-				current_am = current_am->next;
-			}
-			
-			// if it's a homozygous code, just copy directly over.
-			if (c == 'A' || c == 'C' || c == 'G' || c == 'T') {
-				current_am->alleles[i_am][(j<<1)] = c;
-				current_am->alleles[i_am][(j<<1) + 1] = c;
-			} else {
-				// choose a random order for the two alleles.
-				r = (unif_rand() > 0.5); 
-				// identify the two alleles
-				switch (c) {
-					case 'R':
-						decoded[0] = 'A'; decoded[1] = 'G'; break;
-					case 'Y':
-						decoded[0] = 'C'; decoded[1] = 'T'; break;
-					case 'S':
-						decoded[0] = 'C'; decoded[1] = 'G'; break;
-					case 'W':
-						decoded[0] = 'A'; decoded[1] = 'T'; break;
-					case 'K':
-						decoded[0] = 'A'; decoded[1] = 'T'; break;
-					case 'M':
-						decoded[0] = 'A'; decoded[1] = 'T'; break;
-					default:
-						current_am->alleles[i_am][(j<<1)] = 0; current_am->alleles[i_am][(j<<1) + 1] = 0;
-						
-						continue;
-				}
-				
-				current_am->alleles[i_am][(j<<1)] = decoded[r];
-				current_am->alleles[i_am][(j<<1) + 1] = decoded[1-r];
-				current_am->groups[i_am] = gp;
-				
-			}
-		}
-	}	
-	PutRNGstate();
-	fclose(fp);
+	load_transposed_rows(d, d->m, &lines, NULL, TRUE, d->n_threads);
+	
+	delete_text_lines(&lines);
+	close_mapped_file(&f);
+	Rprintf("%d genotypes of %d markers were loaded.\n", n_genotypes, d->n_markers);
 	return gp;
 }
 
@@ -334,11 +555,11 @@ int load_transposed_encoded_genes_to_simdata(SimData* d, const char* filename) {
  * ...
  *
  * Where [line] is a code for a line, [marker] is a code for a marker, and 
- * [SNP pair] is eg TT, TA. 
+ * [SNP pair] is eg TT, TA. The file may be gzip-compressed.
  *
  * If a given marker does not exist in the SimData's set of markers, it is ignored.
  * for the purposes of loading. No markers can be added to a SimData after the creation
- * step.
+ * step. If a marker appears on more than one row, only its last row is loaded.
  *
  * An output message stating the number of genotypes and number of markers loaded 
  * is printed to stdout.
@@ -350,30 +571,17 @@ int load_transposed_encoded_genes_to_simdata(SimData* d, const char* filename) {
  * the same group.
 */
 int load_more_transposed_genes_to_simdata(SimData* d, const char* filename) {
-  struct TableSize t = get_file_dimensions(filename, '\t');
-  char cell[4] = "\t%s";
-  if (t.num_columns == 1) {
-    t = get_file_dimensions(filename, ' ');
-    cell[0] = ' ';
-  }
-  if (t.num_columns == 1) {
-    warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
-  }
-  
-	FILE* fp;
-	int gp = get_new_group_num(d);
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
+	MappedFile f = open_mapped_file(filename);
+	TextLines lines = find_text_lines(&f);
+	if (lines.n_lines < 1) {
+		error( "No genotypes were found in file %s.\n", filename);
 	}
-	// we have successfully opened the file.
-	
-	// discard the column title that is not a line
-	char word[30];
-
-	fscanf(fp, "%s", word);
 	
-	// now we want to read the header columns. 
-	// There are num_columns-1 of these because of the 'name' entry	
+	int gp = get_new_group_num(d);
+	int n_genotypes = count_cells(lines.starts[0], lines.ends[0]) - 1;
+	if (n_genotypes < 1) {
+		warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
+	}
 	
 	// find the end of the AM chain so far. This will be the last AM
 	// and the index of that AM that is just past the end of the 
@@ -385,132 +593,367 @@ int load_more_transposed_genes_to_simdata(SimData* d, const char* filename) {
 		last_n_subjects += last_am->n_subjects;
 	}	
 	
-	// Create new AMs that will be populated from the file.
-	AlleleMatrix* current_am;
-	int n_to_go = t.num_columns - 1;
-	if (n_to_go < 1000) {
-		current_am = create_empty_allelematrix(d->n_markers, n_to_go);
-		last_am->next = current_am;
-		n_to_go = 0;
-	} else {
-		current_am = create_empty_allelematrix(d->n_markers, 1000);
-		last_am->next = current_am;
-		n_to_go -= 1000;
-		while (n_to_go) {
-			if (n_to_go < 1000) {
-				current_am->next = create_empty_allelematrix(d->n_markers, n_to_go);
-				n_to_go = 0;
-			} else {
-				current_am->next = create_empty_allelematrix(d->n_markers, 1000);
-				current_am = current_am->next;
-				n_to_go -= 1000;
-			}
+	// Create new AMs that will be populated from the file, and name them from the header.
+	last_am->next = create_allelematrix_chain(d, n_genotypes);
+	load_transposed_header(last_am->next, lines.starts[0], lines.ends[0], gp);
+	
+	// set the ids for the subjects we loaded
+	set_subject_ids(d, last_n_subjects, last_n_subjects + n_genotypes - 1);
+	
+	// find which of our markers each row is for
+	int* row_markers = get_malloc(sizeof(int) * (lines.n_lines - 1));
+	int length;
+	for (int j = 0; j < lines.n_lines - 1; ++j) {
+		const char* pos = lines.starts[j + 1];
+		const char* cell = next_cell(&pos, lines.ends[j + 1], &length);
+		char* name = copy_cell(cell, length);
+		row_markers[j] = get_index_of_marker(d, name);
+		if (row_markers[j] < 0) {
+			warning( "Could not find the marker %s\n", name);
 		}
-		current_am = last_am->next;
+		free(name);
 	}
 	
-	// load in the subject names from the header
-	for (int i = 0, i_am = 0; i < (t.num_columns-1); ++i, ++i_am) {
-		R_CheckUserInterrupt();
-		fscanf(fp, cell, word);
-		
-		if (i_am >= current_am->n_subjects) {
-			i_am = 0;
-			current_am = current_am->next;
+	// rows for the same marker would be written by different threads, so skip 
+	// all but the last, which is the one that would win if the rows were read in order.
+	int* last_row = get_malloc(sizeof(int) * d->n_markers);
+	for (int k = 0; k < d->n_markers; ++k) {
+		last_row[k] = -1;
+	}
+	for (int j = 0; j < lines.n_lines - 1; ++j) {
+		if (row_markers[j] >= 0) {
+			last_row[row_markers[j]] = j;
 		}
-		
-		current_am->subject_names[i_am] = get_malloc(sizeof(char) * strlen(word) + 1);
-		strcpy(current_am->subject_names[i_am], word);
+	}
+	int repeatedRows = 0;
+	for (int j = 0; j < lines.n_lines - 1; ++j) {
+		if (row_markers[j] >= 0 && last_row[row_markers[j]] != j) {
+			row_markers[j] = -1;
+			++repeatedRows;
+		}
+	}
+	free(last_row);
+	if (repeatedRows > 0) {
+		warning("%d rows repeat a marker that appears again later in file %s, and were skipped.\n", 
+				repeatedRows, filename);
 	}
 	
-	// get the rest of the line, to be clean
-	fscanf(fp, "%*[^\n]\n");
-	
+	// now read the rest of the table. The rows may be in any order, so when alleles
+	// are packed, rows handled by different threads could share bytes.
+	int badRows = load_transposed_rows(d, last_am->next, &lines, row_markers, FALSE, 
+			d->packed_alleles ? 1 : d->n_threads);
+	free(row_markers);
+	if (badRows > 0) {
+		warning("%d pairs of alleles could not be loaded.\n", badRows);
+	}
+	Rprintf("%d genotypes were loaded.\n", n_genotypes);
 	
-	// set the ids for the subjects we loaded
-	set_subject_ids(d, last_n_subjects, last_n_subjects + t.num_columns - 2);
+	delete_text_lines(&lines);
+	close_mapped_file(&f);
+	condense_allele_matrix(d);
+	return gp;
+}
+
+/** Get the next empty slot at the end of a chain of AlleleMatrix blocks for a
+ * genotype being loaded, growing the last block or adding a new one to the
+ * chain as needed.
+ *
+ * @param d pointer to the SimData the blocks belong to.
+ * @param last pointer to the last AlleleMatrix of the chain. It is updated if
+ * a block is added.
+ * @returns the index of the slot in `*last`. Its genotype space is zeroed and
+ * `.alleles` points to it, and `n_subjects` of the block has been increased.
+ */
+static int add_loaded_genotype(SimData* d, AlleleMatrix** last) {
+	AlleleMatrix* am = *last;
+	if (am->n_subjects >= d->block_capacity) {
+		am->next = create_empty_allelematrix(d, 0);
+		am = am->next;
+		*last = am;
+	}
+	if (am->n_subjects >= am->capacity) {
+		int new_capacity = am->capacity > 0 ? 2 * am->capacity : 64;
+		if (new_capacity > d->block_capacity) { new_capacity = d->block_capacity; }
+		reserve_allelematrix_capacity(d, am, new_capacity);
+	}
+	int slot = am->n_subjects;
+	++ am->n_subjects;
+	am->alleles[slot] = am->allele_slab + get_genotype_length(d) * slot;
+	return slot;
+}
+
+/** Parse the genotype rows of an individual-major genotype table, appending 
+ * one genotype per row to the end of a chain of AlleleMatrix blocks. Each 
+ * row is written into its genotype's storage from start to end.
+ * @see load_genes_to_simdata()
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param s pointer to the LineStream of the table, positioned after its header.
+ * @param first pointer to the empty AlleleMatrix to start filling. More blocks 
+ * are added after it as needed.
+ * @param n_columns the number of allele pair columns in the header.
+ * @param column_markers if NULL, column j is marker j. Otherwise, column j is 
+ * marker `column_markers[j]`, or is skipped if that is negative.
+ * @param group the group number to give the genotypes.
+ * @param n_genotypes location to save the number of genotypes loaded.
+ * @returns the number of cells that were not allele pairs.
+ */
+static int load_genotype_rows(SimData* d, LineStream* s, AlleleMatrix* first, int n_columns, 
+		const int* column_markers, int group, int* n_genotypes) {
+	AlleleMatrix* last = first;
+	const char* line;
+	const char* line_end;
+	int length, bad_cells = 0;
+	*n_genotypes = 0;
 	
-	// get space to put marker names and data we gathered
-	// now read the rest of the table.
-	char word2[30];
-	int markeri;
-	current_am = last_am->next;
-	for (int j = 0; j < (t.num_rows - 1); ++j) {
-		R_CheckUserInterrupt();
-		// looping through rows in the table.
-		
-		// get the row name, store in markers
-		fscanf(fp, "%s", word);
-		markeri = get_from_unordered_str_list(word, d->markers, d->n_markers);
+	while (next_line(s, &line, &line_end)) {
+		if ((*n_genotypes & 1023) == 0) {
+			R_CheckUserInterrupt();
+		}
+		const char* pos = line;
+		const char* cell = next_cell(&pos, line_end, &length);
+		if (length == 0) {
+			continue; // a blank line
+		}
 		
-		current_am = last_am;
+		int slot = add_loaded_genotype(d, &last);
+		last->subject_names[slot] = copy_cell(cell, length);
+		last->groups[slot] = group;
+		char* genes = last->alleles[slot];
+		++ *n_genotypes;
 		
-		if (markeri >= 0) {
-			for (int i = 0, i_am = last_n_subjects; i < (t.num_columns - 1); ++i, ++i_am) {
-				// looping through the remaining columns in this row.
-				fscanf(fp, cell, word2);
-				
-				// save the two alleles.
-				if (strlen(word2) != 2) {
-					warning("This file is invalid, but nothing will be done about it.\n");
-				}
-				
-				if (i_am >= current_am->n_subjects) {
-					i_am = 0;
-					current_am = current_am->next;
-				}
-				
-				//strncpy(d->m->alleles[i] + (2*j), word2, 2);
-				current_am->alleles[i_am][2*markeri] = word2[0];
-				current_am->alleles[i_am][2*markeri + 1] = word2[1];
-				current_am->groups[i_am] = gp;
+		for (int j = 0; j < n_columns; ++j) {
+			cell = next_cell(&pos, line_end, &length);
+			if (length != 2) {
+				++bad_cells;
+			}
+			int marker = column_markers == NULL ? j : column_markers[j];
+			if (marker < 0) {
+				continue;
+			}
+			if (!load_allele(d, genes, marker, 0, length > 0 ? cell[0] : '\0') ||
+					!load_allele(d, genes, marker, 1, length > 1 ? cell[1] : '\0')) {
+				error("Marker %s has more than three alleles, so its genotypes cannot be stored packed.\n", 
+						d->markers[marker]);
 			}
-		} else {
-			warning( "Could not find the marker %s\n", word);
 		}
-	}	
-	Rprintf("%d genotypes were loaded.\n", t.num_columns - 1);
-	fclose(fp);
-	
-	condense_allele_matrix(d);
-	return gp;
+	}
+	return bad_cells;
 }
 
-/** Populates a SimData combination with data from a genetic map. Map positions must be in cM.
- *
- * Note: this function should be called second when populating a SimData object,
- * after populating it with marker allele data. This is because this function 
- * loads the genmap data corresponding to markers used in the allele file, then 
- * deletes markers in SimData that do not have positions for ease of simulation.
+/** Populates a SimData combination with marker allele data from an 
+ * individual-major genotype table.
+ * @see load_transposed_genes_to_simdata() for the marker-major layout.
+ * Assumes it is starting from a clean/empty SimData.
  *
- * The file's format should be:
+ * Given a file with the following format:
  *
- * marker	chr	pos
+ * name [marker] [marker] [marker] ... [marker]
  *
- * [marker name] 	[chr]	[pos]
+ * [line] [SNP pair] [SNP pair] [SNP pair] ... [SNP pair]
  *
- * [marker name] 	[chr]	[pos]
+ * [line] [SNP pair] [SNP pair] [SNP pair] ... [SNP pair]
  *
  * ...
  *
- * The function assumes the maximum line length is 99 characters. 
- * It also assumes that there is only one mapping per marker in the file.
+ * Where [line] is a code for a line, [marker] is a code for a marker, and 
+ * [SNP pair] is eg TT, TA. The file may be gzip-compressed.
  *
- * @param d pointer to SimData to be populated
- * @param filename string name/path of file containing genetic map data.
-*/
-void load_genmap_to_simdata(SimData* d, const char* filename) {
-	// open our file.
-	FILE* fp;
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
-	}
+ * The file is streamed one row at a time, and each row is written straight 
+ * into its genotype's storage, so no more than a row of the file is held in
+ * memory and the genotypes are filled with sequential writes.
+ *
+ * Note: this function should be called first when populating a SimData object -
+ * it clears everything in the SimData. This is because all the data in SimData
+ * is based on what markers exist in the loaded marker allele file.
+ *
+ * An output message stating the number of genotypes and number of markers loaded 
+ * is printed to stdout.
+ *
+ * @param d pointer to SimData to be populated
+ * @param filename string containing name/path of file containing SNP marker 
+ * allele data.
+ * @returns the group number of the loaded genotypes. All genotypes are loaded into
+ * the same group.
+*/
+int load_genes_to_simdata(SimData* d, const char* filename) {
+	LineStream s = open_line_stream(filename);
+	const char* line;
+	const char* line_end;
+	int length, n_genotypes;
+	
+	// the header names the markers
+	do {
+		if (!next_line(&s, &line, &line_end)) {
+			close_line_stream(&s);
+			error( "No genotypes were found in file %s.\n", filename);
+		}
+	} while (count_cells(line, line_end) == 0);
+	
+	const int gp = 1;
+	d->n_markers = count_cells(line, line_end) - 1;
+	if (d->n_markers < 1) {
+		warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
+	}
+	d->markers = get_malloc(sizeof(char*) * d->n_markers);
+	const char* pos = line;
+	next_cell(&pos, line_end, &length); // discard the column title that is not a marker
+	for (int j = 0; j < d->n_markers; ++j) {
+		const char* cell = next_cell(&pos, line_end, &length);
+		d->markers[j] = copy_cell(cell, length);
+	}
+	delete_string_index(&(d->marker_index));
+	create_allele_dictionary(d);
+	
+	// now read the genotypes, one per row
+	d->m = create_empty_allelematrix(d, 0);
+	int badRows = load_genotype_rows(d, &s, d->m, d->n_markers, NULL, gp, &n_genotypes);
+	close_line_stream(&s);
+	if (n_genotypes < 1) {
+		error( "No genotypes were found in file %s.\n", filename);
+	}
+	
+	// this will also create our unique ids
+	set_subject_ids(d, 0, n_genotypes - 1);
+	Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles could not be loaded\n", n_genotypes, d->n_markers, badRows);
+	return gp;
+}
 
-	// ignore the first line of the file
-	fscanf(fp, "%*[^\n]\n");
+/** Appends genotype data from an individual-major genotype table to an 
+ * existing SimData. @see load_genes_to_simdata()
+ *
+ * If a given marker does not exist in the SimData's set of markers, it is ignored.
+ * for the purposes of loading. No markers can be added to a SimData after the creation
+ * step.
+ *
+ * An output message stating the number of genotypes loaded is printed to stdout.
+ *
+ * @param d pointer to SimData to be populated
+ * @param filename string containing name/path of file containing SNP marker 
+ * allele data.
+ * @returns the group number of the loaded genotypes. All genotypes are loaded into
+ * the same group.
+*/
+int load_more_genes_to_simdata(SimData* d, const char* filename) {
+	LineStream s = open_line_stream(filename);
+	const char* line;
+	const char* line_end;
+	int length, n_genotypes;
+	
+	// the header names the markers. Find which of ours each column is for
+	do {
+		if (!next_line(&s, &line, &line_end)) {
+			close_line_stream(&s);
+			error( "No genotypes were found in file %s.\n", filename);
+		}
+	} while (count_cells(line, line_end) == 0);
+	
+	int gp = get_new_group_num(d);
+	int n_columns = count_cells(line, line_end) - 1;
+	if (n_columns < 1) {
+		warning("Only found one column in file %s. File may be using an unsupported separator.\n", filename);
+	}
+	int* column_markers = get_malloc(sizeof(int) * (n_columns > 0 ? n_columns : 1));
+	const char* pos = line;
+	next_cell(&pos, line_end, &length);
+	for (int j = 0; j < n_columns; ++j) {
+		const char* cell = next_cell(&pos, line_end, &length);
+		char* name = copy_cell(cell, length);
+		column_markers[j] = get_index_of_marker(d, name);
+		if (column_markers[j] < 0) {
+			warning( "Could not find the marker %s\n", name);
+		}
+		free(name);
+	}
+	
+	// find the end of the AM chain so far, and the number of genotypes in it
+	AlleleMatrix* last_am = d->m; 
+	int last_n_subjects = last_am->n_subjects;
+	while (last_am->next != NULL) {
+		last_am = last_am->next;
+		last_n_subjects += last_am->n_subjects;
+	}
+	
+	// now read the genotypes into new AMs after it
+	last_am->next = create_empty_allelematrix(d, 0);
+	int badRows = load_genotype_rows(d, &s, last_am->next, n_columns, column_markers, gp, &n_genotypes);
+	close_line_stream(&s);
+	free(column_markers);
+	if (n_genotypes < 1) {
+		delete_allele_matrix(last_am->next);
+		last_am->next = NULL;
+		warning("No genotypes were found in file %s.\n", filename);
+		return gp;
+	}
+	
+	set_subject_ids(d, last_n_subjects, last_n_subjects + n_genotypes - 1);
+	if (badRows > 0) {
+		warning("%d pairs of alleles could not be loaded.\n", badRows);
+	}
+	Rprintf("%d genotypes were loaded.\n", n_genotypes);
+	
+	condense_allele_matrix(d);
+	return gp;
+}
+
+/** Report how many markers were given positions by a map loader, and delete
+ * the markers that were not, so that the rest of SimData can assume every 
+ * marker is mapped.
+ *
+ * @param d pointer to the SimData whose map has just been loaded.
+ */
+static void drop_unmapped_markers(SimData* d) {
+	// count number of markers that don't have positions loaded.
+	int n_nopos = 0;
+	for (int i = 0; i < d->n_markers; i++) {
+		if (d->map.positions[i].chromosome == 0) {
+			n_nopos += 1;
+		}
+	}
+	
+	Rprintf("%d markers with map positions. %d markers remain unmapped.\n", 
+	d->n_markers - n_nopos, n_nopos);
+	
+	//Order the markers and positions, eliminating markers with no positions
+	if (n_nopos > 0) {
+		get_sorted_markers(d, d->n_markers - n_nopos);
+		get_chromosome_locations(d);
+	}
+}
+
+/** Populates a SimData combination with data from a genetic map. Map positions must be in cM.
+ *
+ * Note: this function should be called second when populating a SimData object,
+ * after populating it with marker allele data. This is because this function 
+ * loads the genmap data corresponding to markers used in the allele file, then 
+ * deletes markers in SimData that do not have positions for ease of simulation.
+ *
+ * The file's format should be:
+ *
+ * marker	chr	pos
+ *
+ * [marker name] 	[chr]	[pos]
+ *
+ * [marker name] 	[chr]	[pos]
+ *
+ * ...
+ *
+ * The function assumes the maximum line length is 99 characters. 
+ * It also assumes that there is only one mapping per marker in the file.
+ * The file may be gzip-compressed.
+ *
+ * @param d pointer to SimData to be populated
+ * @param filename string name/path of file containing genetic map data.
+*/
+void load_genmap_to_simdata(SimData* d, const char* filename) {
+	// open our file.
+	gzFile fp = open_input_file(filename);
 	
 	int bufferlen = 100; // assume no line is over 100 characters long
 	char buffer[bufferlen];
+	
+	// ignore the first line of the file
+	while (gzgets(fp, buffer, bufferlen) != NULL && strchr(buffer, '\n') == NULL);
 	char marker_name[bufferlen]; // for scanning name from line
 	int chr; // for scanning chromosome from line
 	float pos; // for scanning postion value from line
@@ -524,35 +967,95 @@ void load_genmap_to_simdata(SimData* d, const char* filename) {
 	d->map.positions = calloc(sizeof(MarkerPosition) * d->n_markers, sizeof(MarkerPosition));
 	
 	// loop through rows of the file (until we've got all our positions)
-	while (fgets(buffer, bufferlen, fp) != NULL && (positions_loaded < d->n_markers)) {
+	while (gzgets(fp, buffer, bufferlen) != NULL && (positions_loaded < d->n_markers)) {
 		R_CheckUserInterrupt();
 		sscanf(buffer, "%s %d %f\n", marker_name, &chr, &pos);
 		
-		if ((location = get_from_unordered_str_list( marker_name, d->markers, d->n_markers)) >= 0) {
+		if ((location = get_index_of_marker(d, marker_name)) >= 0) {
 			// the marker is in our list, so save its position
 			d->map.positions[location].chromosome = chr;
 			d->map.positions[location].position = pos;
 		}
 	}
 	
-	// count number of markers that don't have positions loaded.
-	int n_nopos = 0;
-	for (int i = 0; i < d->n_markers; i++) {
-		if (d->map.positions[i].chromosome == 0) {
-			n_nopos += 1;
-		}
+	gzclose(fp);
+	
+	drop_unmapped_markers(d);
+}
+
+/** Populates a SimData combination with a genetic map held in memory, as 
+ * parallel arrays of marker names, chromosomes and positions. Map positions 
+ * must be in cM. @see load_genmap_to_simdata() 
+ *
+ * As for load_genmap_to_simdata(), rows for markers the SimData does not have 
+ * are ignored, and markers without a position are then deleted.
+ *
+ * @param d pointer to SimData to be populated
+ * @param n_rows the length of the three arrays.
+ * @param marker_names the name of the marker each row gives a position for.
+ * @param chromosomes the chromosome of each row's marker.
+ * @param positions the position in cM of each row's marker.
+*/
+void load_genmap_from_arrays(SimData* d, int n_rows, const char** marker_names, 
+		const int* chromosomes, const double* positions) {
+	int location;
+	
+	if (d->map.positions != NULL) {
+		delete_genmap(&(d->map));
 	}
 	
-	Rprintf("%d markers with map positions. %d markers remain unmapped.\n", 
-	d->n_markers - n_nopos, n_nopos);
+	d->map.positions = calloc(sizeof(MarkerPosition) * d->n_markers, sizeof(MarkerPosition));
 	
-	fclose(fp);
+	for (int i = 0; i < n_rows; ++i) {
+		if ((i & 1023) == 0) {
+			R_CheckUserInterrupt();
+		}
+		if ((location = get_index_of_marker(d, marker_names[i])) >= 0) {
+			d->map.positions[location].chromosome = chromosomes[i];
+			d->map.positions[location].position = positions[i];
+		}
+	}
 	
-	//Order the markers and positions, eliminating markers with no positions
-	if (n_nopos > 0) {
-		get_sorted_markers(d, d->n_markers - n_nopos);
-		get_chromosome_locations(d);
+	drop_unmapped_markers(d);
+}
+
+/** Reorder the genotypes of one AlleleMatrix to a new marker order, in place.
+ * Each genotype is copied to a scratch buffer and written back in the new 
+ * order. Genotypes stay in slab order, so if markers were dropped the 
+ * genotypes are also shifted down to their new, shorter, slots.
+ * @see get_sorted_markers()
+ *
+ * @param old_d copy of the SimData settings the genotypes are currently stored with.
+ * @param d pointer to the SimData with the new marker count.
+ * @param am pointer to the AlleleMatrix to reorder. If its slab is borrowed, 
+ * the reordered genotypes are written to `new_slab` instead.
+ * @param order `order[j]` is the index in the old marker order of new marker j.
+ * @param scratch space for one genotype of `old_d`.
+ * @param new_slab zeroed space for the block's capacity of genotypes of `d`, 
+ * or NULL to reorder within the block's current slab.
+ */
+static void reorder_genotype_block(const SimData* old_d, const SimData* d, AlleleMatrix* am, 
+		const int* order, char* scratch, char* new_slab) {
+	size_t old_glen = get_genotype_length(old_d);
+	size_t glen = get_genotype_length(d);
+	char* slab = new_slab != NULL ? new_slab : am->allele_slab;
+	
+	for (int i = 0; i < am->n_subjects; ++i) {
+		memcpy(scratch, am->alleles[i], sizeof(char) * old_glen);
+		char* genes = slab + glen * i;
+		memset(genes, 0, sizeof(char) * glen);
+		for (int j = 0; j < d->n_markers; ++j) {
+			set_stored_allele(d, genes, j, 0, get_stored_allele(old_d, scratch, order[j], 0));
+			set_stored_allele(d, genes, j, 1, get_stored_allele(old_d, scratch, order[j], 1));
+		}
+		am->alleles[i] = genes;
 	}
+	// the slots past the last genotype are expected to be empty
+	if (new_slab == NULL && glen < old_glen && am->capacity > am->n_subjects) {
+		memset(slab + glen * am->n_subjects, 0, 
+				sizeof(char) * (old_glen * am->capacity - glen * am->n_subjects));
+	}
+	am->n_markers = d->n_markers;
 }
 
 /** Takes a SimData object, and sorts its markers, the rows of its parent gen
@@ -560,11 +1063,10 @@ void load_genmap_to_simdata(SimData* d, const char* filename) {
  * so that the markers are ordered by chromosome number then position.
  *
  * Markers that do not have a position in d->map.positions are deleted from 
- * all those three lists. This is done by malloc-ing new memory, copying
- * data over in the new sorted order, and freeing the old memory.
- *
- * Note: only the starting generation in the AlleleMatrix list is reordered, and
- * all additional AlleleMatrix objects are deleted.
+ * all those three lists. The sorted order is found once, as an array of old 
+ * marker indexes, and each genotype is then reordered within its own storage 
+ * through a scratch buffer, so no genotype storage is reallocated. Blocks of
+ * genotypes are reordered in parallel, using `d->n_threads` threads.
  *
  * @param d pointer to the SimData to have its markers, genetic map, and allele
  * matrix sorted. The SimData pointed to by d will be modified by this function.
@@ -575,11 +1077,6 @@ void load_genmap_to_simdata(SimData* d, const char* filename) {
  * `d->map.positions` that have a chromosome number of 0. 
 */
 void get_sorted_markers(SimData* d, int actual_n_markers) {
-	MarkerPosition* sortable[d->n_markers];
-	for (int i = 0; i < d->n_markers; i++) {
-		sortable[i] = &(d->map.positions[i]);
-	}
-
 	// if this was not pre-calculated do it now.
 	if (actual_n_markers < 0) {
 		actual_n_markers = d->n_markers;
@@ -589,60 +1086,111 @@ void get_sorted_markers(SimData* d, int actual_n_markers) {
 			}
 		}
 	}
-
 	
-	/* Sort the pointers */
+	/* Sort pointers to the positions, then save the order as indexes */
+	MarkerPosition** sortable = get_malloc(sizeof(MarkerPosition*) * (d->n_markers > 0 ? d->n_markers : 1));
+	for (int i = 0; i < d->n_markers; i++) {
+		sortable[i] = &(d->map.positions[i]);
+	}
 	qsort(sortable, d->n_markers, sizeof(sortable[0]), _simdata_pos_compare);
-	int location_in_old; 
+	int* order = get_malloc(sizeof(int) * (d->n_markers > 0 ? d->n_markers : 1));
+	for (int i = 0; i < d->n_markers; i++) {
+		order[i] = sortable[i] - d->map.positions;
+	}
+	free(sortable);
 
 	R_CheckUserInterrupt();
 	
 	if (d->markers != NULL) {
 		char** new_markers = get_malloc(sizeof(char*) * actual_n_markers);
 		for (int i = 0; i < actual_n_markers; ++i) {
-			location_in_old = sortable[i] - d->map.positions;		
-			new_markers[i] = d->markers[location_in_old]; // shallow copy
+			new_markers[i] = d->markers[order[i]]; // shallow copy
+		}
+		// the markers without positions are dropped
+		for (int i = actual_n_markers; i < d->n_markers; ++i) {
+			free(d->markers[order[i]]);
 		}
 		
 		free(d->markers);
 		d->markers = new_markers;
+		delete_string_index(&(d->marker_index)); // names have moved
+	}
+	
+	// genotypes are stored with the new marker count from here on, so the 
+	// old genotypes are read with a copy of the SimData settings.
+	SimData old_d = *d;
+	d->n_markers = actual_n_markers;
+	
+	if (d->allele_dictionary != NULL) {
+		char* new_dictionary = get_malloc(sizeof(char) * 3 * actual_n_markers);
+		for (int i = 0; i < actual_n_markers; ++i) {
+			memcpy(new_dictionary + 3*i, old_d.allele_dictionary + 3*order[i], sizeof(char) * 3);
+		}
+		d->allele_dictionary = new_dictionary;
 	}
 	
-	char* temp;
 	if (d->m != NULL && d->m->alleles != NULL) {
-		//temp = get_malloc(sizeof(char) * ((actual_n_markers * 2)));
-		AlleleMatrix* am = d->m;
+		int n_blocks = 0;
+		for (AlleleMatrix* am = d->m; am != NULL; am = am->next) {
+			++n_blocks;
+		}
+		AlleleMatrix** blocks = get_malloc(sizeof(AlleleMatrix*) * n_blocks);
+		char** new_slabs = get_malloc(sizeof(char*) * n_blocks);
+		size_t old_glen = get_genotype_length(&old_d);
+		size_t glen = get_genotype_length(d);
 		
-		do {
-			R_CheckUserInterrupt();
-			/*for (int i = 0; i < actual_n_markers; ++i) {
-				location_in_old = sortable[i] - d->map.positions; 
-				
-				for (int j = 0; j < am->n_subjects; ++j) {
-					strncpy(temp, am->alleles[j], am->n_subjects * sizeof(char));
-					am->alleles[j][2*i] = temp[2*location_in_old];
-					am->alleles[j][2*i + 1] = temp[2*location_in_old + 1];
-				}
-			}*/
-			
-			for (int i = 0; i < am->n_subjects; ++i) {
-				//strncpy(temp, am->alleles[i], sizeof(char) * ((am->n_markers * 2)));
-				temp = get_malloc(sizeof(char) * ((actual_n_markers * 2)));
-				
-				for (int j = 0; j < actual_n_markers; ++j) {
-					location_in_old = sortable[j] - d->map.positions; 
-					temp[2*j] = am->alleles[i][2*location_in_old];
-					temp[2*j + 1] = am->alleles[i][2*location_in_old + 1];
-					
-					//am->alleles[i][2*j] = temp[2*location_in_old];
-					//am->alleles[i][2*j + 1] = temp[2*location_in_old + 1];
+		// borrowed slabs can't be written to, so those blocks get a slab of their own.
+		int b = 0;
+		for (AlleleMatrix* am = d->m; am != NULL; am = am->next, ++b) {
+			blocks[b] = am;
+			new_slabs[b] = NULL;
+			if (am->slab_is_borrowed && am->capacity > 0) {
+				new_slabs[b] = get_malloc(sizeof(char) * glen * am->capacity);
+				memset(new_slabs[b], 0, sizeof(char) * glen * am->capacity);
+			}
+		}
+		
+		int n_workers = 1;
+#ifdef _OPENMP
+		if (d->n_threads > 1) {
+			n_workers = d->n_threads;
+		}
+#endif
+		// scratch space for one old genotype per thread
+		char* scratch = get_malloc(sizeof(char) * (old_glen > 0 ? old_glen : 1) * n_workers);
+		
+		R_CheckUserInterrupt();
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(n_workers) schedule(dynamic, 1) if(n_workers > 1)
+#endif
+		for (int k = 0; k < n_blocks; ++k) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			reorder_genotype_block(&old_d, d, blocks[k], order, scratch + (size_t) t * old_glen, new_slabs[k]);
+		}
+		
+		// swap in the new slabs, and return the space freed by dropped markers
+		for (int k = 0; k < n_blocks; ++k) {
+			AlleleMatrix* am = blocks[k];
+			if (new_slabs[k] != NULL) {
+				am->allele_slab = new_slabs[k];
+				am->slab_is_borrowed = FALSE;
+			} else if (glen < old_glen && am->capacity > 0) {
+				am->allele_slab = get_realloc(am->allele_slab, sizeof(char) * glen * am->capacity);
+				for (int i = 0; i < am->n_subjects; ++i) {
+					am->alleles[i] = am->allele_slab + glen * i;
 				}
-				free(am->alleles[i]);
-				am->alleles[i] = temp;
 			}
-			am->n_markers = actual_n_markers;
-		} while ((am = am->next) != NULL);
-		//free(temp);
+		}
+		
+		free(scratch);
+		free(new_slabs);
+		free(blocks);
+	}
+	if (old_d.allele_dictionary != d->allele_dictionary) {
+		free(old_d.allele_dictionary);
 	}
 	
 	if (d->e.effects.matrix != NULL) {
@@ -650,9 +1198,8 @@ void get_sorted_markers(SimData* d, int actual_n_markers) {
 		DecimalMatrix new_eff = generate_zero_dmatrix(d->e.effects.rows, actual_n_markers);
 		for (int i = 0; i < actual_n_markers; ++i) {
 			R_CheckUserInterrupt();
-			location_in_old = sortable[i] - d->map.positions; 
 			for (int j = 0; j < d->e.effects.rows; ++j) {
-				new_eff.matrix[j][i] = d->e.effects.matrix[j][location_in_old];
+				new_eff.matrix[j][i] = d->e.effects.matrix[j][order[i]];
 			}
 		}
 		
@@ -662,16 +1209,14 @@ void get_sorted_markers(SimData* d, int actual_n_markers) {
 	
 	MarkerPosition* new_map = get_malloc(sizeof(MarkerPosition) * actual_n_markers);
 	for (int i = 0; i < actual_n_markers; ++i) {
-		R_CheckUserInterrupt();
-		location_in_old = sortable[i] - d->map.positions; 
-		new_map[i].chromosome = d->map.positions[location_in_old].chromosome;
-		new_map[i].position = d->map.positions[location_in_old].position;
+		new_map[i].chromosome = d->map.positions[order[i]].chromosome;
+		new_map[i].position = d->map.positions[order[i]].position;
 	}
 	delete_genmap(&(d->map));
 	d->map.positions = new_map;
 		
 	d->n_markers = actual_n_markers;
-
+	free(order);
 }
 
 /** Updates the chr_ends, n_chr and chr_lengths fields in SimData.map. 
@@ -743,6 +1288,51 @@ void get_chromosome_locations(SimData *d) {
 	}
 }
 
+/** Delete the effect values of a SimData, leaving an empty effect table that
+ * add_loaded_effect() can fill.
+ *
+ * @param d pointer to the SimData whose effect values are to be deleted.
+ */
+static void clear_effects(SimData* d) {
+	if (d->e.effects.matrix != NULL) {
+		delete_dmatrix(&(d->e.effects));
+	}
+	if (d->e.effect_names != NULL) {
+		free(d->e.effect_names);
+	}
+	d->e.effects.matrix = NULL;
+	d->e.effects.rows = 0;
+	d->e.effects.cols = d->n_markers;
+	d->e.effect_names = get_malloc(sizeof(char));
+	d->e.effect_names[0] = '\0';
+}
+
+/** Save one effect value to the effect table of a SimData that is being loaded.
+ * Alleles are given rows of the table in the order they are first seen, and a 
+ * new allele's row starts as all zeros.
+ *
+ * @param d pointer to the SimData being loaded.
+ * @param marker index of the marker the effect is for.
+ * @param allele the allele the effect is for.
+ * @param effect the effect value.
+ */
+static void add_loaded_effect(SimData* d, int marker, char allele, double effect) {
+	int row;
+	char* symbol_location = strchr(d->e.effect_names, allele);
+	if (allele != '\0' && symbol_location != NULL) {
+		row = symbol_location - d->e.effect_names; // difference between the pointers
+	} else {
+		row = d->e.effects.rows;
+		++ d->e.effects.rows;
+		d->e.effect_names = get_realloc(d->e.effect_names, sizeof(char) * (row + 2));
+		d->e.effect_names[row] = allele;
+		d->e.effect_names[row + 1] = '\0';
+		d->e.effects.matrix = get_realloc(d->e.effects.matrix, sizeof(double*) * (row + 1));
+		d->e.effects.matrix[row] = calloc(d->n_markers, sizeof(double));
+	}
+	d->e.effects.matrix[row][marker] = effect;
+}
+
 /** Populates a SimData combination with effect values. The SimData must already 
  * have its allele data and map data loaded (so that it has an ordered `markers`
  * list and no markers that will not be used for simulation.
@@ -760,17 +1350,14 @@ void get_chromosome_locations(SimData *d) {
  *
  * The function assumes the maximum line length is 99 characters.
  * It also assumes that the array ref_alleles is the same
- * length as m's marker_names vector.
+ * length as m's marker_names vector. The file may be gzip-compressed.
  *
  * @param d pointer to SimData to be populated. 
  * @param filename string name/path of file containing effect values.
 */
 void load_effects_to_simdata(SimData* d, const char* filename) {
 	// open our file.
-	FILE* fp;
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
-	}
+	gzFile fp = open_input_file(filename);
 	
 	int bufferlen = 100; // assume no line is over 100 characters long
 	char buffer[bufferlen];
@@ -778,66 +1365,59 @@ void load_effects_to_simdata(SimData* d, const char* filename) {
 	char allele; // for scanning allele from line
 	double effect; // for scanning effect value from line
 	int location; // used for location of marker in m->marker_names
-	
 	int n_loaded = 0;
-	int n_allele = 0; // count the different alleles we're tracking
-	const int MAX_SYMBOLS = 25;
-	char alleles_loaded[MAX_SYMBOLS + 1];
-	memset(alleles_loaded, '\0', MAX_SYMBOLS + 1);
-	double* effects_loaded[MAX_SYMBOLS];
-	memset(effects_loaded, 0, MAX_SYMBOLS);
 	
-	if (d->e.effects.matrix != NULL) {
-		delete_dmatrix(&(d->e.effects));
-	}
-	if (d->e.effect_names != NULL) {
-		free(d->e.effect_names);
-	}
+	clear_effects(d);
 	
 	// loop through rows of the file
 	//for (int i = 0; i < (t.num_rows - 1); i++) {
-	while (fgets(buffer, bufferlen, fp) != NULL) {
+	while (gzgets(fp, buffer, bufferlen) != NULL) {
 		R_CheckUserInterrupt();
 		//fgets(buffer, bufferlen, fp);
 		sscanf(buffer, "%s %c %lf\n", marker_name, &allele, &effect);
 		
-		if ((location = get_from_unordered_str_list(  marker_name, d->markers, d->n_markers)) >= 0) {
-			int symbol_index; 
-			char* symbol_location = strchr(alleles_loaded, allele);
-			if (symbol_location == NULL) {
-				symbol_index = n_allele;
-				++n_allele;
-				alleles_loaded[symbol_index] = allele;
-			} else {
-				symbol_index = symbol_location - alleles_loaded; // difference between the pointers
-			}
-			
-			// the marker is in our list and the allele value is valid
-			if (effects_loaded[symbol_index] == NULL) {
-				effects_loaded[symbol_index] = calloc(d->n_markers, sizeof(double) * d->n_markers);
-			}
-			effects_loaded[symbol_index][location] = effect;
+		if ((location = get_index_of_marker(d, marker_name)) >= 0) {
+			add_loaded_effect(d, location, allele, effect);
 			n_loaded += 1;
 		} 
 	}
+
+	Rprintf("%d effect values spanning %d alleles loaded.\n", n_loaded, d->e.effects.rows);
 	
-	d->e.effects.matrix = get_malloc(sizeof(double*) * n_allele);
-	d->e.effects.rows = n_allele;
-	d->e.effects.cols = d->n_markers;
-	d->e.effect_names = get_malloc(sizeof(char) * (n_allele + 1));
+	gzclose(fp);
+	return;
+}
+
+/** Populates a SimData combination with effect values held in memory, as 
+ * parallel arrays of marker names, alleles and effects. @see load_effects_to_simdata()
+ *
+ * As for load_effects_to_simdata(), the SimData must already have its allele 
+ * and map data loaded, and rows for markers it does not have are ignored.
+ *
+ * @param d pointer to SimData to be populated. 
+ * @param n_rows the length of the three arrays.
+ * @param marker_names the name of the marker of each row's effect.
+ * @param alleles the allele of each row's effect.
+ * @param effects the effect value of each row.
+*/
+void load_effects_from_arrays(SimData* d, int n_rows, const char** marker_names, 
+		const char* alleles, const double* effects) {
+	int location;
+	int n_loaded = 0;
 	
-	// loop again to save values now we have enough memory.
-	for (int i = 0; i < n_allele; i++) {
-		d->e.effect_names[i] = alleles_loaded[i];
-		d->e.effects.matrix[i] = effects_loaded[i];
+	clear_effects(d);
+	
+	for (int i = 0; i < n_rows; ++i) {
+		if ((i & 1023) == 0) {
+			R_CheckUserInterrupt();
+		}
+		if ((location = get_index_of_marker(d, marker_names[i])) >= 0) {
+			add_loaded_effect(d, location, alleles[i], effects[i]);
+			n_loaded += 1;
+		}
 	}
-	d->e.effect_names[n_allele] = '\0'; // string terminator
-
-	// integer division is intended here.
-	Rprintf("%d effect values spanning %d alleles loaded.\n", n_loaded, n_allele);
 	
-	fclose(fp);
-	return;
+	Rprintf("%d effect values spanning %d alleles loaded.\n", n_loaded, d->e.effects.rows);
 }
 
 /** Populates a SimData combination from scratch with marker allele data, a genetic map, and 
@@ -866,3 +1446,1283 @@ int load_all_simdata(SimData* d, const char* data_file, const char* map_file, co
 	get_chromosome_locations(d);
 	return gp;
 }
+
+/*-------------------------------PLINK filesets-------------------------------*/
+
+/** Get the name of one of the other files in a PLINK fileset from the name 
+ * of its .bed file, eg "data.bim" from "data.bed".
+ *
+ * @param bed_file name of the .bed file. Must end in ".bed".
+ * @param extension the extension of the file wanted, eg ".bim".
+ * @returns a heap string containing the name of the other file.
+ */
+static char* get_plink_filename(const char* bed_file, const char* extension) {
+	size_t stem_length = strlen(bed_file) - 4;
+	char* name = get_malloc(sizeof(char) * (stem_length + strlen(extension) + 1));
+	memcpy(name, bed_file, stem_length);
+	strcpy(name + stem_length, extension);
+	return name;
+}
+
+/** Convert a PLINK or VCF chromosome code to a chromosome number. Codes may be 
+ * numbers, with or without a "chr" prefix, or one of X, Y, XY and MT, which 
+ * become 23, 24, 25 and 26 as they do in PLINK.
+ *
+ * @param cell pointer to the first character of the code.
+ * @param length the number of characters in the code.
+ * @returns the chromosome number, or 0 if the code is not recognised or the
+ * marker is unplaced.
+ */
+static int get_chromosome_number(const char* cell, int length) {
+	if (length > 3 && strncmp(cell, "chr", 3) == 0) {
+		cell += 3;
+		length -= 3;
+	}
+	if (length == 1 && cell[0] == 'X') { return 23; }
+	if (length == 1 && cell[0] == 'Y') { return 24; }
+	if (length == 2 && cell[0] == 'X' && cell[1] == 'Y') { return 25; }
+	if (length == 2 && cell[0] == 'M' && cell[1] == 'T') { return 26; }
+	
+	int chr = 0;
+	for (int i = 0; i < length; ++i) {
+		if (!isdigit((unsigned char) cell[i])) {
+			return 0;
+		}
+		chr = 10 * chr + (cell[i] - '0');
+	}
+	return chr;
+}
+
+/** Decode part of one marker's variant block from a PLINK .bed file, saving the 
+ * alleles to the genotypes being loaded. @see load_plink_genes_to_simdata()
+ *
+ * The phase of heterozygous calls is chosen using one random bit per call. 
+ * Each run of 64 genotypes at each marker gets its own RandomStream, so the 
+ * phases do not depend on how the block is split up.
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param genes array of the genotypes being loaded, in the order of the .fam file.
+ * @param first_genotype index in `genes` of the first genotype to decode. 
+ * Must be a multiple of 64.
+ * @param end_genotype index in `genes` just past the last genotype to decode.
+ * @param marker index of the marker in `d->markers` this block describes.
+ * @param block pointer to the start of the marker's variant block.
+ * @param allele1 the first allele of the marker in the .bim file.
+ * @param allele2 the second allele of the marker in the .bim file.
+ * @param seed the seed of the RandomStreams used to choose phases.
+ * @returns the number of genotypes decoded whose call at this marker was missing.
+ */
+static int load_plink_block(SimData* d, char** genes, int first_genotype, int end_genotype, 
+		int marker, const unsigned char* block, char allele1, char allele2, uint64_t seed) {
+	unsigned char v1 = (unsigned char) allele1, v2 = (unsigned char) allele2;
+	if (d->packed_alleles) {
+		v1 = find_allele_code(d, marker, allele1);
+		v2 = find_allele_code(d, marker, allele2);
+	}
+	// the stored values for each 2-bit call: homozygous for the first allele,
+	// missing, heterozygous, and homozygous for the second allele.
+	const unsigned char stored[4][2] = { {v1, v1}, {0, 0}, {v1, v2}, {v2, v2} };
+	
+	int n_missing = 0;
+	uint64_t phase_bits = 0;
+	for (int i = first_genotype; i < end_genotype; ++i) {
+		int call = (block[i >> 2] >> ((i & 3) << 1)) & 3;
+		if ((i & 63) == 0) {
+			RandomStream r = create_random_stream(seed, ((uint64_t) marker << 32) | (i >> 6));
+			phase_bits = get_random_bits(&r);
+		}
+		// swap the alleles of a heterozygote if its phase bit is set.
+		int swap = (call == 2) & (int) ((phase_bits >> (i & 63)) & 1);
+		n_missing += (call == 1);
+		set_stored_allele(d, genes[i], marker, 0, stored[call][swap]);
+		set_stored_allele(d, genes[i], marker, 1, stored[call][1 - swap]);
+	}
+	return n_missing;
+}
+
+/** Populates a SimData combination with marker allele data from a PLINK binary
+ * fileset (.bed, .bim and .fam files with the same name).
+ * @see load_transposed_genes_to_simdata()
+ * Assumes it is starting from a clean/empty SimData.
+ *
+ * Genotypes are named after the individual IDs (second column) in the .fam file.
+ * Markers are named after the variant IDs (second column) in the .bim file, 
+ * and their alleles are its fifth and sixth columns. Markers whose alleles are
+ * longer than one character (eg indels) are not loaded. The .bim map columns 
+ * are not read here. @see load_plink_map_to_simdata()
+ *
+ * The .bed file must be in the usual SNP-major mode. It is memory-mapped and
+ * its variant blocks are decoded directly into genotype storage, in parallel
+ * using up to `d->n_threads` threads. Because PLINK genotypes are unphased, the 
+ * phase at each heterozygous call is chosen randomly, as for 
+ * load_transposed_encoded_genes_to_simdata(). Missing calls are stored as 
+ * alleles that could not be loaded.
+ *
+ * Note: this function should be called first when populating a SimData object -
+ * it clears everything in the SimData. This is because all the data in SimData
+ * is based on what markers exist in the loaded marker allele file.
+ *
+ * An output message stating the number of genotypes and number of markers loaded 
+ * is printed to stdout.
+ *
+ * @param d pointer to SimData to be populated
+ * @param bed_file string containing name/path of the .bed file of the fileset.
+ * The .bim and .fam files are found by replacing its extension.
+ * @returns the group number of the loaded genotypes. All genotypes are loaded into
+ * the same group.
+*/
+int load_plink_genes_to_simdata(SimData* d, const char* bed_file) {
+	const int gp = 1;
+	const int markers_per_batch = 1024;
+	const int markers_per_task = 64;
+	const int genotypes_per_tile = 256;
+	int length;
+	
+	// the .bim file has one line per variant block in the .bed file
+	char* bim_file = get_plink_filename(bed_file, ".bim");
+	MappedFile bim = open_mapped_file(bim_file);
+	TextLines bim_lines = find_text_lines(&bim);
+	int n_variants = bim_lines.n_lines;
+	int* marker_variants = get_malloc(sizeof(int) * n_variants);
+	char* alleles = get_malloc(sizeof(char) * 2 * n_variants);
+	d->markers = get_malloc(sizeof(char*) * n_variants);
+	d->n_markers = 0;
+	for (int k = 0; k < n_variants; ++k) {
+		const char* pos = bim_lines.starts[k];
+		const char* cells[6];
+		int lengths[6];
+		for (int c = 0; c < 6; ++c) {
+			cells[c] = next_cell(&pos, bim_lines.ends[k], &(lengths[c]));
+		}
+		if (lengths[5] == 0) {
+			error( "Line %d of file %s does not have six columns.\n", k + 1, bim_file);
+		}
+		if (lengths[4] != 1 || lengths[5] != 1) {
+			continue; // alleles cannot be stored as single characters
+		}
+		marker_variants[d->n_markers] = k;
+		alleles[2 * d->n_markers] = cells[4][0];
+		alleles[2 * d->n_markers + 1] = cells[5][0];
+		d->markers[d->n_markers] = copy_cell(cells[1], lengths[1]);
+		++ d->n_markers;
+	}
+	delete_string_index(&(d->marker_index));
+	delete_text_lines(&bim_lines);
+	close_mapped_file(&bim);
+	if (d->n_markers < n_variants) {
+		warning("%d markers in file %s have alleles longer than one character, and were not loaded.\n",
+				n_variants - d->n_markers, bim_file);
+	}
+	free(bim_file);
+	
+	// the .fam file has one line per genotype. Create the blocks that will
+	// hold the genotypes, and name them from it.
+	char* fam_file = get_plink_filename(bed_file, ".fam");
+	MappedFile fam = open_mapped_file(fam_file);
+	TextLines fam_lines = find_text_lines(&fam);
+	int n_genotypes = fam_lines.n_lines;
+	if (n_genotypes < 1) {
+		error( "No genotypes were found in file %s.\n", fam_file);
+	}
+	
+	create_allele_dictionary(d);
+	d->m = create_allelematrix_chain(d, n_genotypes);
+	char** genes = get_malloc(sizeof(char*) * n_genotypes);
+	int i = 0;
+	for (AlleleMatrix* current_am = d->m; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am, ++i) {
+			const char* pos = fam_lines.starts[i];
+			next_cell(&pos, fam_lines.ends[i], &length); // family ID
+			const char* cell = next_cell(&pos, fam_lines.ends[i], &length);
+			if (length == 0) {
+				error( "Line %d of file %s has no individual ID.\n", i + 1, fam_file);
+			}
+			current_am->subject_names[i_am] = copy_cell(cell, length);
+			current_am->groups[i_am] = gp;
+			genes[i] = current_am->alleles[i_am];
+		}
+	}
+	set_subject_ids(d, 0, n_genotypes - 1);
+	delete_text_lines(&fam_lines);
+	close_mapped_file(&fam);
+	free(fam_file);
+	
+	// check the .bed file matches
+	MappedFile bed = open_mapped_file(bed_file);
+	const unsigned char* bed_data = (const unsigned char*) bed.data;
+	size_t block_length = ((size_t) n_genotypes + 3) / 4;
+	if (bed.length < 3 || bed_data[0] != 0x6c || bed_data[1] != 0x1b) {
+		close_mapped_file(&bed);
+		error( "File %s is not a PLINK .bed file.\n", bed_file);
+	}
+	if (bed_data[2] != 0x01) {
+		close_mapped_file(&bed);
+		error( "File %s is in individual-major mode. Only SNP-major .bed files can be loaded.\n", bed_file);
+	}
+	if (bed.length != 3 + block_length * n_variants) {
+		close_mapped_file(&bed);
+		error( "File %s does not have the size expected for %d genotypes of %d markers.\n", 
+				bed_file, n_genotypes, n_variants);
+	}
+	
+	// decode the variant blocks. Markers are handed out in tasks of a multiple 
+	// of four, so when alleles are packed no two threads write to the same byte.
+	// Within a task, a tile of genotypes is decoded at all of the task's 
+	// markers before moving on, so that the writes stay within a few pages.
+	GetRNGstate();
+	uint64_t seed = get_seed_from_R();
+	PutRNGstate();
+	int n_missing = 0;
+	for (int batch_start = 0; batch_start < d->n_markers; batch_start += markers_per_batch) {
+		R_CheckUserInterrupt();
+		int batch_end = batch_start + markers_per_batch < d->n_markers ? batch_start + markers_per_batch : d->n_markers;
+		int n_tasks = (batch_end - batch_start + markers_per_task - 1) / markers_per_task;
+		
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(d->n_threads) schedule(dynamic, 1) reduction(+:n_missing) if(d->n_threads > 1)
+#endif
+		for (int task = 0; task < n_tasks; ++task) {
+			int task_start = batch_start + task * markers_per_task;
+			int task_end = task_start + markers_per_task < batch_end ? task_start + markers_per_task : batch_end;
+			for (int tile = 0; tile < n_genotypes; tile += genotypes_per_tile) {
+				int tile_end = tile + genotypes_per_tile < n_genotypes ? tile + genotypes_per_tile : n_genotypes;
+				for (int j = task_start; j < task_end; ++j) {
+					n_missing += load_plink_block(d, genes, tile, tile_end, j, 
+							bed_data + 3 + block_length * marker_variants[j], 
+							alleles[2 * j], alleles[2 * j + 1], seed);
+				}
+			}
+		}
+	}
+	
+	close_mapped_file(&bed);
+	free(genes);
+	free(marker_variants);
+	free(alleles);
+	Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles were missing\n", n_genotypes, d->n_markers, n_missing);
+	return gp;
+}
+
+/** Populates a SimData combination with the genetic map in the .bim file of a 
+ * PLINK binary fileset. @see load_genmap_to_simdata()
+ *
+ * Chromosomes are read from the first column of the .bim file. They should be
+ * numbers, but X, Y, XY and MT are also accepted, and become chromosomes 23 to 26. 
+ * Markers on chromosome 0 (unplaced) stay unmapped. Positions are the genetic 
+ * distances (third column) in cM. PLINK filesets often leave the genetic distances 
+ * as 0, so if every one is 0, positions are estimated from the base-pair 
+ * coordinates (fourth column) at a flat 1cM per Mb instead.
+ *
+ * Note: this function should be called second when populating a SimData object,
+ * after populating it with marker allele data. Markers without a position are 
+ * deleted, as for load_genmap_to_simdata().
+ *
+ * @param d pointer to SimData to be populated
+ * @param bed_file string containing name/path of the .bed file of the fileset.
+ * The .bim file is found by replacing its extension.
+*/
+void load_plink_map_to_simdata(SimData* d, const char* bed_file) {
+	char* bim_file = get_plink_filename(bed_file, ".bim");
+	MappedFile bim = open_mapped_file(bim_file);
+	TextLines lines = find_text_lines(&bim);
+	
+	if (d->map.positions != NULL) {
+		delete_genmap(&(d->map));
+	}
+	d->map.positions = get_malloc(sizeof(MarkerPosition) * d->n_markers);
+	memset(d->map.positions, 0, sizeof(MarkerPosition) * d->n_markers);
+	
+	// use the genetic distances unless they are missing altogether
+	int have_distances = FALSE;
+	for (int k = 0; k < lines.n_lines && !have_distances; ++k) {
+		const char* pos = lines.starts[k];
+		int length;
+		next_cell(&pos, lines.ends[k], &length);
+		next_cell(&pos, lines.ends[k], &length);
+		const char* cell = next_cell(&pos, lines.ends[k], &length);
+		have_distances = length > 0 && strtod(cell, NULL) != 0;
+	}
+	
+	for (int k = 0; k < lines.n_lines; ++k) {
+		R_CheckUserInterrupt();
+		const char* pos = lines.starts[k];
+		const char* cells[4];
+		int lengths[4];
+		for (int c = 0; c < 4; ++c) {
+			cells[c] = next_cell(&pos, lines.ends[k], &(lengths[c]));
+		}
+		if (lengths[3] == 0) {
+			continue;
+		}
+		
+		char* name = copy_cell(cells[1], lengths[1]);
+		int location = get_index_of_marker(d, name);
+		free(name);
+		if (location >= 0) {
+			d->map.positions[location].chromosome = get_chromosome_number(cells[0], lengths[0]);
+			if (have_distances) {
+				d->map.positions[location].position = strtod(cells[2], NULL);
+			} else {
+				d->map.positions[location].position = strtod(cells[3], NULL) / 1e6;
+			}
+		}
+	}
+	
+	// count number of markers that don't have positions loaded.
+	int n_nopos = 0;
+	for (int i = 0; i < d->n_markers; i++) {
+		if (d->map.positions[i].chromosome == 0) {
+			n_nopos += 1;
+		}
+	}
+	
+	if (!have_distances) {
+		Rprintf("No genetic distances were found in %s, so positions were estimated from base-pair coordinates at 1cM per Mb.\n", bim_file);
+	}
+	Rprintf("%d markers with map positions. %d markers remain unmapped.\n", 
+	d->n_markers - n_nopos, n_nopos);
+	
+	delete_text_lines(&lines);
+	close_mapped_file(&bim);
+	free(bim_file);
+	
+	//Order the markers and positions, eliminating markers with no positions
+	if (n_nopos > 0) {
+		get_sorted_markers(d, d->n_markers - n_nopos);
+		get_chromosome_locations(d);
+	}
+}
+
+/*------------------------------------VCF-------------------------------------*/
+
+/** Find the next tab-separated field of a VCF line, and move past it.
+ *
+ * @param pos pointer to the current position in the line. It is moved to 
+ * the start of the following field.
+ * @param line_end pointer to the end of the line.
+ * @param length location to save the number of characters in the field.
+ * Set to 0 if the line has no more fields.
+ * @returns pointer to the first character of the field.
+ */
+static inline const char* next_vcf_field(const char** pos, const char* line_end, int* length) {
+	const char* start = *pos;
+	const char* p = start;
+	while (p < line_end && *p != '\t') {
+		++p;
+	}
+	*length = p - start;
+	*pos = p < line_end ? p + 1 : line_end;
+	return start;
+}
+
+/** Read one allele index from a VCF GT field, and move past it.
+ *
+ * @param pos pointer to the current position in the field. It is moved past
+ * the allele index.
+ * @param end pointer to the end of the field.
+ * @returns the allele index plus one (so 1 is the REF allele), 0 if the allele
+ * is missing ('.'), or -1 if there is no allele index at `pos`.
+ */
+static int read_vcf_allele(const char** pos, const char* end) {
+	const char* p = *pos;
+	if (p < end && *p == '.') {
+		*pos = p + 1;
+		return 0;
+	}
+	int index = 0;
+	while (p < end && isdigit((unsigned char) *p) && index < 1000) {
+		index = 10 * index + (*p - '0');
+		++p;
+	}
+	if (p == *pos) {
+		return -1;
+	}
+	*pos = p;
+	return index + 1;
+}
+
+/** Populates a SimData combination with marker allele data from a VCF file, 
+ * which may be gzip-compressed. @see load_transposed_genes_to_simdata()
+ * Assumes it is starting from a clean/empty SimData.
+ *
+ * Genotypes are named after the sample columns of the #CHROM header line. 
+ * Each record becomes a marker, named after its ID, or after its CHROM:POS 
+ * if it has no ID. The two alleles of each genotype are taken from the GT 
+ * field, keeping their order for phased ('|') calls. The phase of unphased
+ * ('/') heterozygous calls is chosen randomly, as for 
+ * load_transposed_encoded_genes_to_simdata(). Haploid calls are loaded as 
+ * homozygous, and missing alleles ('.') as alleles that could not be loaded.
+ * Records with an allele longer than one character (eg indels), more than 
+ * 15 alleles, or no GT field are not loaded.
+ *
+ * The file is streamed, and the calls of each record are kept in a compact 
+ * form (one byte per genotype) until all records are read and the number of
+ * markers is known. They are then copied into genotype storage in parallel,
+ * using up to `d->n_threads` threads.
+ *
+ * If a map file is given, only records whose marker is named in the first 
+ * column of the map are kept, and the map is then loaded with 
+ * load_genmap_to_simdata(). Otherwise, the map is taken from the records' CHROM 
+ * and POS, with positions estimated from the base-pair coordinates at a flat
+ * 1cM per Mb. Chromosomes are read as for load_plink_map_to_simdata().
+ *
+ * Note: this function should be called first when populating a SimData object -
+ * it clears everything in the SimData. This is because all the data in SimData
+ * is based on what markers exist in the loaded marker allele file.
+ *
+ * An output message stating the number of genotypes and number of markers loaded 
+ * is printed to stdout.
+ *
+ * @param d pointer to SimData to be populated
+ * @param filename string containing name/path of the VCF file.
+ * @param map_file string containing name/path of a genetic map file in the 
+ * format read by load_genmap_to_simdata(), or NULL to use the VCF's positions.
+ * @returns the group number of the loaded genotypes. All genotypes are loaded into
+ * the same group.
+*/
+int load_vcf_to_simdata(SimData* d, const char* filename, const char* map_file) {
+	const int gp = 1;
+	const int max_alleles = 15;
+	const int markers_per_task = 64;
+	const int genotypes_per_tile = 256;
+	const char* line;
+	const char* line_end;
+	int length;
+	
+	// find the markers to keep, if there is a map to filter on
+	MappedFile map = { .data = NULL, .length = 0, .is_mapped = FALSE };
+	TextLines map_lines = { .n_lines = 0, .starts = NULL, .ends = NULL };
+	char** map_names = NULL;
+	StringIndex filter = create_string_index(0);
+	if (map_file != NULL) {
+		map = open_mapped_file(map_file);
+		map_lines = find_text_lines(&map);
+		map_names = get_malloc(sizeof(char*) * map_lines.n_lines);
+		filter = create_string_index(map_lines.n_lines);
+		for (int k = 1; k < map_lines.n_lines; ++k) { // skip the header
+			const char* pos = map_lines.starts[k];
+			const char* cell = next_cell(&pos, map_lines.ends[k], &length);
+			map_names[k] = copy_cell(cell, length);
+			add_to_string_index(&filter, map_names[k], k);
+		}
+	}
+	
+	// read up to the header line, which names the genotypes
+	LineStream s = open_line_stream(filename);
+	int found_header = FALSE;
+	while (!found_header && next_line(&s, &line, &line_end)) {
+		found_header = (line_end - line > 6 && strncmp(line, "#CHROM", 6) == 0);
+	}
+	if (!found_header) {
+		close_line_stream(&s);
+		error( "No #CHROM header line was found in file %s.\n", filename);
+	}
+	if (line_end > line && line_end[-1] == '\r') {
+		--line_end;
+	}
+	
+	const char* pos = line;
+	for (int c = 0; c < 9; ++c) {
+		next_vcf_field(&pos, line_end, &length);
+	}
+	int n_genotypes = 0;
+	for (const char* p = pos; p < line_end; ++n_genotypes) {
+		next_vcf_field(&p, line_end, &length);
+	}
+	if (n_genotypes < 1) {
+		close_line_stream(&s);
+		error( "No genotypes were found in file %s.\n", filename);
+	}
+	char** sample_names = get_malloc(sizeof(char*) * n_genotypes);
+	for (int i = 0; i < n_genotypes; ++i) {
+		const char* cell = next_vcf_field(&pos, line_end, &length);
+		sample_names[i] = copy_cell(cell, length);
+	}
+	
+	// stream the records, keeping the calls of each as one byte per genotype: 
+	// the allele index plus one of the first allele in the low four bits, and
+	// of the second allele in the high four bits. 0 is a missing allele.
+	GetRNGstate();
+	uint64_t seed = get_seed_from_R();
+	PutRNGstate();
+	int n_markers = 0, capacity = 0;
+	int n_long_alleles = 0, n_no_gt = 0, n_missing = 0;
+	unsigned char* calls = NULL;
+	char* marker_alleles = NULL;
+	char** names = NULL;
+	MarkerPosition* positions = NULL;
+	
+	while (next_line(&s, &line, &line_end)) {
+		if ((n_markers & 1023) == 0) {
+			R_CheckUserInterrupt();
+		}
+		if (line_end > line && line_end[-1] == '\r') {
+			--line_end;
+		}
+		if (line == line_end || line[0] == '#') {
+			continue;
+		}
+		
+		pos = line;
+		const char* fields[9];
+		int lengths[9];
+		for (int c = 0; c < 9; ++c) {
+			fields[c] = next_vcf_field(&pos, line_end, &(lengths[c]));
+		}
+		
+		// the name of the marker
+		char* name;
+		if (lengths[2] > 0 && !(lengths[2] == 1 && fields[2][0] == '.')) {
+			name = copy_cell(fields[2], lengths[2]);
+		} else {
+			name = get_malloc(sizeof(char) * (lengths[0] + lengths[1] + 2));
+			memcpy(name, fields[0], lengths[0]);
+			name[lengths[0]] = ':';
+			memcpy(name + lengths[0] + 1, fields[1], lengths[1]);
+			name[lengths[0] + lengths[1] + 1] = '\0';
+		}
+		if (map_file != NULL && get_from_string_index(&filter, name) < 0) {
+			free(name);
+			continue;
+		}
+		
+		// the alleles: REF, then a comma-separated list of ALT ('.' if none)
+		char alleles[max_alleles];
+		int n_alleles = 0;
+		int usable = lengths[3] == 1;
+		if (usable) {
+			alleles[n_alleles++] = fields[3][0];
+		}
+		if (usable && !(lengths[4] == 1 && fields[4][0] == '.')) {
+			for (int c = 0; c < lengths[4] && usable; c += 2) {
+				usable = n_alleles < max_alleles && (c + 1 == lengths[4] || fields[4][c + 1] == ',');
+				if (usable) {
+					alleles[n_alleles++] = fields[4][c];
+				}
+			}
+		}
+		if (!usable) {
+			++n_long_alleles;
+			free(name);
+			continue;
+		}
+		
+		// find which subfield of each genotype column is the GT
+		int gt_index = -1;
+		const char* format = fields[8];
+		for (int k = 0; format < fields[8] + lengths[8]; ++k) {
+			const char* colon = memchr(format, ':', fields[8] + lengths[8] - format);
+			const char* key_end = colon != NULL ? colon : fields[8] + lengths[8];
+			if (key_end - format == 2 && format[0] == 'G' && format[1] == 'T') {
+				gt_index = k;
+				break;
+			}
+			format = key_end + 1;
+		}
+		if (gt_index < 0) {
+			++n_no_gt;
+			free(name);
+			continue;
+		}
+		
+		// make room for this record
+		if (n_markers >= capacity) {
+			capacity = capacity > 0 ? 2 * capacity : 1024;
+			calls = get_realloc(calls, sizeof(unsigned char) * n_genotypes * (size_t) capacity);
+			marker_alleles = get_realloc(marker_alleles, sizeof(char) * max_alleles * capacity);
+			names = get_realloc(names, sizeof(char*) * capacity);
+			positions = get_realloc(positions, sizeof(MarkerPosition) * capacity);
+		}
+		names[n_markers] = name;
+		memcpy(marker_alleles + max_alleles * n_markers, alleles, sizeof(char) * n_alleles);
+		memset(marker_alleles + max_alleles * n_markers + n_alleles, 0, sizeof(char) * (max_alleles - n_alleles));
+		positions[n_markers].chromosome = get_chromosome_number(fields[0], lengths[0]);
+		positions[n_markers].position = strtod(fields[1], NULL) / 1e6;
+		
+		// and read its calls
+		unsigned char* record_calls = calls + n_genotypes * (size_t) n_markers;
+		RandomStream r = create_random_stream(seed, n_markers);
+		uint64_t phase_bits = 0;
+		int n_phase_bits = 0;
+		for (int i = 0; i < n_genotypes; ++i) {
+			const char* cell = next_vcf_field(&pos, line_end, &length);
+			if (length == 0) {
+				close_line_stream(&s);
+				error( "The record for marker %s in file %s has %d genotypes, but the header names %d.\n", 
+						name, filename, i, n_genotypes);
+			}
+			const char* cell_end = cell + length;
+			const char* gt = cell;
+			for (int k = 0; k < gt_index && gt != NULL; ++k) {
+				gt = memchr(gt, ':', cell_end - gt);
+				if (gt != NULL) {
+					++gt;
+				}
+			}
+			
+			int first = -1, second = -1;
+			char separator = '|';
+			if (gt != NULL) {
+				first = read_vcf_allele(&gt, cell_end);
+				if (gt < cell_end && (*gt == '|' || *gt == '/')) {
+					separator = *gt;
+					++gt;
+					second = read_vcf_allele(&gt, cell_end);
+				} else {
+					second = first; // a haploid call
+				}
+			}
+			if (first < 0 || first > n_alleles) { first = 0; }
+			if (second < 0 || second > n_alleles) { second = 0; }
+			if (first == 0 || second == 0) {
+				++n_missing;
+			}
+			
+			if (separator == '/' && first != second) {
+				if (n_phase_bits == 0) {
+					phase_bits = get_random_bits(&r);
+					n_phase_bits = 64;
+				}
+				if (phase_bits & 1) {
+					int temp = first;
+					first = second;
+					second = temp;
+				}
+				phase_bits >>= 1;
+				--n_phase_bits;
+			}
+			record_calls[i] = (unsigned char) (first | (second << 4));
+		}
+		++n_markers;
+	}
+	close_line_stream(&s);
+	
+	if (n_long_alleles > 0) {
+		warning("%d records in file %s have alleles longer than one character, and were not loaded.\n",
+				n_long_alleles, filename);
+	}
+	if (n_no_gt > 0) {
+		warning("%d records in file %s have no GT field, and were not loaded.\n", n_no_gt, filename);
+	}
+	
+	if (n_markers == 0) {
+		error( "No markers were loaded from file %s.\n", filename);
+	}
+	
+	// now the number of markers is known, create the blocks that will hold the genotypes
+	d->n_markers = n_markers;
+	d->markers = names;
+	delete_string_index(&(d->marker_index));
+	create_allele_dictionary(d);
+	if (d->packed_alleles) {
+		// the codes are allele indexes plus one, as in the compact calls
+		for (int j = 0; j < n_markers; ++j) {
+			if (marker_alleles[max_alleles * j + 3] != '\0') {
+				error("Marker %s has more than three alleles, so its genotypes cannot be stored packed.\n", 
+						d->markers[j]);
+			}
+			memcpy(d->allele_dictionary + 3 * j, marker_alleles + max_alleles * j, sizeof(char) * 3);
+		}
+	}
+	
+	d->m = create_allelematrix_chain(d, n_genotypes);
+	char** genes = get_malloc(sizeof(char*) * n_genotypes);
+	int i = 0;
+	for (AlleleMatrix* current_am = d->m; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am, ++i) {
+			current_am->subject_names[i_am] = sample_names[i];
+			current_am->groups[i_am] = gp;
+			genes[i] = current_am->alleles[i_am];
+		}
+	}
+	set_subject_ids(d, 0, n_genotypes - 1);
+	free(sample_names);
+	
+	// copy the calls into genotype storage. As for load_plink_genes_to_simdata(),
+	// markers are handed out in tasks of a multiple of four and genotypes are
+	// decoded in tiles.
+	for (int batch_start = 0; batch_start < n_markers; batch_start += 1024) {
+		R_CheckUserInterrupt();
+		int batch_end = batch_start + 1024 < n_markers ? batch_start + 1024 : n_markers;
+		int n_tasks = (batch_end - batch_start + markers_per_task - 1) / markers_per_task;
+		
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(d->n_threads) schedule(dynamic, 1) if(d->n_threads > 1)
+#endif
+		for (int task = 0; task < n_tasks; ++task) {
+			int task_start = batch_start + task * markers_per_task;
+			int task_end = task_start + markers_per_task < batch_end ? task_start + markers_per_task : batch_end;
+			for (int tile = 0; tile < n_genotypes; tile += genotypes_per_tile) {
+				int tile_end = tile + genotypes_per_tile < n_genotypes ? tile + genotypes_per_tile : n_genotypes;
+				for (int j = task_start; j < task_end; ++j) {
+					const unsigned char* record_calls = calls + n_genotypes * (size_t) j;
+					const char* alleles = marker_alleles + max_alleles * j;
+					for (int g = tile; g < tile_end; ++g) {
+						unsigned char first = record_calls[g] & 15, second = record_calls[g] >> 4;
+						if (!d->packed_alleles) {
+							first = first ? alleles[first - 1] : 0;
+							second = second ? alleles[second - 1] : 0;
+						}
+						set_stored_allele(d, genes[g], j, 0, first);
+						set_stored_allele(d, genes[g], j, 1, second);
+					}
+				}
+			}
+		}
+	}
+	free(genes);
+	free(calls);
+	free(marker_alleles);
+	Rprintf("%d genotypes of %d markers were loaded. %d pairs of alleles were missing\n", n_genotypes, n_markers, n_missing);
+	
+	// and set up the map
+	if (map_file != NULL) {
+		free(positions);
+		for (int k = 1; k < map_lines.n_lines; ++k) {
+			free(map_names[k]);
+		}
+		free(map_names);
+		delete_string_index(&filter);
+		delete_text_lines(&map_lines);
+		close_mapped_file(&map);
+		load_genmap_to_simdata(d, map_file);
+		
+	} else {
+		if (d->map.positions != NULL) {
+			delete_genmap(&(d->map));
+		}
+		d->map.positions = positions;
+		int n_nopos = 0;
+		for (int j = 0; j < n_markers; j++) {
+			if (d->map.positions[j].chromosome == 0) {
+				n_nopos += 1;
+			}
+		}
+		Rprintf("%d markers with map positions, estimated from base-pair coordinates at 1cM per Mb. %d markers remain unmapped.\n", 
+				n_markers - n_nopos, n_nopos);
+		if (n_nopos > 0) {
+			get_sorted_markers(d, n_markers - n_nopos);
+			get_chromosome_locations(d);
+		}
+	}
+	return gp;
+}
+
+/*-----------------------------In-memory tables-------------------------------*/
+
+/** Set up a SimData to hold genotypes that will be filled from memory rather 
+ * than read from a file. The markers are saved in the order given, and a 
+ * chain of empty genotypes is created with the given names.
+ * @see load_pairs_to_simdata(), load_dosages_to_simdata()
+ *
+ * Note: as for the file loaders, this should be called first when populating
+ * a SimData object.
+ *
+ * @param d pointer to SimData to be populated
+ * @param n_markers the number of markers.
+ * @param marker_names array of `n_markers` marker names. The names are copied.
+ * @param n_genotypes the number of genotypes to create.
+ * @param genotype_names array of `n_genotypes` names, any of which may be NULL
+ * to leave that genotype unnamed, or NULL to leave all of them unnamed. The 
+ * names are copied.
+ * @returns the group number of the created genotypes. All genotypes are created
+ * in the same group.
+ */
+int create_genotypes_in_simdata(SimData* d, int n_markers, const char** marker_names, 
+		int n_genotypes, const char** genotype_names) {
+	const int gp = 1;
+	d->n_markers = n_markers;
+	d->markers = get_malloc(sizeof(char*) * n_markers);
+	for (int j = 0; j < n_markers; ++j) {
+		d->markers[j] = copy_cell(marker_names[j], strlen(marker_names[j]));
+	}
+	delete_string_index(&(d->marker_index));
+	create_allele_dictionary(d);
+	
+	d->m = create_allelematrix_chain(d, n_genotypes);
+	int i = 0;
+	for (AlleleMatrix* current_am = d->m; current_am != NULL; current_am = current_am->next) {
+		for (int i_am = 0; i_am < current_am->n_subjects; ++i_am, ++i) {
+			if (genotype_names != NULL && genotype_names[i] != NULL) {
+				current_am->subject_names[i_am] = copy_cell(genotype_names[i], strlen(genotype_names[i]));
+			}
+			current_am->groups[i_am] = gp;
+		}
+	}
+	
+	// this will also create our unique ids
+	set_subject_ids(d, 0, n_genotypes - 1);
+	return gp;
+}
+
+/** Fill genotypes created by create_genotypes_in_simdata() from a column-major
+ * table of allele pairs, eg "TA", with a row per marker and a column per 
+ * genotype. The alleles are read straight from the table. The first allele of
+ * each pair is the first copy, so phase is kept.
+ *
+ * Pairs that are NULL or not two characters long count as bad cells. As many 
+ * of their alleles as they have are loaded, and the rest are left missing.
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param first_genotype the index of the genotype that is the first column of
+ * `pairs`. Genotypes are counted from the start of the chain.
+ * @param n_genotypes the number of columns of `pairs`.
+ * @param pairs array of `d->n_markers * n_genotypes` pointers to pairs. The 
+ * pair for marker j of column i is `pairs[j + i * d->n_markers]`.
+ * @returns the number of bad cells.
+ */
+int load_pairs_to_simdata(SimData* d, int first_genotype, int n_genotypes, const char** pairs) {
+	int bad_cells = 0;
+	
+	// find the first genotype
+	AlleleMatrix* am = d->m;
+	int i_am = first_genotype;
+	while (am != NULL && i_am >= am->n_subjects) {
+		i_am -= am->n_subjects;
+		am = am->next;
+	}
+	
+	for (int i = 0; i < n_genotypes && am != NULL; ++i) {
+		const char** column = pairs + (size_t) i * d->n_markers;
+		for (int j = 0; j < d->n_markers; ++j) {
+			const char* pair = column[j];
+			int length = 0;
+			if (pair != NULL) {
+				while (length < 3 && pair[length] != '\0') { ++length; }
+			}
+			if (length != 2) {
+				++bad_cells;
+			}
+			if (!load_allele(d, am->alleles[i_am], j, 0, length > 0 ? pair[0] : '\0') ||
+					!load_allele(d, am->alleles[i_am], j, 1, length > 1 ? pair[1] : '\0')) {
+				error("Marker %s has more than three alleles, so its genotypes cannot be stored packed.\n", 
+						d->markers[j]);
+			}
+		}
+		
+		if (++i_am >= am->n_subjects) {
+			am = am->next;
+			i_am = 0;
+		}
+	}
+	return bad_cells;
+}
+
+/** Fill genotypes created by create_genotypes_in_simdata() from a column-major
+ * table of allele dosages, with a row per marker and a column per genotype. 
+ * A dosage is the number of copies (0, 1 or 2) of a marker's alternate allele.
+ * The phase of heterozygous markers is chosen randomly. The table is read 
+ * in place, and genotypes are filled in parallel using `d->n_threads` threads.
+ *
+ * @param d pointer to the SimData that owns the genotypes.
+ * @param dosages array of `d->n_markers` times the number of genotypes in `d`
+ * dosages. The dosage of marker j in genotype i is `dosages[j + i * d->n_markers]`.
+ * @param ref_alleles array of `d->n_markers` reference alleles.
+ * @param alt_alleles array of `d->n_markers` alternate alleles.
+ * @returns the number of dosages that were not 0, 1 or 2, and so were loaded
+ * as missing alleles.
+ */
+int load_dosages_to_simdata(SimData* d, const int* dosages, const char* ref_alleles, const char* alt_alleles) {
+	// the stored values of each marker's two alleles, so that nothing is 
+	// added to the allele dictionary inside the parallel region.
+	unsigned char* stored = get_malloc(sizeof(unsigned char) * 2 * d->n_markers);
+	for (int j = 0; j < d->n_markers; ++j) {
+		if (d->packed_alleles) {
+			stored[2*j] = find_allele_code(d, j, ref_alleles[j]);
+			stored[2*j + 1] = find_allele_code(d, j, alt_alleles[j]);
+		} else {
+			stored[2*j] = (unsigned char) ref_alleles[j];
+			stored[2*j + 1] = (unsigned char) alt_alleles[j];
+		}
+	}
+	
+	int n_genotypes = 0;
+	for (AlleleMatrix* am = d->m; am != NULL; am = am->next) {
+		n_genotypes += am->n_subjects;
+	}
+	char** genes = get_malloc(sizeof(char*) * (n_genotypes > 0 ? n_genotypes : 1));
+	int i = 0;
+	for (AlleleMatrix* am = d->m; am != NULL; am = am->next) {
+		for (int i_am = 0; i_am < am->n_subjects; ++i_am, ++i) {
+			genes[i] = am->alleles[i_am];
+		}
+	}
+	
+	GetRNGstate();
+	uint64_t seed = get_seed_from_R();
+	PutRNGstate();
+	int n_missing = 0;
+	R_CheckUserInterrupt();
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(d->n_threads) schedule(dynamic, 16) reduction(+:n_missing) if(d->n_threads > 1)
+#endif
+	for (int i = 0; i < n_genotypes; ++i) {
+		RandomStream rng = create_random_stream(seed, i);
+		const int* column = dosages + (size_t) i * d->n_markers;
+		uint64_t phase_bits = 0;
+		for (int j = 0; j < d->n_markers; ++j) {
+			if ((j & 63) == 0) {
+				phase_bits = get_random_bits(&rng);
+			}
+			int dosage = column[j];
+			if (dosage < 0 || dosage > 2) {
+				++n_missing; // left as missing alleles
+				continue;
+			}
+			// swap the alleles of a heterozygote if its phase bit is set.
+			int swap = (dosage == 1) & (int) ((phase_bits >> (j & 63)) & 1);
+			set_stored_allele(d, genes[i], j, 0, stored[2*j + (dosage == 2 || swap)]);
+			set_stored_allele(d, genes[i], j, 1, stored[2*j + (dosage > 0 && !swap)]);
+		}
+	}
+	
+	free(genes);
+	free(stored);
+	return n_missing;
+}
+
+/*---------------------------------Snapshots---------------------------------*/
+
+/** Take the next bytes of a snapshot or binary pedigree file, exiting if the 
+ * file ends too soon. @see load_simdata_snapshot()
+ *
+ * @param pos pointer to the current position in the file. It is moved past 
+ * the bytes taken.
+ * @param end pointer to the end of the file.
+ * @param n_bytes the number of bytes to take.
+ * @param filename name of the file, for the error message.
+ * @returns pointer to the first of the bytes taken.
+ */
+static const char* read_snapshot_bytes(const char** pos, const char* end, size_t n_bytes, const char* filename) {
+	if ((size_t) (end - *pos) < n_bytes) {
+		error("File %s ends unexpectedly. It may be incomplete.\n", filename);
+	}
+	const char* start = *pos;
+	*pos += n_bytes;
+	return start;
+}
+
+/** Read a 32-bit integer from a snapshot file. @see read_snapshot_bytes()
+ *
+ * @param pos pointer to the current position in the file. It is moved past 
+ * the integer.
+ * @param end pointer to the end of the file.
+ * @param filename name of the file, for the error message.
+ * @returns the integer read.
+ */
+static int32_t read_snapshot_int(const char** pos, const char* end, const char* filename) {
+	int32_t value;
+	memcpy(&value, read_snapshot_bytes(pos, end, sizeof(int32_t), filename), sizeof(int32_t));
+	return value;
+}
+
+/** Read a string from a snapshot file into a new heap string. 
+ * @see save_simdata_snapshot() for the format.
+ *
+ * @param pos pointer to the current position in the file. It is moved past 
+ * the string.
+ * @param end pointer to the end of the file.
+ * @param filename name of the file, for the error message.
+ * @returns a heap copy of the string, or NULL if a NULL string was saved.
+ */
+static char* read_snapshot_string(const char** pos, const char* end, const char* filename) {
+	int32_t length = read_snapshot_int(pos, end, filename);
+	if (length < 0) {
+		return NULL;
+	}
+	return copy_cell(read_snapshot_bytes(pos, end, length, filename), length);
+}
+
+/** Read a count from a snapshot file, exiting if it is outside the range 
+ * that the format and the rest of the file allow. @see read_snapshot_int()
+ *
+ * @param pos pointer to the current position in the file. It is moved past 
+ * the count.
+ * @param end pointer to the end of the file.
+ * @param min the smallest valid count.
+ * @param max the largest valid count.
+ * @param filename name of the file, for the error message.
+ * @returns the count read.
+ */
+static int read_snapshot_count(const char** pos, const char* end, int min, size_t max, const char* filename) {
+	int32_t value = read_snapshot_int(pos, end, filename);
+	if (value < min || (value > 0 && (size_t) value > max)) {
+		error("Snapshot %s is damaged: it contains an invalid count.\n", filename);
+	}
+	return value;
+}
+
+/** Populates a SimData with the complete state saved in a binary snapshot 
+ * file by save_simdata_snapshot(). Assumes it is starting from a clean/empty 
+ * SimData, such as one from create_empty_simdata().
+ *
+ * The file is memory-mapped, and the genotypes are used where they lie in 
+ * the mapping instead of being copied, so loading takes time proportional 
+ * to the number of genotypes and markers, not the size of the genome data.
+ * Pages of genotypes are read from disk as they are first used. The mapping
+ * is kept in `d->snapshot` until the SimData is deleted. Changes to the 
+ * genotypes are never written back to the file. A gzip-compressed snapshot
+ * is inflated into memory instead of being mapped.
+ *
+ * Every count in the file is checked against the space left in the file 
+ * before anything is allocated for it. If the file is not a valid snapshot, 
+ * the simulation exits, leaving the SimData partly filled but safe to 
+ * delete with delete_simdata(), which also releases the file.
+ *
+ * An output message stating the number of genotypes and number of markers loaded 
+ * is printed to stdout.
+ *
+ * @param d pointer to SimData to be populated
+ * @param filename string containing name/path of the snapshot file.
+ */
+void load_simdata_snapshot(SimData* d, const char* filename) {
+	d->snapshot = open_mapped_file(filename);
+	const char* start = d->snapshot.data;
+	const char* pos = start;
+	const char* end = start + d->snapshot.length;
+	
+	/* Header */
+	if (d->snapshot.length < 8 || memcmp(pos, SNAPSHOT_MAGIC, 8) != 0) {
+		error("File %s is not a genomicSimulation snapshot.\n", filename);
+	}
+	pos += 8;
+	int version = read_snapshot_int(&pos, end, filename);
+	if (version < 1 || version > SNAPSHOT_VERSION) {
+		error("Snapshot %s has format version %d, but only versions 1 to %d can be loaded.\n", 
+				filename, version, SNAPSHOT_VERSION);
+	}
+	if (read_snapshot_int(&pos, end, filename) != 0x01020304) {
+		error("Snapshot %s was saved on a machine with a different byte order.\n", filename);
+	}
+	// each marker name takes at least 4 bytes
+	int n_markers = read_snapshot_count(&pos, end, 0, (end - pos) / sizeof(int32_t), filename);
+	d->packed_alleles = read_snapshot_count(&pos, end, 0, 1, filename);
+	d->block_capacity = read_snapshot_count(&pos, end, 1, INT_MAX, filename);
+	d->current_id = (unsigned int) read_snapshot_int(&pos, end, filename);
+	// each chromosome takes an end index and a length
+	int n_chr = read_snapshot_count(&pos, end, -1, (end - pos) / (sizeof(int) + sizeof(float)), filename);
+	int effect_rows = read_snapshot_count(&pos, end, 0, end - pos, filename);
+	int effect_cols = read_snapshot_count(&pos, end, 0, (end - pos) / sizeof(double), filename);
+	// each block takes at least its length
+	int n_blocks = read_snapshot_count(&pos, end, 0, (end - pos) / sizeof(int32_t), filename);
+	if (effect_rows > 0 && (effect_cols != n_markers || 
+			(size_t) effect_rows > (size_t) (end - pos) / (1 + sizeof(double) * effect_cols))) {
+		error("Snapshot %s is damaged: its effect matrix does not fit.\n", filename);
+	}
+	
+	/* Markers */
+	d->markers = get_malloc(sizeof(char*) * n_markers);
+	for (int i = 0; i < n_markers; ++i) {
+		d->markers[i] = NULL;
+	}
+	d->n_markers = n_markers;
+	delete_string_index(&(d->marker_index));
+	for (int i = 0; i < d->n_markers; ++i) {
+		d->markers[i] = read_snapshot_string(&pos, end, filename);
+	}
+	if (d->packed_alleles) {
+		create_allele_dictionary(d);
+		memcpy(d->allele_dictionary, read_snapshot_bytes(&pos, end, 3 * d->n_markers, filename), 
+				sizeof(char) * 3 * d->n_markers);
+	}
+	
+	/* Genetic map */
+	if (n_chr >= 0) {
+		d->map.n_chr = n_chr;
+		d->map.chr_ends = get_malloc(sizeof(int) * (n_chr + 1));
+		memcpy(d->map.chr_ends, read_snapshot_bytes(&pos, end, sizeof(int) * (n_chr + 1), filename), 
+				sizeof(int) * (n_chr + 1));
+		d->map.chr_lengths = get_malloc(sizeof(float) * n_chr);
+		memcpy(d->map.chr_lengths, read_snapshot_bytes(&pos, end, sizeof(float) * n_chr, filename), 
+				sizeof(float) * n_chr);
+		d->map.positions = get_malloc(sizeof(MarkerPosition) * d->n_markers);
+		for (int i = 0; i < d->n_markers; ++i) {
+			d->map.positions[i].chromosome = read_snapshot_int(&pos, end, filename);
+			memcpy(&(d->map.positions[i].position), read_snapshot_bytes(&pos, end, sizeof(float), filename), 
+					sizeof(float));
+		}
+	}
+	
+	/* Effects */
+	if (effect_rows > 0) {
+		d->e.effect_names = copy_cell(read_snapshot_bytes(&pos, end, effect_rows, filename), effect_rows);
+		d->e.effects = generate_zero_dmatrix(effect_rows, effect_cols);
+		for (int i = 0; i < effect_rows; ++i) {
+			memcpy(d->e.effects.matrix[i], read_snapshot_bytes(&pos, end, sizeof(double) * effect_cols, filename), 
+					sizeof(double) * effect_cols);
+		}
+	}
+	
+	/* Genotypes */
+	size_t glen = get_genotype_length(d);
+	int n_genotypes = 0;
+	AlleleMatrix* last = NULL;
+	for (int b = 0; b < n_blocks; ++b) {
+		R_CheckUserInterrupt();
+		// each genotype takes at least its id, parents and group
+		size_t max_n = (end - pos) / (4 * sizeof(unsigned int));
+		int n = read_snapshot_count(&pos, end, 0, 
+				max_n < (size_t) d->block_capacity ? max_n : (size_t) d->block_capacity, filename);
+		AlleleMatrix* m = create_empty_allelematrix(d, 0);
+		if (last == NULL) {
+			d->m = m;
+		} else {
+			last->next = m;
+		}
+		last = m;
+		
+		m->alleles = get_malloc(sizeof(char*) * n);
+		m->subject_names = get_malloc(sizeof(char*) * n);
+		for (int i = 0; i < n; ++i) {
+			m->alleles[i] = NULL;
+			m->subject_names[i] = NULL;
+		}
+		m->capacity = n;
+		m->ids = get_malloc(sizeof(unsigned int) * n);
+		m->pedigrees[0] = get_malloc(sizeof(unsigned int) * n);
+		m->pedigrees[1] = get_malloc(sizeof(unsigned int) * n);
+		m->groups = get_malloc(sizeof(unsigned int) * n);
+		memcpy(m->ids, read_snapshot_bytes(&pos, end, sizeof(unsigned int) * n, filename), sizeof(unsigned int) * n);
+		memcpy(m->pedigrees[0], read_snapshot_bytes(&pos, end, sizeof(unsigned int) * n, filename), sizeof(unsigned int) * n);
+		memcpy(m->pedigrees[1], read_snapshot_bytes(&pos, end, sizeof(unsigned int) * n, filename), sizeof(unsigned int) * n);
+		memcpy(m->groups, read_snapshot_bytes(&pos, end, sizeof(unsigned int) * n, filename), sizeof(unsigned int) * n);
+		for (int i = 0; i < n; ++i) {
+			if (m->ids[i] > d->current_id) {
+				error("Snapshot %s is damaged: it contains an id that was never allocated.\n", filename);
+			}
+			m->subject_names[i] = read_snapshot_string(&pos, end, filename);
+		}
+		
+		// the genotypes are used in place in the mapping
+		if ((pos - start) % 8 != 0) {
+			read_snapshot_bytes(&pos, end, 8 - (pos - start) % 8, filename);
+		}
+		if (n > 0) {
+			m->allele_slab = (char*) read_snapshot_bytes(&pos, end, glen * n, filename);
+			m->slab_is_borrowed = TRUE;
+		}
+		for (int i = 0; i < n; ++i) {
+			m->alleles[i] = m->allele_slab + glen * i;
+		}
+		m->n_subjects = n;
+		n_genotypes += n;
+	}
+	
+	/* Pedigrees of deleted genotypes */
+	if (version >= 2) {
+		// each record takes at least its id, parents and name length
+		int n = read_snapshot_count(&pos, end, 0, (end - pos) / (4 * sizeof(unsigned int)), filename);
+		// ids, then first parents, then second parents
+		const char* columns = read_snapshot_bytes(&pos, end, sizeof(unsigned int) * 3 * n, filename);
+		for (int i = 0; i < n; ++i) {
+			unsigned int record[3];
+			for (int k = 0; k < 3; ++k) {
+				memcpy(record + k, columns + sizeof(unsigned int) * ((size_t) k * n + i), sizeof(unsigned int));
+			}
+			if (record[0] > d->current_id) {
+				error("Snapshot %s is damaged: it contains an id that was never allocated.\n", filename);
+			}
+			char* name = read_snapshot_string(&pos, end, filename);
+			add_to_pedigree_table(&(d->deleted_pedigrees), record[0], record[1], record[2], name);
+			if (name != NULL) {
+				free(name);
+			}
+		}
+	}
+	
+	rebuild_id_index(d);
+	Rprintf("%d genotypes of %d markers were loaded.\n", n_genotypes, d->n_markers);
+}
+
+/*------------------------------Binary pedigrees-----------------------------*/
+
+/** Attach the pedigrees saved in a binary pedigree file by save_binary_pedigree()
+ * or save_group_binary_pedigree() to the genotypes of a SimData, matching 
+ * them by id. This is mainly for restoring pedigrees to a SimData loaded with
+ * load_simdata_snapshot(), which keeps the ids genotypes had when they were saved.
+ *
+ * A genotype in the SimData that has the same id as a record is given the 
+ * record's parents, and the record's name if it has none. Records of ids that 
+ * are not in the SimData are kept in `d->deleted_pedigrees`, so they can still
+ * be traced as ancestors of the genotypes that are. If the file contains ids 
+ * higher than any the SimData has allocated, `d->current_id` is raised so that
+ * new genotypes will not share them.
+ *
+ * The file may be gzip-compressed. An output message stating the number of
+ * records loaded is printed to stdout.
+ *
+ * @param d pointer to the SimData to attach the pedigrees to.
+ * @param filename string containing name/path of the binary pedigree file.
+ * @returns the number of records that matched a genotype in the SimData.
+ */
+int load_binary_pedigree_to_simdata(SimData* d, const char* filename) {
+	MappedFile f = open_mapped_file(filename);
+	const char* pos = f.data;
+	const char* end = f.data + f.length;
+	
+	/* Header */
+	if (f.length < 8 || memcmp(pos, PEDIGREE_MAGIC, 8) != 0) {
+		close_mapped_file(&f);
+		error("File %s is not a genomicSimulation binary pedigree.\n", filename);
+	}
+	pos += 8;
+	int version = read_snapshot_int(&pos, end, filename);
+	if (version != PEDIGREE_FORMAT_VERSION) {
+		close_mapped_file(&f);
+		error("Binary pedigree %s has format version %d, but only version %d can be loaded.\n", 
+				filename, version, PEDIGREE_FORMAT_VERSION);
+	}
+	if (read_snapshot_int(&pos, end, filename) != 0x01020304) {
+		close_mapped_file(&f);
+		error("Binary pedigree %s was saved on a machine with a different byte order.\n", filename);
+	}
+	uint32_t n_records = (uint32_t) read_snapshot_int(&pos, end, filename);
+	const char* records = read_snapshot_bytes(&pos, end, sizeof(uint32_t) * 3 * (size_t) n_records, filename);
+	
+	/* Records, with the name table following them */
+	unsigned int max_id = d->current_id;
+	int n_matched = 0;
+	for (uint32_t i = 0; i < n_records; ++i) {
+		if (i % 65536 == 0) {
+			R_CheckUserInterrupt();
+		}
+		uint32_t record[3];
+		memcpy(record, records + sizeof(record) * i, sizeof(record));
+		const char* name_end = memchr(pos, '\0', end - pos);
+		if (name_end == NULL) {
+			close_mapped_file(&f);
+			error("File %s ends unexpectedly. It may be incomplete.\n", filename);
+		}
+		const char* name = (name_end > pos) ? pos : NULL;
+		pos = name_end + 1;
+		if (record[0] == 0) {
+			continue;
+		}
+		
+		for (int k = 0; k < 3; ++k) {
+			if (record[k] > max_id) {
+				max_id = record[k];
+			}
+		}
+		IdLocation loc = get_location_of_id(d, record[0]);
+		if (loc.block != NULL) {
+			loc.block->pedigrees[0][loc.slot] = record[1];
+			loc.block->pedigrees[1][loc.slot] = record[2];
+			if (loc.block->subject_names[loc.slot] == NULL && name != NULL) {
+				loc.block->subject_names[loc.slot] = copy_cell(name, name_end - name);
+			}
+			++n_matched;
+		} else {
+			add_to_pedigree_table(&(d->deleted_pedigrees), record[0], record[1], record[2], name);
+		}
+	}
+	close_mapped_file(&f);
+	
+	// names and parents may have changed, so the lookups are rebuilt when next needed
+	d->current_id = max_id;
+	delete_string_index(&(d->name_index));
+	delete_pair_index(&(d->child_index));
+	Rprintf("%u pedigree records were loaded, %d of which matched genotypes in the simulation.\n", 
+			n_records, n_matched);
+	return n_matched;
+}
@@ -1,19 +1,126 @@
 #ifndef SIM_LOADERS_H
 #define SIM_LOADERS_H
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "sim-utils.h"
 #include "sim-printers.h"
+#include "sim-rng.h"
+
+/** The positions of the non-blank lines in a MappedFile. 
+ * @see find_text_lines()
+ *
+ * @param n_lines the number of lines found.
+ * @param starts heap array of pointers to the first character of each line.
+ * @param ends heap array of pointers to the character just past the end of 
+ * each line (its newline, or the end of the file).
+ */
+typedef struct {
+	int n_lines;
+	const char** starts;
+	const char** ends;
+} TextLines;
+
+/** A text file, which may be gzip-compressed, being read one line at a time. 
+ * Unlike a MappedFile, only a buffer's worth of the file is held in memory.
+ * @see open_line_stream()
+ *
+ * @param file the zlib handle of the open file.
+ * @param buffer heap buffer holding the part of the file being read.
+ * @param capacity the size of `buffer`.
+ * @param start offset in `buffer` of the first character not yet returned.
+ * @param end offset in `buffer` just past the last character read from the file.
+ * @param at_eof TRUE once the whole file has been read into the buffer.
+ */
+typedef struct {
+	gzFile file;
+	char* buffer;
+	size_t capacity;
+	size_t start;
+	size_t end;
+	int at_eof;
+} LineStream;
+
+/* File reading */
+TextLines find_text_lines(const MappedFile* f);
+void delete_text_lines(TextLines* lines);
+char* copy_cell(const char* cell, int length);
+LineStream open_line_stream(const char* filename);
+int next_line(LineStream* s, const char** line_start, const char** line_end);
+void close_line_stream(LineStream* s);
+
+/** Check if a character separates cells in a table file. Cells may be 
+ * separated by any run of spaces or tabs, and a carriage return before a 
+ * newline is ignored.
+ *
+ * @param c the character to check.
+ * @returns TRUE if `c` is a space, tab or carriage return, FALSE otherwise.
+ */
+static inline int is_cell_separator(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/** Find the next cell in a line of a table file, and move past it.
+ *
+ * @param pos pointer to the current position in the line. It is moved to 
+ * just past the end of the cell that is found.
+ * @param line_end pointer to the end of the line.
+ * @param length location to save the number of characters in the cell. 
+ * Set to 0 if the line has no more cells.
+ * @returns pointer to the first character of the cell. The cell is not 
+ * null-terminated. @see copy_cell()
+ */
+static inline const char* next_cell(const char** pos, const char* line_end, int* length) {
+	const char* p = *pos;
+	while (p < line_end && is_cell_separator(*p)) {
+		++p;
+	}
+	const char* start = p;
+	while (p < line_end && !is_cell_separator(*p)) {
+		++p;
+	}
+	*length = p - start;
+	*pos = p;
+	return start;
+}
+
+/** Count the cells in a line of a table file.
+ *
+ * @param pos pointer to the start of the line.
+ * @param line_end pointer to the end of the line.
+ * @returns the number of cells in the line.
+ */
+static inline int count_cells(const char* pos, const char* line_end) {
+	int n = 0, length;
+	next_cell(&pos, line_end, &length);
+	while (length > 0) {
+		++n;
+		next_cell(&pos, line_end, &length);
+	}
+	return n;
+}
 
 /* Loaders */
 int load_transposed_genes_to_simdata(SimData* d, const char* filename);
 int load_more_transposed_genes_to_simdata(SimData* d, const char* filename);
-//int load_genes_to_simdata(SimData* d, const char* filename); //@ add
-//int load_more_genes_to_simdata(SimData* d, const char* filename); //@ add
+int load_genes_to_simdata(SimData* d, const char* filename);
+int load_more_genes_to_simdata(SimData* d, const char* filename);
 int load_transposed_encoded_genes_to_simdata(SimData* d, const char* filename);
 void load_genmap_to_simdata(SimData* d, const char* filename);
+void load_genmap_from_arrays(SimData* d, int n_rows, const char** marker_names, const int* chromosomes, const double* positions);
+int load_plink_genes_to_simdata(SimData* d, const char* bed_file);
+void load_plink_map_to_simdata(SimData* d, const char* bed_file);
+int load_vcf_to_simdata(SimData* d, const char* filename, const char* map_file);
 void get_sorted_markers(SimData* d, int actual_n_markers);
 void get_chromosome_locations(SimData *d);
 void load_effects_to_simdata(SimData* d, const char* filename);
+void load_effects_from_arrays(SimData* d, int n_rows, const char** marker_names, const char* alleles, const double* effects);
 int load_all_simdata(SimData* d, const char* data_file, const char* map_file, const char* effect_file);
+void load_simdata_snapshot(SimData* d, const char* filename);
+int load_binary_pedigree_to_simdata(SimData* d, const char* filename);
+int create_genotypes_in_simdata(SimData* d, int n_markers, const char** marker_names, int n_genotypes, const char** genotype_names);
+int load_pairs_to_simdata(SimData* d, int first_genotype, int n_genotypes, const char** pairs);
+int load_dosages_to_simdata(SimData* d, const int* dosages, const char* ref_alleles, const char* alt_alleles);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "sim-output.h"
+
+/*-------------------------------Output Buffers------------------------------*/
+
+/** Open a file for writing through an OutputBuffer.
+ *
+ * The buffer is large (1MB) and is reused for everything written to the
+ * file, so a save function costs one allocation no matter how big the
+ * table it writes. Close the file with close_output_buffer() so the
+ * last of the buffer reaches the file.
+ *
+ * @param filename name of the file to open.
+ * @param compress if TRUE, the file is gzip-compressed. @see open_output_file()
+ * @returns an OutputBuffer ready to be written to.
+ */
+OutputBuffer open_output_buffer(const char* filename, int compress) {
+	OutputBuffer b;
+	b.file = open_output_file(filename, compress);
+	b.capacity = 1 << 20;
+	b.buffer = get_malloc(sizeof(char) * b.capacity);
+	b.length = 0;
+	return b;
+}
+
+/** Pass everything waiting in an OutputBuffer to its file, leaving the
+ * buffer empty.
+ *
+ * @param b pointer to the OutputBuffer to flush.
+ */
+void flush_output_buffer(OutputBuffer* b) {
+	if (b->length > 0 && gzwrite(b->file, b->buffer, b->length) == 0) {
+		error("Failed to write to file.\n");
+	}
+	b->length = 0;
+}
+
+/** Flush an OutputBuffer, close its file and free the buffer.
+ *
+ * @param b pointer to the OutputBuffer to close.
+ */
+void close_output_buffer(OutputBuffer* b) {
+	flush_output_buffer(b);
+	gzclose(b->file);
+	b->file = NULL;
+	free(b->buffer);
+	b->buffer = NULL;
+	b->capacity = 0;
+}
+
+/** Get the number of (uncompressed) characters written to an OutputBuffer
+ * since it was opened, counting those still waiting in the buffer.
+ *
+ * @param b pointer to the OutputBuffer to check.
+ * @returns the position the next character will be written at.
+ */
+size_t get_output_position(OutputBuffer* b) {
+	return gztell(b->file) + b->length;
+}
+
+/** Write some characters that do not fit in the space left in an
+ * OutputBuffer. The buffer is flushed, then the characters are either
+ * buffered or, if there are more of them than the buffer holds, passed
+ * straight to the file. Called by write_chars().
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param s the characters to write.
+ * @param n the number of characters to write.
+ */
+void write_past_output_buffer(OutputBuffer* b, const char* s, size_t n) {
+	flush_output_buffer(b);
+	if (n < b->capacity) {
+		memcpy(b->buffer, s, n);
+		b->length = n;
+		return;
+	}
+	while (n > 0) {
+		unsigned int piece = n < b->capacity ? n : b->capacity;
+		if (gzwrite(b->file, s, piece) == 0) {
+			error("Failed to write to file.\n");
+		}
+		s += piece;
+		n -= piece;
+	}
+}
+
+/** Write a double to an OutputBuffer in the format printf's "%f" gives it:
+ * the whole integer part, a point, and six decimal places, rounded to nearest.
+ * Output is identical to the "%f" the save functions used to use.
+ *
+ * Values of moderate size are formatted by hand. Values that are huge,
+ * not finite, or so close to halfway between two six-decimal-place numbers
+ * that the rounding can't be decided from the scaled fraction, are passed
+ * to snprintf instead.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param value the number to write.
+ */
+void write_decimal(OutputBuffer* b, double value) {
+	double magnitude = fabs(value);
+	if (magnitude < 1e15) { // also false for NaN
+		double whole = floor(magnitude);
+		// the subtraction is exact, so the only rounding error is in the
+		// multiplication, which is far smaller than the margin below.
+		double scaled = (magnitude - whole) * 1e6;
+		double places = floor(scaled);
+		double remainder = scaled - places;
+		if (fabs(remainder - 0.5) > 1e-6) {
+			uint64_t integer = (uint64_t) whole;
+			uint64_t fraction = (uint64_t) places + (remainder > 0.5);
+			if (fraction == 1000000) {
+				fraction = 0;
+				++integer;
+			}
+
+			if (signbit(value)) {
+				write_char(b, '-');
+			}
+			write_uint(b, integer);
+			char digits[7];
+			digits[0] = '.';
+			for (int i = 6; i > 0; --i) {
+				digits[i] = '0' + fraction % 10;
+				fraction /= 10;
+			}
+			write_chars(b, digits, 7);
+			return;
+		}
+	}
+
+	char text[330]; // long enough for DBL_MAX written in full
+	int n = snprintf(text, sizeof(text), "%f", value);
+	write_chars(b, text, n);
+}
@@ -0,0 +1,108 @@
+#ifndef SIM_OUTPUT_H
+#define SIM_OUTPUT_H
+
+#include "sim-utils.h"
+
+/** A file being written through a large in-memory buffer, so that writing
+ * a table costs a memcpy or a few digit conversions per cell instead of a
+ * call into stdio or zlib. The buffer is handed to the file in large pieces.
+ * @see open_output_buffer()
+ *
+ * @param file the zlib handle of the open file. @see open_output_file()
+ * @param buffer heap buffer holding output not yet passed to `file`.
+ * @param capacity the size of `buffer`.
+ * @param length the number of characters waiting in `buffer`.
+ */
+typedef struct {
+	gzFile file;
+	char* buffer;
+	size_t capacity;
+	size_t length;
+} OutputBuffer;
+
+/* Opening and closing */
+OutputBuffer open_output_buffer(const char* filename, int compress);
+void flush_output_buffer(OutputBuffer* b);
+void close_output_buffer(OutputBuffer* b);
+size_t get_output_position(OutputBuffer* b);
+
+/* Writing */
+void write_past_output_buffer(OutputBuffer* b, const char* s, size_t n);
+void write_decimal(OutputBuffer* b, double value);
+
+/** Write some characters to an OutputBuffer.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param s the characters to write. Need not be null-terminated.
+ * @param n the number of characters to write.
+ */
+static inline void write_chars(OutputBuffer* b, const char* s, size_t n) {
+	if (n > b->capacity - b->length) {
+		write_past_output_buffer(b, s, n);
+		return;
+	}
+	memcpy(b->buffer + b->length, s, n);
+	b->length += n;
+}
+
+/** Write a null-terminated string, without its null byte, to an OutputBuffer.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param s the string to write.
+ */
+static inline void write_string(OutputBuffer* b, const char* s) {
+	write_chars(b, s, strlen(s));
+}
+
+/** Write one character to an OutputBuffer.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param c the character to write.
+ */
+static inline void write_char(OutputBuffer* b, char c) {
+	if (b->length == b->capacity) {
+		flush_output_buffer(b);
+	}
+	b->buffer[b->length] = c;
+	++b->length;
+}
+
+/** Write an unsigned integer in decimal to an OutputBuffer.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param value the integer to write.
+ */
+static inline void write_uint(OutputBuffer* b, uint64_t value) {
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n] = '0' + value % 10;
+		++n;
+		value /= 10;
+	} while (value > 0);
+
+	if (b->capacity - b->length < 20) {
+		flush_output_buffer(b);
+	}
+	while (n > 0) {
+		--n;
+		b->buffer[b->length] = digits[n];
+		++b->length;
+	}
+}
+
+/** Write a signed integer in decimal to an OutputBuffer, as printf's "%d" would.
+ *
+ * @param b pointer to the OutputBuffer to write to.
+ * @param value the integer to write.
+ */
+static inline void write_int(OutputBuffer* b, int64_t value) {
+	if (value < 0) {
+		write_char(b, '-');
+		write_uint(b, -(uint64_t) value);
+	} else {
+		write_uint(b, value);
+	}
+}
+
+#endif
@@ -1,5 +1,256 @@
 #include "sim-printers.h"
 
+/*-----------------------------Pedigree text cache---------------------------*/
+
+/** The cap on the length of any one pedigree text kept by a PedigreeCache. */
+#define PEDIGREE_TEXT_LIMIT (1 << 16)
+/** The cap on the total length of the pedigree texts kept by a PedigreeCache. */
+#define PEDIGREE_CACHE_LIMIT (1 << 28)
+
+/** Values of PedigreeCacheEntry.state */
+#define PEDIGREE_CACHED 1
+#define PEDIGREE_NOT_CACHED 2
+
+/** Create an empty PedigreeCache. Its table is only allocated when the 
+ * first id is added, so a cache that is never used costs nothing. Free it 
+ * with delete_pedigree_cache().
+ *
+ * @returns an empty PedigreeCache.
+ */
+PedigreeCache create_pedigree_cache() {
+	PedigreeCache c;
+	c.capacity = 0;
+	c.n_entries = 0;
+	c.entries = NULL;
+	c.total_length = 0;
+	return c;
+}
+
+/** Free the texts and table of a PedigreeCache, leaving it empty.
+ *
+ * @param c pointer to the PedigreeCache to delete.
+ */
+void delete_pedigree_cache(PedigreeCache* c) {
+	for (unsigned int i = 0; i < c->capacity; ++i) {
+		if (c->entries[i].id != 0 && c->entries[i].length > 0) {
+			free(c->entries[i].text);
+		}
+	}
+	free(c->entries);
+	*c = create_pedigree_cache();
+}
+
+/** Find the entry of an id in a PedigreeCache.
+ *
+ * Slots are chosen by a multiplicative hash of the id, so the runs of 
+ * consecutive ids a SimData hands out spread evenly over the table, and 
+ * collisions are resolved by probing the following slots.
+ *
+ * @param c pointer to the PedigreeCache to search.
+ * @param id the id to look for. Must not be 0.
+ * @returns pointer to the id's entry, or NULL if it has none. The pointer 
+ * is only valid until the next id is added.
+ */
+static PedigreeCacheEntry* find_in_pedigree_cache(PedigreeCache* c, unsigned int id) {
+	if (c->n_entries == 0) {
+		return NULL;
+	}
+	unsigned int mask = c->capacity - 1;
+	for (unsigned int i = (id * 2654435761u) & mask; c->entries[i].id != 0; i = (i + 1) & mask) {
+		if (c->entries[i].id == id) {
+			return c->entries + i;
+		}
+	}
+	return NULL;
+}
+
+/** Add an id that has no entry to a PedigreeCache, doubling the table 
+ * first if it would become more than half full.
+ *
+ * @param c pointer to the PedigreeCache to add to.
+ * @param id the id to add. Must not be 0.
+ * @param state PEDIGREE_CACHED or PEDIGREE_NOT_CACHED.
+ * @param text the id's text, which the cache now owns, or NULL if `length` is 0.
+ * @param length the length of `text`.
+ */
+static void add_to_pedigree_cache(PedigreeCache* c, unsigned int id, unsigned char state, 
+		char* text, unsigned int length) {
+	if (2 * (c->n_entries + 1) > c->capacity) {
+		PedigreeCache bigger = create_pedigree_cache();
+		bigger.capacity = (c->capacity > 0) ? 2 * c->capacity : 1024;
+		bigger.entries = get_malloc(sizeof(PedigreeCacheEntry) * bigger.capacity);
+		for (unsigned int i = 0; i < bigger.capacity; ++i) {
+			bigger.entries[i].id = 0;
+		}
+		for (unsigned int i = 0; i < c->capacity; ++i) {
+			PedigreeCacheEntry* e = c->entries + i;
+			if (e->id != 0) {
+				add_to_pedigree_cache(&bigger, e->id, e->state, e->text, e->length);
+			}
+		}
+		bigger.total_length = c->total_length;
+		free(c->entries);
+		*c = bigger;
+	}
+	
+	unsigned int mask = c->capacity - 1;
+	unsigned int i = (id * 2654435761u) & mask;
+	while (c->entries[i].id != 0) {
+		i = (i + 1) & mask;
+	}
+	c->entries[i].id = id;
+	c->entries[i].state = state;
+	c->entries[i].text = text;
+	c->entries[i].length = length;
+	++ c->n_entries;
+}
+
+/** Get the recursive pedigree text of an id, from the cache if it has been 
+ * built before, otherwise by building it from the texts of its parents.
+ *
+ * @param d pointer to the SimData containing the genotype and its ancestors.
+ * @param c pointer to the PedigreeCache to use.
+ * @param id the id of the genotype whose pedigree text is wanted. Must not be 0.
+ * @param length location to save the length of the text.
+ * @returns the text, which is not null-terminated, or NULL if the text is 
+ * too long to be cached. Do not free it.
+ */
+static const char* get_pedigree_text(SimData* d, PedigreeCache* c, unsigned int id, 
+		unsigned int* length) {
+	PedigreeCacheEntry* e = find_in_pedigree_cache(c, id);
+	if (e != NULL) {
+		if (e->state == PEDIGREE_NOT_CACHED) {
+			return NULL;
+		}
+		*length = e->length;
+		return (e->length > 0) ? e->text : "";
+	}
+	
+	unsigned int parents[2];
+	if (get_parents_of_id(d, id, parents) != 0) {
+		add_to_pedigree_cache(c, id, PEDIGREE_CACHED, NULL, 0);
+		*length = 0;
+		return "";
+	}
+	// a known parent paired with an unknown one is printed as if selfed
+	if (parents[0] == 0 || parents[1] == 0) {
+		parents[0] = (parents[0] >= parents[1]) ? parents[0] : parents[1];
+		parents[1] = parents[0];
+	}
+	int n_parents = (parents[0] == parents[1]) ? 1 : 2;
+	
+	const char* names[2];
+	char digits[2][12];
+	size_t name_lengths[2];
+	const char* texts[2];
+	unsigned int text_lengths[2];
+	size_t total = n_parents + 2; // "=(", ")" and a "," between two parents
+	for (int k = 0; k < n_parents; ++k) {
+		names[k] = get_name_of_id(d, parents[k]);
+		if (names[k] == NULL) {
+			snprintf(digits[k], sizeof(digits[k]), "%u", parents[k]);
+			names[k] = digits[k];
+		}
+		name_lengths[k] = strlen(names[k]);
+		// the texts are separate allocations, so adding entries does not move them
+		texts[k] = get_pedigree_text(d, c, parents[k], text_lengths + k);
+		if (texts[k] == NULL) {
+			add_to_pedigree_cache(c, id, PEDIGREE_NOT_CACHED, NULL, 0);
+			return NULL;
+		}
+		total += name_lengths[k] + text_lengths[k];
+	}
+	if (total > PEDIGREE_TEXT_LIMIT || c->total_length + total > PEDIGREE_CACHE_LIMIT) {
+		add_to_pedigree_cache(c, id, PEDIGREE_NOT_CACHED, NULL, 0);
+		return NULL;
+	}
+	
+	char* text = get_malloc(sizeof(char) * total);
+	size_t pos = 0;
+	text[pos++] = '=';
+	text[pos++] = '(';
+	for (int k = 0; k < n_parents; ++k) {
+		if (k > 0) {
+			text[pos++] = ',';
+		}
+		memcpy(text + pos, names[k], name_lengths[k]);
+		pos += name_lengths[k];
+		memcpy(text + pos, texts[k], text_lengths[k]);
+		pos += text_lengths[k];
+	}
+	text[pos++] = ')';
+	
+	add_to_pedigree_cache(c, id, PEDIGREE_CACHED, text, total);
+	c->total_length += total;
+	*length = total;
+	return text;
+}
+
+static void write_parents_of(OutputBuffer* f, SimData* d, PedigreeCache* c, 
+		unsigned int p1, unsigned int p2);
+
+/** Write the name (or id, if it has no name) of an ancestor followed by its 
+ * recursive pedigree text. @see save_parents_of()
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the ancestor.
+ * @param c pointer to the PedigreeCache to use.
+ * @param id the id of the ancestor.
+ */
+static void write_ancestor(OutputBuffer* f, SimData* d, PedigreeCache* c, unsigned int id) {
+	char* name = get_name_of_id( d, id);
+	if (name != NULL) {
+		write_string(f, name);
+	} else {
+		write_uint(f, id);
+	}
+	
+	unsigned int length;
+	const char* text = get_pedigree_text(d, c, id, &length);
+	if (text != NULL) {
+		write_chars(f, text, length);
+	} else {
+		unsigned int pedigree[2];
+		if (get_parents_of_id(d, id, pedigree) == 0) {
+			write_parents_of(f, d, c, pedigree[0], pedigree[1]);
+		}
+	}
+}
+
+/** Write the recursive pedigree of a pair of parents, taking each ancestor's 
+ * text from a PedigreeCache. @see save_parents_of()
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the parents and other 
+ * ancestry of the given id.
+ * @param c pointer to the PedigreeCache to use.
+ * @param p1 the id of the first parent, or 0 if unknown.
+ * @param p2 the id of the second parent, or 0 if unknown.
+ */
+static void write_parents_of(OutputBuffer* f, SimData* d, PedigreeCache* c, 
+		unsigned int p1, unsigned int p2) {
+	// open brackets
+	write_chars(f, "=(", 2);
+	
+	// enables us to print only the known parent if one is unknown
+	if (p1 == 0 || p2 == 0) {
+		p1 = (p1 >= p2) ? p1 : p2; //max of the two
+		p2 = p1;
+	}
+	
+	if (p1 > 0) { //print nothing if both are unknown.
+		write_ancestor(f, d, c, p1);
+		if (p1 != p2) {
+			// separator
+			write_char(f, ',');
+			write_ancestor(f, d, c, p2);
+		}
+	}
+
+	// close brackets
+	write_char(f, ')');
+}
+
 /*--------------------------------Printing-----------------------------------*/
 
 
@@ -19,54 +270,53 @@
  * If m->effects is NULL, m->ref_alleles is NULL, or m->genetic_map is NULL, 
  * then the relevant columns are omitted.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param m pointer to the SimData whose data we print
 */
-void save_simdata(FILE* f, SimData* m) {
+void save_simdata(OutputBuffer* f, SimData* m) {
 	/* Print the header. */
 	//fprintf(f, "name\t");
-	fwrite("name\t", sizeof(char), 5, f);
+	write_chars(f, "name\t", 5);
 	if (m->map.positions != NULL) {
 		//fprintf(f, "chr\tpos");
-		fwrite("chr\tpos", sizeof(char), 7, f);
+		write_chars(f, "chr\tpos", 7);
 	}
 	if (m->e.effect_names != NULL) {
 		for (int i = 0; i < m->e.effects.rows; i++) {
 			//fprintf(f, "\t%c", m->e.effect_names[i]);
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(m->e.effect_names + i, sizeof(char), 1, f);
+			write_char(f, '\t');
+			write_chars(f, m->e.effect_names + i, 1);
 		}
 	}
 	//fprintf(f, "\n");
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	/* Print the body. */
 	for (int j = 0; j < m->n_markers; j++) {
 		//fprintf(f, "%s\t", m->markers[j]);
-		fwrite(m->markers[j], sizeof(char) * strlen(m->markers[j]), 1, f);
-		fwrite("\t", sizeof(char), 1, f);
+		write_string(f, m->markers[j]);
+		write_char(f, '\t');
 		
 		if (m->map.positions != NULL) {
 			//fprintf(f, "%d\t%f", m->map.positions[j].chromosome, m->map.positions[j].position);
 			//fwrite(&(m->map.positions[j].chromosome), sizeof(m->map.positions[j].chromosome), 1, f);
-			fprintf(f, "%d", m->map.positions[j].chromosome);
-			fwrite("\t", sizeof(char), 1, f);
+			write_int(f, m->map.positions[j].chromosome);
+			write_char(f, '\t');
 			//fwrite(&(m->map.positions[j].position), sizeof(m->map.positions[j].position), 1, f);
-			fprintf(f, "%f", m->map.positions[j].position);
+			write_decimal(f, m->map.positions[j].position);
 		}
 		
 		if (m->e.effects.matrix != NULL) {
 			for (int i = 0; i < m->e.effects.rows; i++) {
 				//fprintf(f, "\t%lf", m->e.effects.matrix[i][j]);
-				fwrite("\t", sizeof(char), 1, f);
+				write_char(f, '\t');
 				//fwrite(m->e.effects.matrix[i] + j, sizeof(m->e.effects.matrix[i][j]), 1, f);
-				fprintf(f, "%f", m->e.effects.matrix[i][j]);
+				write_decimal(f, m->e.effects.matrix[i][j]);
 			}
 		}
 		//fprintf(f, "\n");
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
-	fflush(f);
 }
 
 /** Prints the markers contained in a set of blocks to a file. Column separators are tabs.
@@ -84,31 +334,30 @@ void save_simdata(FILE* f, SimData* m) {
  * where m1, m2, m3, m4 are the names of the markers in the first block and 
  * m7 and m9 are the names of the markers in the second block.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData whose data we print
  * @param b MarkerBlocks struct containing the groupings of markers to print.
 */
-void save_marker_blocks(FILE* f, SimData* d, MarkerBlocks b) {
+void save_marker_blocks(OutputBuffer* f, SimData* d, MarkerBlocks b) {
 	const char header[] = "Chrom\tPos\tName\tClass\tMarkers\n";
-	fwrite(header, sizeof(char)*strlen(header), 1, f);
+	write_string(f, header);
 	
 	// for the moment we do not name or give locations of different blocks
 	const char unspecified[] = "0\t0\tb0\tb\t";
 	const int unspeci_length = strlen(unspecified);
 	
 	for (int i = 0; i < b.num_blocks; ++i) {
-		fwrite(unspecified, sizeof(char)*unspeci_length, 1, f);
+		write_chars(f, unspecified, unspeci_length);
 		
 		for (int j = 0; j < b.num_markers_in_block[i]; ++j) {
 			int k = b.markers_in_block[i][j];
 			
-			fwrite(d->markers[k], sizeof(char)*strlen(d->markers[k]), 1, f);
+			write_string(f, d->markers[k]);
 		}
 		
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
 	
-	fflush(f);
 	return;
 	
 }
@@ -127,47 +376,49 @@ void save_marker_blocks(FILE* f, SimData* d, MarkerBlocks b) {
  *
  * Subject id will be printed if the genotype does not have a name saved
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param m pointer to the AlleleMatrix whose data we print
- * @param markers array of strings that correspond to names of the markers.
- * if this is null, the header row will be empty.
+ * @param d pointer to the SimData to which `m` belongs. Its `markers` array 
+ * supplies the names of the markers; if this is null, the header row will be empty.
 */
-void save_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
+void save_allele_matrix(OutputBuffer* f, AlleleMatrix* m, SimData* d) {
+	char** markers = d->markers;
+	char pair[2];
 	/* Print header */
 	for (int i = 0; i < m->n_markers; ++i) {
 		if (markers != NULL) { // assume all-or-nothing with marker names
 			//fprintf(f, "\t%s", markers[i]);
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(markers[i], sizeof(char), strlen(markers[i]), f);
+			write_char(f, '\t');
+			write_string(f, markers[i]);
 		}
 	}
 	//fprintf(f, "\n");
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	do {
 		/* Print the body */
 		for (int i = 0; i < m->n_subjects; ++i) {
 			// print the name or ID of the individual.
 			if (m->subject_names[i] != NULL) {
-				fwrite(m->subject_names[i], sizeof(char), strlen(m->subject_names[i]), f);
+				write_string(f, m->subject_names[i]);
 			} else {
 				//fwrite(group_contents + i, sizeof(int), 1, f);
-				fprintf(f, "%d", m->ids[i]);
+				write_uint(f, m->ids[i]);
 			}
 
 			
 			for (int j = 0; j < m->n_markers; ++j) {
 				//fprintf(f, "\t%c%c", m->alleles[j][2*i], m->alleles[j][2*i + 1]);
-				fwrite("\t", sizeof(char), 1, f);
-				fwrite(m->alleles[i] + 2*j, sizeof(char), 1, f);
-				fwrite(m->alleles[i] + 2*j + 1, sizeof(char), 1, f);
+				write_char(f, '\t');
+				pair[0] = get_allele(d, m->alleles[i], j, 0);
+				pair[1] = get_allele(d, m->alleles[i], j, 1);
+				write_chars(f, pair, 2);
 			}
 			///fprintf(f, "\n");
-			fwrite("\n", sizeof(char), 1, f);
+			write_char(f, '\n');
 		}
 	} while ((m = m->next) != NULL);
 	
-	fflush(f);
 	
 }
 
@@ -184,11 +435,14 @@ void save_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
  *
  * Subject id will be printed if the genotype does not have a name saved
  * 
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param m pointer to the AlleleMatrix whose data we print
- * @param markers array of strings that correspond to names of the markers.
+ * @param d pointer to the SimData to which `m` belongs. Its `markers` array 
+ * supplies the names of the markers.
 */
-void save_transposed_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
+void save_transposed_allele_matrix(OutputBuffer* f, AlleleMatrix* m, SimData* d) {
+	char** markers = d->markers;
+	char pair[2];
 	// Count number of genotypes in the AM
 	AlleleMatrix* currentm = m; // current matrix
 	int tn_subjects = 0;
@@ -206,19 +460,19 @@ void save_transposed_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
 		}
 		if (currentm->subject_names[currenti] != NULL) { // assume all-or-nothing with marker names
 			//fprintf(f, "\t%s", markers[i]);
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(currentm->subject_names[currenti], sizeof(char), strlen(currentm->subject_names[currenti]), f);
+			write_char(f, '\t');
+			write_string(f, currentm->subject_names[currenti]);
 		} else {
-			fprintf(f, "%d", currentm->ids[currenti]);
+			write_uint(f, currentm->ids[currenti]);
 		}
 		
 	}
 	//fprintf(f, "\n");
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	for (int j = 0; j < m->n_markers; ++j) {
 		if (markers != NULL && markers[j] != NULL) {
-			fwrite(markers[j], sizeof(char), strlen(markers[j]), f);
+			write_string(f, markers[j]);
 		}
 		
 		currentm = m;
@@ -229,15 +483,14 @@ void save_transposed_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
 				currentm = currentm->next;
 			}
 			
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(currentm->alleles[currenti] + 2*j, sizeof(char), 1, f);
-			fwrite(currentm->alleles[currenti] + 2*j + 1, sizeof(char), 1, f);
+			write_char(f, '\t');
+			pair[0] = get_allele(d, currentm->alleles[currenti], j, 0);
+			pair[1] = get_allele(d, currentm->alleles[currenti], j, 1);
+			write_chars(f, pair, 2);
 		}
 		
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
-	
-	fflush(f);
 }
 
 /** Prints the genotypes of each individual in a given group to a file, with
@@ -253,55 +506,56 @@ void save_transposed_allele_matrix(FILE* f, AlleleMatrix* m, char** markers) {
  *
  * Subject id will be printed if the genotype does not have a name saved
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the genotypes of the group and
  * the marker names.
  * @param group_id group number of the group of individuals whose genotypes to print.
 */
-void save_group_alleles(FILE* f, SimData* d, int group_id) {
+void save_group_alleles(OutputBuffer* f, SimData* d, int group_id) {
 	/* Get the stuff we'll be printing. */
 	int group_size = get_group_size( d, group_id);
 	char** alleles = get_group_genes( d, group_id, group_size);
 	char** names = get_group_names( d, group_id, group_size);
 	unsigned int* ids = get_group_ids( d, group_id, group_size);
+	char pair[2];
 	
 	/* Print header */
 	//fwrite(&group_id, sizeof(int), 1, f);
-	fprintf(f, "%d", group_id);
+	write_int(f, group_id);
 	if (d->markers != NULL) { 
 		for (int i = 0; i < d->n_markers; ++i) {
 			// assume all-or-nothing with marker names
 			//fprintf(f, "\t%s", markers[i]);
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(d->markers[i], sizeof(char), strlen(d->markers[i]), f);
+			write_char(f, '\t');
+			write_string(f, d->markers[i]);
 		}
 	}
 	//fprintf(f, "\n");
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	/* Print the body */
 	for (int i = 0; i < group_size; ++i) {
 		// print the name or ID of the individual.
 		if (names[i] != NULL) {
-			fwrite(names[i], sizeof(char), strlen(names[i]), f);
+			write_string(f, names[i]);
 		} else {
 			//fwrite(group_contents + i, sizeof(int), 1, f);
-			fprintf(f, "%d", ids[i]);
+			write_uint(f, ids[i]);
 		}
 		
 		for (int j = 0; j < d->n_markers; ++j) {
 			//fprintf(f, "\t%c%c", m->alleles[j][2*i], m->alleles[j][2*i + 1]);
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(alleles[i] + 2*j, sizeof(char), 1, f);
-			fwrite(alleles[i] + 2*j + 1, sizeof(char), 1, f);
+			write_char(f, '\t');
+			pair[0] = get_allele(d, alleles[i], j, 0);
+			pair[1] = get_allele(d, alleles[i], j, 1);
+			write_chars(f, pair, 2);
 		}
 		///fprintf(f, "\n");
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
 	free(alleles);
 	free(names);
 	free(ids);
-	fflush(f);
 	
 }
 
@@ -318,46 +572,47 @@ void save_group_alleles(FILE* f, SimData* d, int group_id) {
  *
  * Subject id will be printed if the genotype does not have a name saved
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the genotypes of the group and
  * the marker names.
  * @param group_id group number of the group of individuals whose genotypes to print.
 */
-void save_transposed_group_alleles(FILE* f, SimData* d, int group_id) {
+void save_transposed_group_alleles(OutputBuffer* f, SimData* d, int group_id) {
 	/* Get the stuff we'll be printing. */
 	int group_size = get_group_size( d, group_id);
 	char** alleles = get_group_genes( d, group_id, group_size);
 	char** names = get_group_names( d, group_id, group_size);
 	unsigned int* ids = get_group_ids( d, group_id, group_size);
+	char pair[2];
 	
 	/* Print header */
-	fprintf(f, "%d", group_id);
+	write_int(f, group_id);
 	for (int i = 0; i < group_size; ++i) {
-		fwrite("\t", sizeof(char), 1, f);
-		fwrite(names[i], sizeof(char), strlen(names[i]), f);
+		write_char(f, '\t');
+		write_string(f, names[i]);
 	}
 	//fprintf(f, "\n");
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	/* Print the body */
 	for (int i = 0; i < d->n_markers; ++i) {
 		// print the name or ID of the individual.
 		if (d->markers != NULL && d->markers[i] != NULL) {
-			fwrite(d->markers[i], sizeof(char), strlen(d->markers[i]), f);
+			write_string(f, d->markers[i]);
 		}
 		
 		for (int j = 0; j < group_size; ++j) {
-			fwrite("\t", sizeof(char), 1, f);
-			fwrite(alleles[j] + 2*i, sizeof(char), 1, f);
-			fwrite(alleles[j] + 2*i + 1, sizeof(char), 1, f);
+			write_char(f, '\t');
+			pair[0] = get_allele(d, alleles[j], i, 0);
+			pair[1] = get_allele(d, alleles[j], i, 1);
+			write_chars(f, pair, 2);
 		}
 		///fprintf(f, "\n");
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
 	free(alleles);
 	free(names);
 	free(ids);
-	fflush(f);
 	
 }
 
@@ -379,12 +634,12 @@ void save_transposed_group_alleles(FILE* f, SimData* d, int group_id) {
  * id of an individual is 0 (which means the parent is unknown) no
  * name or id is printed for that parent.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  * @param group group number of the group of individuals to print the 
  * immediate parents of.
  */
-void save_group_one_step_pedigree(FILE* f, SimData* d, int group) {
+void save_group_one_step_pedigree(OutputBuffer* f, SimData* d, int group) {
 	int group_size = get_group_size( d, group);
 	unsigned int* group_contents = get_group_ids( d, group, group_size);
 	char** group_names = get_group_names( d, group, group_size);
@@ -394,39 +649,38 @@ void save_group_one_step_pedigree(FILE* f, SimData* d, int group) {
 	for (int i = 0; i < group_size; i++) {
 		/*Group member name*/
 		if (group_names[i] != NULL) {
-			fwrite(group_names[i], sizeof(char), strlen(group_names[i]), f);
+			write_string(f, group_names[i]);
 		} else {
 			//fwrite(group_contents + i, sizeof(int), 1, f);
-			fprintf(f, "%d", group_contents[i]);
+			write_uint(f, group_contents[i]);
 		}
-		fwrite("\t", sizeof(char), 1, f);
+		write_char(f, '\t');
 		
-		if (get_parents_of_id( d->m, group_contents[i], pedigree) == 0) {
+		if (get_parents_of_id( d, group_contents[i], pedigree) == 0) {
 			// Prints both parents, even if they're the same one.
 			/* Parent 1 */
-			name = get_name_of_id( d->m, pedigree[0]);
+			name = get_name_of_id( d, pedigree[0]);
 			if (name != NULL) {
-				fwrite(name, sizeof(char), strlen(name), f);
+				write_string(f, name);
 			} else if (pedigree[0] > 0) {
 				//fwrite(pedigree, sizeof(int), 1, f);
-				fprintf(f, "%d", pedigree[0]);
+				write_uint(f, pedigree[0]);
 			}
-			fwrite("\t", sizeof(char), 1, f);
+			write_char(f, '\t');
 			
 			/* Parent 2 */
-			name = get_name_of_id( d->m, pedigree[1]);
+			name = get_name_of_id( d, pedigree[1]);
 			if (name != NULL) {
-				fwrite(name, sizeof(char), strlen(name), f);
+				write_string(f, name);
 			} else if (pedigree[1] > 0) {
-				fprintf(f, "%d", pedigree[1]);
+				write_uint(f, pedigree[1]);
 				//fwrite(pedigree + 1, sizeof(int), 1, f);
 			}
 		}
-		fwrite("\n", sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
 	free(group_names);
 	free(group_contents);
-	fflush(f);
 }
 
 /** Print the parents of each genotype in the SimData to a file. The following
@@ -446,10 +700,10 @@ void save_group_one_step_pedigree(FILE* f, SimData* d, int group) {
  * id is 0 (which means the parent is unknown) no
  * name or id is printed for that parent.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the genotypes and their pedigrees
  */
-void save_one_step_pedigree(FILE* f, SimData* d) {
+void save_one_step_pedigree(OutputBuffer* f, SimData* d) {
 	unsigned int pedigree[2];
 	char* name;
 	AlleleMatrix* m = d->m;
@@ -458,38 +712,37 @@ void save_one_step_pedigree(FILE* f, SimData* d) {
 		for (int i = 0; i < m->n_subjects; ++i) {
 			/*Group member name*/
 			if (m->subject_names[i] != NULL) {
-				fwrite(m->subject_names[i], sizeof(char), strlen(m->subject_names[i]), f);
+				write_string(f, m->subject_names[i]);
 			} else {
-				fprintf(f, "%d", m->ids[i]);
+				write_uint(f, m->ids[i]);
 			}
-			fwrite("\t", sizeof(char), 1, f);
+			write_char(f, '\t');
 			
-			if (get_parents_of_id( d->m, m->ids[i], pedigree) == 0) {
+			if (get_parents_of_id( d, m->ids[i], pedigree) == 0) {
 				// Even if both parents are the same, print them both. 
 				/* Parent 1 */
-				name = get_name_of_id( d->m, pedigree[0]);
+				name = get_name_of_id( d, pedigree[0]);
 				if (name != NULL) {
-					fwrite(name, sizeof(char), strlen(name), f);
+					write_string(f, name);
 				} else if (pedigree[0] > 0) {
 					//fwrite(pedigree, sizeof(int), 1, f);
-					fprintf(f, "%d", pedigree[0]);
+					write_uint(f, pedigree[0]);
 				}
-				fwrite("\t", sizeof(char), 1, f);
+				write_char(f, '\t');
 				
 				/* Parent 2 */
-				name = get_name_of_id( d->m, pedigree[1]);
+				name = get_name_of_id( d, pedigree[1]);
 				if (name != NULL) {
-					fwrite(name, sizeof(char), strlen(name), f);
+					write_string(f, name);
 				} else if (pedigree[1] > 0) {
-					fprintf(f, "%d", pedigree[1]);
+					write_uint(f, pedigree[1]);
 					//fwrite(pedigree + 1, sizeof(int), 1, f);
 				}
 				
 			}
-			fwrite("\n", sizeof(char), 1, f);
+			write_char(f, '\n');
 		}
 	} while ((m = m->next) != NULL);
-	fflush(f);
 }
 
 /** Print the full known pedigree of each genotype in a group to a file. The following
@@ -516,33 +769,34 @@ void save_one_step_pedigree(FILE* f, SimData* d) {
  * id of an individual is 0, the individual is printed without brackets or 
  * parent pedigrees and recursion stops here.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  * @param group group number of the group of individuals to print the 
  * pedigree of.
  */
-void save_group_full_pedigree(FILE* f, SimData* d, int group) {
+void save_group_full_pedigree(OutputBuffer* f, SimData* d, int group) {
 	int group_size = get_group_size( d, group);
 	unsigned int* group_contents = get_group_ids( d, group, group_size);
 	char** group_names = get_group_names( d, group, group_size);
-	const char newline[] = "\n";
 	unsigned int pedigree[2];
+	PedigreeCache cache = create_pedigree_cache();
 	
 	for (int i = 0; i < group_size; i++) {
 		/*Group member name*/
-		fprintf(f, "%d\t", group_contents[i]);
+		write_uint(f, group_contents[i]);
+		write_char(f, '\t');
 		if (group_names[i] != NULL) {
-			fwrite(group_names[i], sizeof(char), strlen(group_names[i]), f);
+			write_string(f, group_names[i]);
 		}
 		
-		if (get_parents_of_id(d->m, group_contents[i], pedigree) == 0) {
-			save_parents_of(f, d->m, pedigree[0], pedigree[1]);
+		if (get_parents_of_id(d, group_contents[i], pedigree) == 0) {
+			write_parents_of(f, d, &cache, pedigree[0], pedigree[1]);
 		}
-		fwrite(newline, sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
+	delete_pedigree_cache(&cache);
 	free(group_names);
 	free(group_contents);
-	fflush(f);	
 }
 
 /** Print the full known pedigree of each genotype in the SimData 
@@ -570,29 +824,29 @@ void save_group_full_pedigree(FILE* f, SimData* d, int group) {
  * id of an individual is 0, the individual is printed without brackets or 
  * parent pedigrees and recursion stops here.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing all genotypes to print.
  */
-void save_full_pedigree(FILE* f, SimData* d) {
-	const char newline[] = "\n";
-	
+void save_full_pedigree(OutputBuffer* f, SimData* d) {
 	AlleleMatrix* m = d->m;
+	PedigreeCache cache = create_pedigree_cache();
 	
 	do {
 		for (int i = 0; i < m->n_subjects; ++i) {
 			/*Group member name*/
-			fprintf(f, "%d\t", m->ids[i]);
+			write_uint(f, m->ids[i]);
+			write_char(f, '\t');
 			if (m->subject_names[i] != NULL) {
-				fwrite(m->subject_names[i], sizeof(char), strlen(m->subject_names[i]), f);
+				write_string(f, m->subject_names[i]);
 			}
 			
 			if (m->pedigrees[0][i] != 0 || m->pedigrees[1][i] != 0) {
-				save_parents_of(f, d->m, m->pedigrees[0][i], m->pedigrees[1][i]);
+				write_parents_of(f, d, &cache, m->pedigrees[0][i], m->pedigrees[1][i]);
 			}
-			fwrite(newline, sizeof(char), 1, f);
+			write_char(f, '\n');
 		}
 	} while ((m = m->next) != NULL);
-	fflush(f);
+	delete_pedigree_cache(&cache);
 }
 
 /** Print the full known pedigree of each genotype in a single AlleleMatrix 
@@ -622,27 +876,31 @@ void save_full_pedigree(FILE* f, SimData* d) {
  *
  * Note this does not follow through the linked list of AlleleMatrix. 
  *
- * @param f file pointer opened for writing to put the output
+ * A function that saves the pedigrees of several AlleleMatrix in turn (like
+ * the crossing functions do) should pass the same cache to every call, so that
+ * the ancestors the matrices share are only expanded once.
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param m pointer to the AlleleMatrix containing the genotypes to print
  * @param parents pointer to an AlleleMatrix that heads the linked list
  * containing the parents and other ancestry of the given genotypes.
+ * @param cache pointer to a PedigreeCache from create_pedigree_cache() in 
+ * which to keep the expanded pedigrees of ancestors. The caller deletes it.
  */
-void save_AM_pedigree(FILE* f, AlleleMatrix* m, SimData* parents) {
-	const char newline[] = "\n";
-
+void save_AM_pedigree(OutputBuffer* f, AlleleMatrix* m, SimData* parents, PedigreeCache* cache) {
 	for (int i = 0; i < m->n_subjects; ++i) {
 		/*Group member name*/
-		fprintf(f, "%d\t", m->ids[i]);
+		write_uint(f, m->ids[i]);
+		write_char(f, '\t');
 		if (m->subject_names[i] != NULL) {
-			fwrite(m->subject_names[i], sizeof(char), strlen(m->subject_names[i]), f);
+			write_string(f, m->subject_names[i]);
 		}
 		
         if (m->pedigrees[0][i] != 0 || m->pedigrees[1][i] != 0) {
-            save_parents_of(f, parents->m, m->pedigrees[0][i], m->pedigrees[1][i]);
+            write_parents_of(f, parents, cache, m->pedigrees[0][i], m->pedigrees[1][i]);
         }
-		fwrite(newline, sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
-	fflush(f);
 }
 
 /** Recursively save the parents of a particular id to a file.
@@ -661,73 +919,152 @@ void save_AM_pedigree(FILE* f, AlleleMatrix* m, SimData* parents) {
  * ids if they does not have names, each name immediately followed by whatever
  * is printed by a call to this function on the corresponding parent's id.
  *
- * @param f file pointer opened for writing to put the output
- * @param m pointer to an AlleleMatrix that heads the linked list
- * containing the parents and other ancestry of the given id.
- * @param id the session-unique id of the genotype whose parents 
- * we wish to recursively save.
+ * To save the pedigrees of many genotypes, use save_full_pedigree() or similar,
+ * which share the expanded pedigree of each ancestor between all of the genotypes
+ * it appears in.
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the parents and other 
+ * ancestry of the given id.
+ * @param p1 the id of the first parent, or 0 if unknown.
+ * @param p2 the id of the second parent, or 0 if unknown.
  */
-void save_parents_of(FILE* f, AlleleMatrix* m, unsigned int p1, unsigned int p2) {
-	unsigned int pedigree[2];
-	
-	// open brackets
-	fwrite("=(", sizeof(char), 2, f);
-	char* name;
-	
-	// enables us to print only the known parent if one is unknown
-	if (p1 == 0 || p2 == 0) {
-		p1 = (p1 >= p2) ? p1 : p2; //max of the two
-		p2 = p1;
+void save_parents_of(OutputBuffer* f, SimData* d, unsigned int p1, unsigned int p2) {
+	PedigreeCache c = create_pedigree_cache();
+	write_parents_of(f, d, &c, p1, p2);
+	delete_pedigree_cache(&c);
+}
+
+/** Check whether a genotype belongs in a binary pedigree file. 
+ *
+ * Genotypes without ids are left out, as an id of 0 marks an unknown parent.
+ * So are genotypes generated without ids of their own (will_allocate_ids FALSE),
+ * whose ids belong to other genotypes and would attach the wrong parents to
+ * those ids when the file is loaded.
+ *
+ * @param d pointer to the SimData containing the genotype.
+ * @param m pointer to the AlleleMatrix containing the genotype.
+ * @param i the index of the genotype in `m`.
+ * @param group group number of the genotypes being saved, or -1 for all.
+ * @returns TRUE if the genotype's record should be saved, FALSE otherwise.
+ */
+static int is_in_binary_pedigree(const SimData* d, const AlleleMatrix* m, int i, int group) {
+	if (m->ids[i] == 0 || (group >= 0 && m->groups[i] != (unsigned int) group)) {
+		return FALSE;
 	}
+	IdLocation loc = get_location_of_id(d, m->ids[i]);
+	return loc.block == m && loc.slot == i;
+}
+
+/** Write the pedigree records of the genotypes that belong in a binary pedigree 
+ * file. @see save_binary_pedigree()
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the genotypes and their pedigrees
+ * @param group group number of the genotypes to save, or -1 to save every 
+ * genotype followed by the recorded pedigrees of deleted genotypes.
+ */
+static void write_binary_pedigree(OutputBuffer* f, SimData* d, int group) {
+	PedigreeTable* t = &(d->deleted_pedigrees);
+	unsigned int deleted_capacity = (group < 0) ? t->capacity : 0;
 	
-	if (p1 == p2) {
-		if (p1 > 0) { //print nothing if both are unknown.
-			// Selfed parent
-			name = get_name_of_id( m, p1);
-			if (name != NULL) {
-				fwrite(name, sizeof(char), strlen(name), f);
-			} else if (p1 > 0) {
-				fprintf(f, "%d", p1);
-				//fwrite(pedigree, sizeof(int), 1, f);
-			}
-			
-			if (get_parents_of_id(m, p1, pedigree) == 0) {
-				save_parents_of(f, m, pedigree[0], pedigree[1]);
+	/* Header */
+	uint32_t n_records = 0;
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		for (int i = 0; i < m->n_subjects; ++i) {
+			if (is_in_binary_pedigree(d, m, i, group)) {
+				++n_records;
 			}
 		}
-	} else {
-		// Parent 1
-		name = get_name_of_id( m, p1);
-		if (name != NULL) {
-			fwrite(name, sizeof(char), strlen(name), f);
-		} else if (p1 > 0) {
-			fprintf(f, "%d", p1);
-			//fwrite(pedigree, sizeof(int), 1, f);
+	}
+	for (unsigned int id = 1; id < deleted_capacity; ++id) {
+		if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+			++n_records;
 		}
-		if (get_parents_of_id(m, p1, pedigree) == 0) {
-			save_parents_of(f, m, pedigree[0], pedigree[1]);
+	}
+	int32_t header[2] = { PEDIGREE_FORMAT_VERSION, 0x01020304 };
+	write_chars(f, PEDIGREE_MAGIC, 8);
+	write_chars(f, (const char*) header, sizeof(header));
+	write_chars(f, (const char*) &n_records, sizeof(uint32_t));
+	
+	/* (id, parent 1, parent 2) triples */
+	uint32_t record[3];
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		for (int i = 0; i < m->n_subjects; ++i) {
+			if (is_in_binary_pedigree(d, m, i, group)) {
+				record[0] = m->ids[i];
+				record[1] = m->pedigrees[0][i];
+				record[2] = m->pedigrees[1][i];
+				write_chars(f, (const char*) record, sizeof(record));
+			}
 		}
-		
-		// separator
-		fwrite(",", sizeof(char), 1, f);
-		
-		// Parent 2
-		name = get_name_of_id( m, p2);
-		if (name != NULL) {
-			fwrite(name, sizeof(char), strlen(name), f);
-		} else if (p2 > 0) {
-			fprintf(f, "%d", p2);
-			//fwrite(pedigree + 1, sizeof(int), 1, f);
+	}
+	for (unsigned int id = 1; id < deleted_capacity; ++id) {
+		if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+			record[0] = id;
+			record[1] = t->parents[0][id];
+			record[2] = t->parents[1][id];
+			write_chars(f, (const char*) record, sizeof(record));
 		}
-		
-		if (get_parents_of_id(m, p2, pedigree) == 0) {
-			save_parents_of(f, m, pedigree[0], pedigree[1]);
+	}
+	
+	/* Name table */
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		for (int i = 0; i < m->n_subjects; ++i) {
+			if (is_in_binary_pedigree(d, m, i, group)) {
+				if (m->subject_names[i] != NULL) {
+					write_string(f, m->subject_names[i]);
+				}
+				write_char(f, '\0');
+			}
+		}
+	}
+	for (unsigned int id = 1; id < deleted_capacity; ++id) {
+		if (t->name_offsets[id] == PEDIGREE_UNNAMED) {
+			write_char(f, '\0');
+		} else if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+			write_chars(f, t->names + t->name_offsets[id], strlen(t->names + t->name_offsets[id]) + 1);
 		}
-		
 	}
+}
 
-	// close brackets
-	fwrite(")", sizeof(char), 1, f);
+/** Save the parents of each genotype in a group to a binary file, for 
+ * tools that read pedigrees without parsing text. The file can be loaded 
+ * again with load_binary_pedigree_to_simdata(). @see save_binary_pedigree()
+ * for the format.
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the genotypes and their pedigrees
+ * @param group group number of the group of individuals to save the pedigrees of.
+ */
+void save_group_binary_pedigree(OutputBuffer* f, SimData* d, int group) {
+	write_binary_pedigree(f, d, group);
+}
+
+/** Save the parents of every genotype in the SimData, and of every deleted 
+ * genotype whose pedigree was kept, to a binary file, for tools that read 
+ * pedigrees without parsing text. The file can be loaded again with 
+ * load_binary_pedigree_to_simdata().
+ *
+ * All values are written in the native byte order of the machine. The layout
+ * (version 1) is:
+ *
+ * - the 8 characters `PEDIGREE_MAGIC`, then the 32-bit integers 
+ * `PEDIGREE_FORMAT_VERSION` and the byte order check 0x01020304, then the 
+ * number n of records as an unsigned 32-bit integer.
+ * - n records of three unsigned 32-bit integers each: the genotype's id, then
+ * the ids of its first and second parents (0 if unknown).
+ * - the name of each of the n genotypes, in the same order, each followed by
+ * a null byte. A genotype with no name has an empty name.
+ *
+ * Genotypes without ids are not saved, as an id of 0 marks an unknown parent,
+ * and neither are genotypes generated without ids of their own.
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData containing the genotypes and their pedigrees
+ */
+void save_binary_pedigree(OutputBuffer* f, SimData* d) {
+	write_binary_pedigree(f, d, -1);
 }
 
 
@@ -742,36 +1079,33 @@ void save_parents_of(FILE* f, AlleleMatrix* m, unsigned int p1, unsigned int p2)
  *
  * The SimData must have loaded marker effects for this function to succeed.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  * @param group group number of the group of individuals to print the 
  * GEBVs of.
  */
-void save_group_fitness(FILE* f, SimData* d, int group) {
+void save_group_fitness(OutputBuffer* f, SimData* d, int group) {
 	int group_size = get_group_size( d, group);
 	unsigned int* group_contents = get_group_ids( d, group, group_size);
 	char** group_names = get_group_names( d, group, group_size);
 	DecimalMatrix effects = calculate_fitness_metric_of_group(d, group);
-	const char newline[] = "\n";
-	const char tab[] = "\t";
 	
 	for (int i = 0; i < group_size; ++i) {
 		/*Group member name*/
 		//fwrite(group_contents + i, sizeof(int), 1, f);
-		fprintf(f, "%d", group_contents[i]);
-		fwrite(tab, sizeof(char), 1, f);
+		write_uint(f, group_contents[i]);
+		write_char(f, '\t');
 		if (group_names[i] != NULL) {
-			fwrite(group_names[i], sizeof(char), strlen(group_names[i]), f);
+			write_string(f, group_names[i]);
 		}
-		fwrite(tab, sizeof(char), 1, f);
+		write_char(f, '\t');
 		//fwrite(effects.matrix[0], sizeof(float), 1, f);
-		fprintf(f, "%f", effects.matrix[0][i]);
-		fwrite(newline, sizeof(char), 1, f);
+		write_decimal(f, effects.matrix[0][i]);
+		write_char(f, '\n');
 	}
 	delete_dmatrix(&effects);
 	free(group_names);
 	free(group_contents);
-	fflush(f);	
 }
 
 /** Print the GEBV of each genotype in the SimData to a file. The following
@@ -785,33 +1119,30 @@ void save_group_fitness(FILE* f, SimData* d, int group) {
  *
  * The SimData must have loaded marker effects for this function to succeed.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  */
-void save_all_fitness(FILE* f, SimData* d) {
+void save_all_fitness(OutputBuffer* f, SimData* d) {
 	AlleleMatrix* am = d->m;
-	const char newline[] = "\n";
-	const char tab[] = "\t";
 	DecimalMatrix effects;
 	
 	do {
-		effects = calculate_fitness_metric(am, &(d->e));
+		effects = calculate_fitness_metric(d, am);
 		for (int i = 0; i < effects.cols; ++i) {
 			/*Group member name*/
 			//fwrite(group_contents + i, sizeof(int), 1, f);
-			fprintf(f, "%d", am->ids[i]);
-			fwrite(tab, sizeof(char), 1, f);
+			write_uint(f, am->ids[i]);
+			write_char(f, '\t');
 			if (am->subject_names[i] != NULL) {
-				fwrite(am->subject_names[i], sizeof(char), strlen(am->subject_names[i]), f);
+				write_string(f, am->subject_names[i]);
 			}
-			fwrite(tab, sizeof(char), 1, f);
+			write_char(f, '\t');
 			//fwrite(effects.matrix[0], sizeof(float), 1, f);
-			fprintf(f, "%f", effects.matrix[0][i]);
-			fwrite(newline, sizeof(char), 1, f);
+			write_decimal(f, effects.matrix[0][i]);
+			write_char(f, '\n');
 		}
 		delete_dmatrix(&effects);
 	} while ((am = am->next) != NULL);
-	fflush(f);
 }
 
 /** Print a set of pre-calculated GEBVs with provided names and ids to a file,
@@ -828,30 +1159,26 @@ void save_all_fitness(FILE* f, SimData* d) {
  * DecimalMatrix are ordered the same, so a single index produces the corresponding
  * value from each.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param e pointer to the DecimalMatrix containing the GEBVs in the first row.
  * @param ids array of ids to print alongside the GEBVs.
  * @param names array of names to print alongside the GEBVs.
  */
-void save_fitness(FILE* f, DecimalMatrix* e, unsigned int* ids, char** names) {
-	char sep[] = "\t";
-	char newline[] = "\n";
-
+void save_fitness(OutputBuffer* f, DecimalMatrix* e, unsigned int* ids, char** names) {
 	for (int i = 0; i < e->cols; ++i) {
 		//fwrite(ids + i, sizeof(int), 1, f);
-		fprintf(f, "%d", ids[i]);
-		fwrite(sep, sizeof(char), 1, f);
+		write_uint(f, ids[i]);
+		write_char(f, '\t');
 		if (names != NULL && names[i] != NULL) {
-			fwrite(names[i], sizeof(char), strlen(names[i]), f);
+			write_string(f, names[i]);
 		}
-		fwrite(sep, sizeof(char), 1, f);
+		write_char(f, '\t');
 		//fwrite(e->matrix[i], sizeof(double), 1, f);
-		fprintf(f, "%f", e->matrix[0][i]);
+		write_decimal(f, e->matrix[0][i]);
 		
 		//print the newline
-		fwrite(newline, sizeof(char), 1, f);
+		write_char(f, '\n');
 	}
-	fflush(f);
 }
 
 /** Print the number of copies of a particular allele at each marker of each genotype 
@@ -867,12 +1194,12 @@ void save_fitness(FILE* f, DecimalMatrix* e, unsigned int* ids, char** names) {
  *
  * Subject id will be printed if the genotype does not have a name saved.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  * @param allele the allele character to count
  */
-void save_count_matrix(FILE* f, SimData* d, char allele) {
-	DecimalMatrix counts = calculate_full_count_matrix_of_allele(d->m, allele);
+void save_count_matrix(OutputBuffer* f, SimData* d, char allele) {
+	DecimalMatrix counts = calculate_full_count_matrix_of_allele(d, d->m, allele);
 	
 	AlleleMatrix* currentm = d->m;
 	// print the header
@@ -881,33 +1208,33 @@ void save_count_matrix(FILE* f, SimData* d, char allele) {
 			currenti = 0;
 			currentm = currentm->next;
 		}
-		fwrite("\t", sizeof(char), 1, f);
+		write_char(f, '\t');
 		if (currentm->subject_names[currenti] != NULL) {
-			fwrite(currentm->subject_names[currenti], sizeof(char), strlen(currentm->subject_names[currenti]), f);
+			write_string(f, currentm->subject_names[currenti]);
 		}
 	}
 	
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	// Print the body
 	for (int i = 0; i < d->n_markers; ++i) { // loop through markers
 		if (d->markers != NULL && d->markers[i] != NULL) {
-			fwrite(d->markers[i], sizeof(char), strlen(d->markers[i]), f);
+			write_string(f, d->markers[i]);
 		}
-		fwrite("\t", sizeof(char), 1, f);
+		write_char(f, '\t');
 	
 		for (int j = 0; j < counts.cols; ++j) { // loop through subjects
 			// print the matrix entries
-			fprintf(f, "%f ", counts.matrix[i][j]);
+			write_decimal(f, counts.matrix[i][j]);
+			write_char(f, ' ');
 		}
 		//print the newline
 		if (i + 1 < counts.cols) {
-			fwrite("\n", sizeof(char), 1, f);
+			write_char(f, '\n');
 		}
 	}
 	
 	delete_dmatrix(&counts);
-	fflush(f);
 }
 
 /** Print the number of copies of a particular allele at each marker of each genotype 
@@ -923,48 +1250,208 @@ void save_count_matrix(FILE* f, SimData* d, char allele) {
  *
  * Subject id will be printed if the genotype does not have a name saved.
  *
- * @param f file pointer opened for writing to put the output
+ * @param f file opened for writing with open_output_buffer() to put the output
  * @param d pointer to the SimData containing the group members.
  * @param group group number of the group of individuals to print the 
  * allele count of.
  * @param allele the allele character to count
  */
-void save_count_matrix_of_group(FILE* f, SimData* d, char allele, int group) {
+void save_count_matrix_of_group(OutputBuffer* f, SimData* d, char allele, int group) {
 	unsigned int group_size = get_group_size( d, group);
 	unsigned int* group_ids = get_group_ids( d, group, group_size);
 	char** group_names = get_group_names( d, group, group_size);
-	DecimalMatrix counts = calculate_count_matrix_of_allele_for_ids(d->m, group_ids, group_size, allele);
+	DecimalMatrix counts = calculate_count_matrix_of_allele_for_ids(d, group_ids, group_size, allele);
 	
-	fprintf(f, "%d", group);
+	write_int(f, group);
 	// print the header
 	for (int i = 0; i < counts.cols; ++i) {
-		fwrite("\t", sizeof(char), 1, f);
+		write_char(f, '\t');
 		if (group_names[i] != NULL) {
-			fwrite(group_names[i], sizeof(char), strlen(group_names[i]), f);
+			write_string(f, group_names[i]);
 		}
 	}
 	
-	fwrite("\n", sizeof(char), 1, f);
+	write_char(f, '\n');
 	
 	// Print the body
 	for (int i = 0; i < d->n_markers; ++i) { // loop through markers
 		if (d->markers != NULL && d->markers[i] != NULL) {
-			fwrite(d->markers[i], sizeof(char), strlen(d->markers[i]), f);
+			write_string(f, d->markers[i]);
 		}
-		fwrite("\t", sizeof(char), 1, f);
+		write_char(f, '\t');
 	
 		for (int j = 0; j < counts.cols; ++j) { // loop through subjects
 			// print the matrix entries
-			fprintf(f, "%f ", counts.matrix[i][j]);
+			write_decimal(f, counts.matrix[i][j]);
+			write_char(f, ' ');
 		}
 		//print the newline
 		if (i + 1 < counts.cols) {
-			fwrite("\n", sizeof(char), 1, f);
+			write_char(f, '\n');
 		}
 	}
 	
 	delete_dmatrix(&counts);
 	free(group_ids);
 	free(group_names);
-	fflush(f);
+}
+
+/*---------------------------------Snapshots---------------------------------*/
+
+/** Write a 32-bit integer to a snapshot file. @see save_simdata_snapshot()
+ *
+ * @param f file opened for writing with open_output_buffer().
+ * @param value the integer to write, in native byte order.
+ */
+static void write_snapshot_int(OutputBuffer* f, int32_t value) {
+	write_chars(f, (const char*) &value, sizeof(int32_t));
+}
+
+/** Write a string to a snapshot file, as its 32-bit length followed by its 
+ * characters. A NULL string is written as length -1. @see save_simdata_snapshot()
+ *
+ * @param f file opened for writing with open_output_buffer().
+ * @param s the string to write, or NULL.
+ */
+static void write_snapshot_string(OutputBuffer* f, const char* s) {
+	if (s == NULL) {
+		write_snapshot_int(f, -1);
+		return;
+	}
+	int32_t length = strlen(s);
+	write_snapshot_int(f, length);
+	write_chars(f, s, length);
+}
+
+/** Pad a snapshot file with zeros up to the next multiple of 8 bytes, so 
+ * that the following section can be used in place when the file is mapped.
+ *
+ * @param f file opened for writing with open_output_buffer().
+ */
+static void write_snapshot_padding(OutputBuffer* f) {
+	static const char zeros[8] = {0};
+	size_t offset = get_output_position(f);
+	if (offset % 8 != 0) {
+		write_chars(f, zeros, 8 - offset % 8);
+	}
+}
+
+/** Saves the complete state of a SimData to a binary snapshot file, which 
+ * can be loaded again with load_simdata_snapshot().
+ *
+ * All values are written in the native byte order of the machine, so a 
+ * snapshot can only be loaded on a machine with the same byte order. The 
+ * layout (version 2) is:
+ *
+ * - the 8 characters `SNAPSHOT_MAGIC`, then 32-bit integers: the version 
+ * `SNAPSHOT_VERSION`, the byte order check 0x01020304, n_markers, 
+ * packed_alleles, block_capacity, current_id, n_chr (-1 if there is no map), 
+ * the rows and columns of the effect matrix, and the number of AlleleMatrix blocks.
+ * - each marker name.
+ * - if packed_alleles, the 3 * n_markers bytes of the allele dictionary.
+ * - if there is a map, chr_ends (n_chr + 1 integers), chr_lengths (n_chr floats)
+ * and then the chromosome (integer) and position (float) of each marker.
+ * - if there are effects, the effect name of each row (one char each), then the
+ * matrix row by row as doubles.
+ * - for each AlleleMatrix block: its number of genotypes n, then n ids, n first 
+ * parents, n second parents and n groups (unsigned integers), then each genotype's 
+ * name. Then zero padding to a multiple of 8 bytes, followed by the n genotypes, 
+ * each get_genotype_length() bytes, stored exactly as in memory.
+ * - the number r of genotypes in `d->deleted_pedigrees`, then their r ids, 
+ * r first parents and r second parents (unsigned integers), then their names.
+ * Version 1 snapshots end before this section.
+ *
+ * Strings are written as a 32-bit length (-1 for NULL) followed by their characters.
+ *
+ * @param f file opened for writing with open_output_buffer() to put the output
+ * @param d pointer to the SimData to save
+ */
+void save_simdata_snapshot(OutputBuffer* f, SimData* d) {
+	int n_blocks = 0;
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		++n_blocks;
+	}
+	int has_effects = d->e.effects.matrix != NULL;
+	
+	/* Header */
+	write_chars(f, SNAPSHOT_MAGIC, 8);
+	write_snapshot_int(f, SNAPSHOT_VERSION);
+	write_snapshot_int(f, 0x01020304);
+	write_snapshot_int(f, d->n_markers);
+	write_snapshot_int(f, d->packed_alleles);
+	write_snapshot_int(f, d->block_capacity);
+	write_snapshot_int(f, (int32_t) d->current_id);
+	write_snapshot_int(f, d->map.positions != NULL ? d->map.n_chr : -1);
+	write_snapshot_int(f, has_effects ? d->e.effects.rows : 0);
+	write_snapshot_int(f, has_effects ? d->e.effects.cols : 0);
+	write_snapshot_int(f, n_blocks);
+	
+	/* Markers */
+	for (int i = 0; i < d->n_markers; ++i) {
+		write_snapshot_string(f, d->markers[i]);
+	}
+	if (d->packed_alleles) {
+		write_chars(f, d->allele_dictionary, 3 * d->n_markers);
+	}
+	
+	/* Genetic map */
+	if (d->map.positions != NULL) {
+		write_chars(f, (const char*) d->map.chr_ends, sizeof(int) * (d->map.n_chr + 1));
+		write_chars(f, (const char*) d->map.chr_lengths, sizeof(float) * d->map.n_chr);
+		for (int i = 0; i < d->n_markers; ++i) {
+			write_snapshot_int(f, d->map.positions[i].chromosome);
+			write_chars(f, (const char*) &(d->map.positions[i].position), sizeof(float));
+		}
+	}
+	
+	/* Effects */
+	if (has_effects) {
+		write_chars(f, d->e.effect_names, d->e.effects.rows);
+		for (int i = 0; i < d->e.effects.rows; ++i) {
+			write_chars(f, (const char*) d->e.effects.matrix[i], sizeof(double) * d->e.effects.cols);
+		}
+	}
+	
+	/* Genotypes */
+	size_t glen = get_genotype_length(d);
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		R_CheckUserInterrupt();
+		write_snapshot_int(f, m->n_subjects);
+		write_chars(f, (const char*) m->ids, sizeof(unsigned int) * m->n_subjects);
+		write_chars(f, (const char*) m->pedigrees[0], sizeof(unsigned int) * m->n_subjects);
+		write_chars(f, (const char*) m->pedigrees[1], sizeof(unsigned int) * m->n_subjects);
+		write_chars(f, (const char*) m->groups, sizeof(unsigned int) * m->n_subjects);
+		for (int i = 0; i < m->n_subjects; ++i) {
+			write_snapshot_string(f, m->subject_names[i]);
+		}
+		
+		write_snapshot_padding(f);
+		for (int i = 0; i < m->n_subjects; ++i) {
+			write_chars(f, m->alleles[i], glen);
+		}
+	}
+	
+	/* Pedigrees of deleted genotypes */
+	PedigreeTable* t = &(d->deleted_pedigrees);
+	int n_records = 0;
+	for (unsigned int id = 0; id < t->capacity; ++id) {
+		if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+			++n_records;
+		}
+	}
+	write_snapshot_int(f, n_records);
+	for (int k = 0; k < 3; ++k) {
+		for (unsigned int id = 0; id < t->capacity; ++id) {
+			if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+				unsigned int value = (k == 0) ? id : t->parents[k - 1][id];
+				write_chars(f, (const char*) &value, sizeof(unsigned int));
+			}
+		}
+	}
+	for (unsigned int id = 0; id < t->capacity; ++id) {
+		if (t->name_offsets[id] != PEDIGREE_UNRECORDED) {
+			write_snapshot_string(f, (t->name_offsets[id] == PEDIGREE_UNNAMED) ? 
+					NULL : t->names + t->name_offsets[id]);
+		}
+	}
 }
\ No newline at end of file
@@ -3,29 +3,83 @@
 
 #include "sim-utils.h"
 #include "sim-fitness.h"
+#include "sim-output.h"
+
+/** The first 8 bytes of every SimData snapshot file. @see save_simdata_snapshot() */
+#define SNAPSHOT_MAGIC "GSIMSNAP"
+/** The version of the snapshot format written by save_simdata_snapshot(). */
+#define SNAPSHOT_VERSION 2
+/** The first 8 bytes of every binary pedigree file. @see save_binary_pedigree() */
+#define PEDIGREE_MAGIC "GSIMPEDG"
+/** The version of the binary pedigree format written by save_binary_pedigree(). */
+#define PEDIGREE_FORMAT_VERSION 1
+
+/** One id's slot in a PedigreeCache.
+ *
+ * @param id the id, or 0 if the slot is empty.
+ * @param state whether the id's text is cached, or was found too long to cache.
+ * @param length the length of the cached text.
+ * @param text the cached text (not null-terminated), or NULL if `length` is 0.
+ */
+typedef struct {
+	unsigned int id;
+	unsigned char state;
+	unsigned int length;
+	char* text;
+} PedigreeCacheEntry;
+
+/** The recursive pedigree text of genotypes (what save_parents_of() writes
+ * after the genotype's name), saved the first time each is needed so that an 
+ * ancestor shared by many genotypes is expanded once per save rather than 
+ * once every time it appears.
+ *
+ * Only the ids actually expanded get an entry, in an open-addressing hash 
+ * table that grows as needed, so the cost of a cache does not depend on how 
+ * many ids the SimData has handed out. Texts longer than 65536 characters, or
+ * that would take the cache past 2^28 characters in total, are not kept, and 
+ * are written out piece by piece from the texts of their parents instead.
+ *
+ * @param capacity the number of slots in `entries` (0 or a power of 2).
+ * @param n_entries the number of slots in use.
+ * @param entries the hash table of ids.
+ * @param total_length the sum of the lengths of all cached texts.
+ */
+typedef struct {
+	unsigned int capacity;
+	unsigned int n_entries;
+	PedigreeCacheEntry* entries;
+	size_t total_length;
+} PedigreeCache;
+
+PedigreeCache create_pedigree_cache();
+void delete_pedigree_cache(PedigreeCache* c);
 
 /*--------------------------------Printing-----------------------------------*/
-void save_simdata(FILE* f, SimData* m);
+void save_simdata(OutputBuffer* f, SimData* m);
+
+void save_marker_blocks(OutputBuffer* f, SimData* d, MarkerBlocks b);
 
-void save_marker_blocks(FILE* f, SimData* d, MarkerBlocks b);
+void save_allele_matrix(OutputBuffer* f, AlleleMatrix* m, SimData* d);
+void save_transposed_allele_matrix(OutputBuffer* f, AlleleMatrix* m, SimData* d);
+void save_group_alleles(OutputBuffer* f, SimData* d, int group_id);
+void save_transposed_group_alleles(OutputBuffer* f, SimData* d, int group_id);
 
-void save_allele_matrix(FILE* f, AlleleMatrix* m, char** markers);
-void save_transposed_allele_matrix(FILE* f, AlleleMatrix* m, char** markers);
-void save_group_alleles(FILE* f, SimData* d, int group_id);
-void save_transposed_group_alleles(FILE* f, SimData* d, int group_id);
+void save_group_one_step_pedigree(OutputBuffer* f, SimData* d, int group); 
+void save_one_step_pedigree(OutputBuffer* f, SimData* d); 
+void save_group_full_pedigree(OutputBuffer* f, SimData* d, int group);
+void save_full_pedigree(OutputBuffer* f, SimData* d);
+void save_AM_pedigree(OutputBuffer* f, AlleleMatrix* m, SimData* parents, PedigreeCache* cache);
+void save_parents_of(OutputBuffer* f, SimData* d, unsigned int p1, unsigned int p2);
+void save_group_binary_pedigree(OutputBuffer* f, SimData* d, int group);
+void save_binary_pedigree(OutputBuffer* f, SimData* d);
 
-void save_group_one_step_pedigree(FILE* f, SimData* d, int group); 
-void save_one_step_pedigree(FILE* f, SimData* d); 
-void save_group_full_pedigree(FILE* f, SimData* d, int group);
-void save_full_pedigree(FILE* f, SimData* d);
-void save_AM_pedigree(FILE* f, AlleleMatrix* m, SimData* parents);
-void save_parents_of(FILE* f, AlleleMatrix* m, unsigned int p1, unsigned int p2);
+void save_group_fitness(OutputBuffer* f, SimData* d, int group);
+void save_fitness(OutputBuffer* f, DecimalMatrix* e, unsigned int* ids, char** names);
+void save_all_fitness(OutputBuffer* f, SimData* d);
 
-void save_group_fitness(FILE* f, SimData* d, int group);
-void save_fitness(FILE* f, DecimalMatrix* e, unsigned int* ids, char** names);
-void save_all_fitness(FILE* f, SimData* d);
+void save_count_matrix(OutputBuffer* f, SimData* d, char allele);
+void save_count_matrix_of_group(OutputBuffer* f, SimData* d, char allele, int group);
 
-void save_count_matrix(FILE* f, SimData* d, char allele);
-void save_count_matrix_of_group(FILE* f, SimData* d, char allele, int group);
+void save_simdata_snapshot(OutputBuffer* f, SimData* d);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "sim-rng.h"
+
+/*------------------------------Random Streams-------------------------------*/
+
+/** One step of the splitmix64 generator, used to expand seeds into full
+ * xoshiro256** states.
+ *
+ * @param x pointer to the splitmix64 state, which is advanced.
+ * @returns the next splitmix64 output.
+ */
+static uint64_t splitmix64_next(uint64_t* x) {
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/** Draw a 64-bit seed from R's random number generator, so that runs using
+ * RandomStreams are reproducible with R's `set.seed`.
+ *
+ * Must be called between GetRNGstate() and PutRNGstate().
+ *
+ * @returns a seed made of two 32-bit draws from R's RNG.
+ */
+uint64_t get_seed_from_R() {
+	uint64_t high = (uint64_t) (unif_rand() * 4294967296.0);
+	uint64_t low = (uint64_t) (unif_rand() * 4294967296.0);
+	return (high << 32) ^ low;
+}
+
+/** Create a RandomStream from a seed and a stream number.
+ *
+ * Streams with the same seed but different `stream_id`s are independent, so
+ * a task can be split into numbered pieces (eg one per offspring) that each
+ * get their own stream, and the results will not depend on the order the
+ * pieces are run in.
+ *
+ * @param seed the seed of the whole set of streams, eg from get_seed_from_R()
+ * @param stream_id the number of this stream within the set.
+ * @returns a seeded RandomStream.
+ */
+RandomStream create_random_stream(uint64_t seed, uint64_t stream_id) {
+	RandomStream r;
+	// mix the stream number in with a different odd constant to the
+	// splitmix64 increment so that (seed, id) pairs don't trivially overlap.
+	uint64_t x = seed ^ (stream_id * 0xD1B54A32D192ED03ULL);
+	splitmix64_next(&x); // discard one output so nearby seeds diverge
+	for (int i = 0; i < 4; ++i) {
+		r.s[i] = splitmix64_next(&x);
+	}
+	return r;
+}
+
+/** Advance a RandomStream by 2^128 draws. Calling this repeatedly on copies
+ * of one stream gives a set of non-overlapping streams, for example one per
+ * thread.
+ *
+ * @param r pointer to the stream to advance.
+ */
+void jump_random_stream(RandomStream* r) {
+	static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+			0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+	uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for (int i = 0; i < 4; ++i) {
+		for (int b = 0; b < 64; ++b) {
+			if (JUMP[i] & ((uint64_t) 1 << b)) {
+				s0 ^= r->s[0];
+				s1 ^= r->s[1];
+				s2 ^= r->s[2];
+				s3 ^= r->s[3];
+			}
+			get_random_bits(r);
+		}
+	}
+	r->s[0] = s0;
+	r->s[1] = s1;
+	r->s[2] = s2;
+	r->s[3] = s3;
+}
+
+/** Get a random integer from a Poisson distribution.
+ *
+ * Uses Knuth's multiplication method for small means (the usual case when
+ * drawing crossover counts for a chromosome) and Hormann's transformed
+ * rejection method (PTRS) for larger ones.
+ *
+ * @param r pointer to the stream to draw from. Its state is advanced.
+ * @param mu the mean of the distribution.
+ * @returns a Poisson-distributed non-negative integer.
+ */
+int get_random_poisson(RandomStream* r, double mu) {
+	if (mu <= 0) {
+		return 0;
+	}
+
+	if (mu < 10) {
+		double limit = exp(-mu);
+		double p = get_random_unif(r);
+		int k = 0;
+		while (p > limit) {
+			++k;
+			p *= get_random_unif(r);
+		}
+		return k;
+	}
+
+	double slam = sqrt(mu);
+	double loglam = log(mu);
+	double b = 0.931 + 2.53 * slam;
+	double a = -0.059 + 0.02483 * b;
+	double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+	double vr = 0.9277 - 3.6224 / (b - 2);
+	double u, v, us;
+	long k;
+
+	while (1) {
+		u = get_random_unif(r) - 0.5;
+		v = get_random_unif(r);
+		us = 0.5 - fabs(u);
+		k = (long) floor((2 * a / us + b) * u + mu + 0.43);
+		if (us >= 0.07 && v <= vr) {
+			return k;
+		}
+		if (k < 0 || (us < 0.013 && v > us)) {
+			continue;
+		}
+		if (log(v) + log(invalpha) - log(a / (us * us) + b) <= -mu + k * loglam - lgamma(k + 1)) {
+			return k;
+		}
+	}
+}
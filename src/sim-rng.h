@@ -0,0 +1,68 @@
+#ifndef SIM_RNG_H
+#define SIM_RNG_H
+
+#include <stdint.h>
+#include <math.h>
+#include <R.h>
+#include <Rmath.h>
+
+/** A self-contained stream of pseudo-random numbers, using the xoshiro256**
+ * generator (Blackman & Vigna). Each stream owns its own state, so separate
+ * streams can be used at the same time without interfering with each other
+ * or with R's random number generator.
+ *
+ * @param s the 256 bits of generator state. Must not be all zero.
+ */
+typedef struct {
+	uint64_t s[4];
+} RandomStream;
+
+/* Stream creation */
+uint64_t get_seed_from_R();
+RandomStream create_random_stream(uint64_t seed, uint64_t stream_id);
+void jump_random_stream(RandomStream* r);
+
+/* Draws */
+int get_random_poisson(RandomStream* r, double mu);
+
+/** Get the next 64 random bits from a stream.
+ *
+ * @param r pointer to the stream to draw from. Its state is advanced.
+ * @returns 64 uniformly distributed random bits.
+ */
+static inline uint64_t get_random_bits(RandomStream* r) {
+	uint64_t* s = r->s;
+	uint64_t x = s[1] * 5;
+	uint64_t result = ((x << 7) | (x >> 57)) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+
+	return result;
+}
+
+/** Get a random double from a uniform distribution on [0,1).
+ *
+ * @param r pointer to the stream to draw from. Its state is advanced.
+ * @returns a double in [0,1), with 53 random bits.
+ */
+static inline double get_random_unif(RandomStream* r) {
+	return (get_random_bits(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/** Get a random integer from a uniform distribution on [0, n).
+ *
+ * @param r pointer to the stream to draw from. Its state is advanced.
+ * @param n the number of possible values. Must be positive.
+ * @returns an integer in [0, n).
+ */
+static inline int get_random_index(RandomStream* r, int n) {
+	return (int) (get_random_unif(r) * n);
+}
+
+#endif
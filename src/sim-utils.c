@@ -11,7 +11,9 @@ const GenOptions BASIC_OPT = {
 	.will_save_pedigree_to_file = FALSE,
 	.will_save_effects_to_file = FALSE,
 	.will_save_genes_to_file = FALSE,
-	.will_save_to_simdata = TRUE
+	.will_save_to_simdata = TRUE,
+	.will_compress_files = FALSE,
+	.n_threads = 1
 };
 
 /** Replace calls to malloc direct with this function, which errors and exits
@@ -31,43 +33,122 @@ void* get_malloc(size_t size) {
 }
 
 
+/** Replace calls to realloc direct with this function, which errors and exits
+ * with status 2 if memory allocation fails. 
+ *
+ * @param ptr pointer to the space to be resized, or NULL. Treat like the first 
+ * parameter of a regular realloc call.
+ * @param size new size of the space. Treat like the second parameter of a 
+ * regular realloc call.
+ * @returns pointer to the resized space.
+ */
+void* get_realloc(void* ptr, size_t size) {
+	void* v = realloc(ptr, size);
+	if (v == NULL && size > 0) { 
+		fprintf(stderr, "Memory allocation of size %lu failed.\n", (unsigned long)size);
+		exit(3);
+	}
+	return v;
+}
+
 /** Creator for an empty AlleleMatrix object of a given size. Includes memory
  * allocation for `n_subjects` worth of `.alleles`.
  *
- * @param n_markers number of rows/markers to create
- * @param n_subjects number of individuals to create. This includes filling the first
- * n_subjects entries of .alleles with heap char* of length n_markers, so that the
- * alleles for these can be added without further memory allocation.
+ * The per-genotype arrays of the AlleleMatrix are allocated with exactly 
+ * `n_subjects` slots, so small groups take up little space. They can later be 
+ * grown, up to `d->block_capacity` slots, by reserve_allelematrix_capacity().
+ *
+ * @param d pointer to the SimData the AlleleMatrix will belong to. Its `n_markers`
+ * and storage settings (`packed_alleles`) determine the size of each genotype, 
+ * so must be set before this is called.
+ * @param n_subjects number of individuals to create. One zeroed slab of 
+ * n_subjects genotypes of length get_genotype_length(d) is allocated, and the first 
+ * n_subjects entries of .alleles point into it, so that the alleles for these 
+ * can be added without further memory allocation. Should be no greater than
+ * `d->block_capacity`.
  * @returns pointer to the empty created AlleleMatrix
  */
-AlleleMatrix* create_empty_allelematrix(int n_markers, int n_subjects) {
+AlleleMatrix* create_empty_allelematrix(const SimData* d, int n_subjects) {
 	AlleleMatrix* m = get_malloc(sizeof(AlleleMatrix));
 	
 	m->n_subjects = n_subjects;
-	m->n_markers = n_markers;
-	//m->alleles = get_malloc(sizeof(char*) * 1000);
+	m->n_markers = d->n_markers;
+	m->capacity = 0;
+	m->allele_slab = NULL;
+	m->slab_is_borrowed = FALSE;
+	m->alleles = NULL;
+	m->subject_names = NULL;
+	m->ids = NULL;
+	m->pedigrees[0] = NULL;
+	m->pedigrees[1] = NULL;
+	m->groups = NULL;
+	m->next = NULL;
+	
+	reserve_allelematrix_capacity(d, m, n_subjects);
+	
+	size_t glen = get_genotype_length(d);
 	for (int i = 0; i < n_subjects; ++i) {
-		m->alleles[i] = get_malloc(sizeof(char) * (n_markers<<1));
-		memset(m->alleles[i], 0, sizeof(char) * (n_markers<<1));
-		//m->ids[i] = 0;
+		m->alleles[i] = m->allele_slab + glen * i;
 	}
+	
+	return m;
+}
 
-	memset(m->ids, 0, sizeof(unsigned int) * 1000);
-	memset(m->pedigrees[0], 0, sizeof(unsigned int) * 1000);
-	memset(m->pedigrees[1], 0, sizeof(unsigned int) * 1000);
-	memset(m->groups, 0, sizeof(unsigned int) * 1000);
-	memset(m->subject_names, 0, sizeof(char*) * 1000); // setting the pointers to NULL
-	memset(m->alleles + n_subjects, 0, sizeof(char*) * (1000 - n_subjects + 1)); // setting the pointers to NULL
+/** Grow the per-genotype arrays and the genotype slab of an AlleleMatrix so 
+ * that slots with indexes up to `capacity - 1` can be filled. The new slots are 
+ * empty: their genotype space is zeroed and their `.alleles` and 
+ * `.subject_names` entries are NULL. Any occupied `.alleles` entries are 
+ * pointed at their new location in the slab, so pointers to genotypes in 
+ * this AlleleMatrix that were taken before the call are invalid after it.
+ *
+ * @param d pointer to the SimData the AlleleMatrix belongs to.
+ * @param m pointer to the AlleleMatrix to grow
+ * @param capacity the number of genotypes the AlleleMatrix should have space for. 
+ * Nothing is done if it is already at least this large.
+ */
+void reserve_allelematrix_capacity(const SimData* d, AlleleMatrix* m, int capacity) {
+	if (capacity <= m->capacity) {
+		return;
+	}
+	size_t glen = get_genotype_length(d);
+	int old_capacity = m->capacity;
+	int added = capacity - old_capacity;
 	
-	/*for (int i = 0; i < 1000; ++i) {
-		m->subject_names[i] = NULL;
-		m->pedigrees[0][i] = 0;
-		m->pedigrees[1][i] = 0;
-	}*/
+	char* new_slab;
+	if (m->slab_is_borrowed) {
+		new_slab = get_malloc(sizeof(char) * glen * capacity);
+		if (old_capacity > 0) {
+			memcpy(new_slab, m->allele_slab, sizeof(char) * glen * old_capacity);
+		}
+		m->slab_is_borrowed = FALSE;
+	} else {
+		new_slab = get_realloc(m->allele_slab, sizeof(char) * glen * capacity);
+	}
+	memset(new_slab + glen * old_capacity, 0, sizeof(char) * glen * added);
 	
-	m->next = NULL;
+	m->alleles = get_realloc(m->alleles, sizeof(char*) * capacity);
+	for (int i = 0; i < old_capacity; ++i) {
+		if (m->alleles[i] != NULL) {
+			m->alleles[i] = new_slab + glen * i;
+		}
+	}
+	m->allele_slab = new_slab;
 	
-	return m;
+	m->subject_names = get_realloc(m->subject_names, sizeof(char*) * capacity);
+	m->ids = get_realloc(m->ids, sizeof(unsigned int) * capacity);
+	m->pedigrees[0] = get_realloc(m->pedigrees[0], sizeof(unsigned int) * capacity);
+	m->pedigrees[1] = get_realloc(m->pedigrees[1], sizeof(unsigned int) * capacity);
+	m->groups = get_realloc(m->groups, sizeof(unsigned int) * capacity);
+	
+	// setting the pointers to NULL and the rest to 0
+	memset(m->alleles + old_capacity, 0, sizeof(char*) * added);
+	memset(m->subject_names + old_capacity, 0, sizeof(char*) * added);
+	memset(m->ids + old_capacity, 0, sizeof(unsigned int) * added);
+	memset(m->pedigrees[0] + old_capacity, 0, sizeof(unsigned int) * added);
+	memset(m->pedigrees[1] + old_capacity, 0, sizeof(unsigned int) * added);
+	memset(m->groups + old_capacity, 0, sizeof(unsigned int) * added);
+	
+	m->capacity = capacity;
 }
 
 /** Creator for an empty SimData object on the heap. This is the main struct
@@ -89,11 +170,113 @@ SimData* create_empty_simdata() {
 	d->e.effects.matrix = NULL;
 	d->e.effect_names = NULL;
 	d->current_id = 0;
+	d->packed_alleles = FALSE;
+	d->allele_dictionary = NULL;
+	d->block_capacity = 1000;
+	d->n_threads = 1;
+	d->id_index = NULL;
+	d->id_index_capacity = 0;
+	d->marker_index = create_string_index(0);
+	d->name_index = create_string_index(0);
+	d->child_index = create_pair_index(0);
+	d->deleted_pedigrees = create_pedigree_table();
+	d->snapshot.data = NULL;
+	d->snapshot.length = 0;
+	d->snapshot.is_mapped = FALSE;
 	return d;
 }
 
+/** Allocate an empty allele dictionary for a SimData whose genotypes are to be
+ * stored packed. Called by the loaders once the number of markers is known. 
+ * Does nothing if `d->packed_alleles` is FALSE.
+ *
+ * @param d the SimData struct on which to perform actions. `d->n_markers` must
+ * already be set.
+ */
+void create_allele_dictionary(SimData* d) {
+	if (!d->packed_alleles) {
+		return;
+	}
+	if (d->allele_dictionary != NULL) {
+		free(d->allele_dictionary);
+	}
+	d->allele_dictionary = get_malloc(sizeof(char) * 3 * d->n_markers);
+	memset(d->allele_dictionary, 0, sizeof(char) * 3 * d->n_markers);
+}
+
 /*------------------------Supporter Functions--------------------------------*/
 
+/** Record the location of the genotype with a given id in the SimData's
+ * id index, growing the index if necessary. Not intended to be called by 
+ * an end user.
+ *
+ * @param d the SimData struct whose index is to be updated.
+ * @param id the id of the genotype.
+ * @param block the AlleleMatrix in which the genotype is stored, or NULL
+ * to mark the id as no longer stored.
+ * @param slot the index of the genotype in `block`.
+ */
+static void set_id_location(SimData* d, unsigned int id, AlleleMatrix* block, int slot) {
+	if (id >= d->id_index_capacity) {
+		if (block == NULL) {
+			return; // nothing to clear
+		}
+		unsigned int new_capacity = (d->id_index_capacity > 0) ? d->id_index_capacity : 1024;
+		while (new_capacity <= id && new_capacity < UINT_MAX / 2) {
+			new_capacity *= 2;
+		}
+		if (new_capacity <= id) {
+			new_capacity = UINT_MAX;
+		}
+		d->id_index = get_realloc(d->id_index, sizeof(IdLocation) * new_capacity);
+		for (unsigned int i = d->id_index_capacity; i < new_capacity; ++i) {
+			d->id_index[i].block = NULL;
+			d->id_index[i].slot = 0;
+		}
+		d->id_index_capacity = new_capacity;
+	}
+	d->id_index[id].block = block;
+	d->id_index[id].slot = slot;
+}
+
+/** Add the ids of all genotypes in an AlleleMatrix to the SimData's id index,
+ * their names to its name index, and their parents to its child index.
+ * Called by the crossers when they link a block of new genotypes into the 
+ * SimData. Not intended to be called by an end user.
+ *
+ * @param d the SimData struct whose index is to be updated.
+ * @param m the AlleleMatrix whose genotypes have just been given ids and 
+ * linked into `d->m`.
+ */
+void index_subject_ids(SimData* d, AlleleMatrix* m) {
+	for (int i = 0; i < m->n_subjects; ++i) {
+		if (m->alleles[i] != NULL && m->ids[i] > 0) {
+			set_id_location(d, m->ids[i], m, i);
+			// if the name index is not built yet, it will pick these up when it is.
+			if (d->name_index.n_entries > 0 && m->subject_names[i] != NULL) {
+				add_to_string_index(&(d->name_index), m->subject_names[i], (int) m->ids[i]);
+			}
+			if (d->child_index.capacity > 0) {
+				add_to_pair_index(&(d->child_index), m->pedigrees[0][i], m->pedigrees[1][i], m->ids[i]);
+			}
+		}
+	}
+}
+
+/** Clear the SimData's id index and re-add every genotype in its linked list
+ * of AlleleMatrix. Not intended to be called by an end user.
+ *
+ * @param d the SimData struct whose index is to be rebuilt.
+ */
+void rebuild_id_index(SimData* d) {
+	for (unsigned int i = 0; i < d->id_index_capacity; ++i) {
+		d->id_index[i].block = NULL;
+	}
+	for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+		index_subject_ids(d, m);
+	}
+}
+
 /** Allocate lifetime-unique ids to each genotype in the range of whole
  * SimData indexes `from_index` to `to_index` inclusive. Not intended to 
  * be called by an end user.
@@ -120,6 +303,9 @@ void set_subject_ids(SimData* d, int from_index, int to_index) {
 	}
 	total_i = from_index;
 	
+	// the new genotypes' names are picked up when the name index is next built.
+	delete_string_index(&(d->name_index));
+	
 	// check for overflow:
 	if (d->current_id > UINT_MAX - to_index + from_index) {
 		warning("IDs will overflow in the process of this calculation. Past this point id-based functions (anything to do with pedigrees) have undefined behaviour.\n");
@@ -130,6 +316,7 @@ void set_subject_ids(SimData* d, int from_index, int to_index) {
 		for (i = 0; i < m->n_subjects; ++i, ++total_i) {
 			++ d->current_id;
 			m->ids[i] = d->current_id;
+			set_id_location(d, d->current_id, m, i);
 			if (total_i >= to_index) {
 				return;
 			}
@@ -144,9 +331,220 @@ void set_subject_ids(SimData* d, int from_index, int to_index) {
 	}
 }
 
-/** Opens a table file and reads the number of columns and rows 
- * (including headers) separated by `sep` into a TableSize struct that is
- * returned. 
+/** Read the whole contents of a file, which may be gzip-compressed, into a 
+ * heap buffer. @see open_mapped_file()
+ *
+ * @param filename the path/name of the file to read.
+ * @returns a MappedFile whose `data` is a heap copy of the (inflated) file.
+ */
+static MappedFile read_whole_file(const char* filename) {
+	MappedFile f = { .data = NULL, .length = 0, .is_mapped = FALSE };
+	gzFile fp = open_input_file(filename);
+	
+	size_t capacity = 1 << 20;
+	char* buffer = get_malloc(sizeof(char) * capacity);
+	int n_read;
+	do {
+		if (f.length == capacity) {
+			capacity *= 2;
+			buffer = get_realloc(buffer, sizeof(char) * capacity);
+		}
+		size_t space = capacity - f.length;
+		n_read = gzread(fp, buffer + f.length, space < (1u << 30) ? space : (1u << 30));
+		if (n_read > 0) {
+			f.length += n_read;
+		}
+	} while (n_read > 0);
+	gzclose(fp);
+	
+	if (n_read < 0) {
+		free(buffer);
+		error( "Failed to read file %s.\n", filename);
+	}
+	if (f.length == 0) {
+		free(buffer);
+	} else {
+		f.data = buffer;
+	}
+	return f;
+}
+
+/** Make the whole contents of a file available in memory for parsing.
+ *
+ * Where the operating system supports it the file is memory-mapped, so that
+ * it is paged in from disk as it is read and no copy is made. Otherwise (eg on
+ * Windows), or if the file is gzip-compressed, it is read (and inflated) into 
+ * a heap buffer in one go.
+ *
+ * If the file fails to open, the simulation exits.
+ *
+ * @param filename the path/name of the file to read.
+ * The memory may be written to without affecting the file on disk.
+ *
+ * @returns a MappedFile whose `data` holds the `length` bytes of the file. 
+ * It should be released with close_mapped_file().
+ */
+MappedFile open_mapped_file(const char* filename) {
+	MappedFile f = { .data = NULL, .length = 0, .is_mapped = FALSE };
+	
+#ifdef _WIN32
+	f = read_whole_file(filename);
+#else
+	int fd;
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		error( "Failed to open file %s.\n", filename);
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		error( "Failed to open file %s.\n", filename);
+	}
+	if (info.st_size > 0) {
+		// a private writable mapping, so that borrowed genotypes can be modified
+		// in memory (copy-on-write) without changing the file.
+		void* map = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			error( "Failed to read file %s into memory.\n", filename);
+		}
+		if (info.st_size >= 2 && ((unsigned char*) map)[0] == 0x1f && ((unsigned char*) map)[1] == 0x8b) {
+			// gzip magic number: the file has to be inflated into memory instead
+			munmap(map, info.st_size);
+			close(fd);
+			return read_whole_file(filename);
+		}
+		madvise(map, info.st_size, MADV_SEQUENTIAL);
+		f.data = map;
+		f.length = info.st_size;
+		f.is_mapped = TRUE;
+	}
+	close(fd); // the mapping stays valid after the descriptor is closed
+#endif
+	
+	return f;
+}
+
+/** Release the memory holding the contents of a file. f will now refer 
+ * to an empty file.
+ *
+ * @param f pointer to the MappedFile to be closed.
+ */
+void close_mapped_file(MappedFile* f) {
+	if (f->data != NULL) {
+#ifndef _WIN32
+		if (f->is_mapped) {
+			munmap((void*) f->data, f->length);
+		} else {
+			free((void*) f->data);
+		}
+#else
+		free((void*) f->data);
+#endif
+	}
+	f->data = NULL;
+	f->length = 0;
+	f->is_mapped = FALSE;
+}
+
+/** Check if a filename ends with a given extension, ignoring case.
+ *
+ * @param filename the filename to check.
+ * @param extension the extension, including its leading dot, eg ".bed".
+ * @returns TRUE if `filename` ends with `extension`, FALSE otherwise.
+ */
+int has_file_extension(const char* filename, const char* extension) {
+	size_t name_length = strlen(filename);
+	size_t ext_length = strlen(extension);
+	if (name_length < ext_length) {
+		return FALSE;
+	}
+	const char* end = filename + name_length - ext_length;
+	for (size_t i = 0; i < ext_length; ++i) {
+		if (tolower((unsigned char) end[i]) != tolower((unsigned char) extension[i])) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/** Open a file for reading. Files that are gzip-compressed are inflated as
+ * they are read, and other files are read as they are, so every file loader 
+ * accepts compressed input. Compression is detected from the file's 
+ * contents, not its name.
+ *
+ * If the file fails to open, the simulation exits.
+ *
+ * @param filename the path/name of the file to read.
+ * @returns a zlib handle to the open file. Close it with gzclose().
+ */
+gzFile open_input_file(const char* filename) {
+	gzFile f;
+	if ((f = gzopen(filename, "rb")) == NULL) {
+		error( "Failed to open file %s.\n", filename);
+	}
+	gzbuffer(f, 1 << 17);
+	return f;
+}
+
+/** Read the next whitespace-separated word from a file, the way the 
+ * `%s` conversion of `fscanf` would. Words longer than `max_length` are 
+ * cut short, and the rest of the word is skipped.
+ *
+ * @param f the file to read from, opened with open_input_file().
+ * @param word buffer with space for at least `max_length + 1` characters, 
+ * where the null-terminated word is saved.
+ * @param max_length the maximum number of characters to save.
+ * @returns the length of the word saved, or -1 if the end of the file was 
+ * reached before any word.
+ */
+int read_file_word(gzFile f, char* word, int max_length) {
+	int c;
+	do {
+		c = gzgetc(f);
+	} while (c != -1 && isspace(c));
+	if (c == -1) {
+		word[0] = '\0';
+		return -1;
+	}
+	
+	int length = 0;
+	do {
+		if (length < max_length) {
+			word[length] = c;
+			++length;
+		}
+		c = gzgetc(f);
+	} while (c != -1 && !isspace(c));
+	word[length] = '\0';
+	return length;
+}
+
+/** Open a file for writing. If `compress` is TRUE or the filename ends in 
+ * ".gz", what is written to the file is gzip-compressed. Otherwise it is 
+ * written as plain text/bytes. 
+ *
+ * If the file fails to open, the simulation exits.
+ *
+ * @param filename the path/name of the file to write.
+ * @param compress TRUE to compress the output whatever the filename.
+ * @returns a zlib handle to the open file. Write to it with gzfwrite(), 
+ * gzprintf() or gzputc(), and close it with gzclose(). The save functions 
+ * write through an OutputBuffer instead. @see open_output_buffer()
+ */
+gzFile open_output_file(const char* filename, int compress) {
+	int will_compress = compress || has_file_extension(filename, ".gz");
+	gzFile f;
+	// "T" writes the file without compression.
+	if ((f = gzopen(filename, will_compress ? "wb6" : "wbT")) == NULL) {
+		error( "Failed to open file %s.\n", filename);
+	}
+	gzbuffer(f, 1 << 17);
+	return f;
+}
+
+/** Opens a table file, which may be gzip-compressed, and reads the number of 
+ * columns and rows (including headers) separated by `sep` into a TableSize 
+ * struct that is returned. 
  *
  * If the file fails to open, the simulation exits.
  *
@@ -167,26 +565,23 @@ struct TableSize get_file_dimensions(const char* filename, char sep) {
 	details.num_columns = 0;
 	details.num_rows = 0;
 	
-	FILE* fp;
-	int c; // this is used to store the output of fgetc i.e. the next character in the file
-	if ((fp = fopen(filename, "r")) == NULL) {
-		error( "Failed to open file %s.\n", filename);
-	}
-	c = fgetc(fp);
+	int c; // this is used to store the output of gzgetc i.e. the next character in the file
+	gzFile fp = open_input_file(filename);
+	c = gzgetc(fp);
 	
 	while (c != EOF && c != '\n') {
 		R_CheckUserInterrupt();
 		if (c == sep) {
 			details.num_columns += 1; // add count for columns of form [colname]sep
 		}
-		c = fgetc(fp);
+		c = gzgetc(fp);
 	}
 	
 	details.num_columns += 1; // add another column that was bounded by sep[colname][EOF or \n]
 	details.num_rows = 1; // we successfully got the first row
 	
 	// now get all the rows. What we care about in the rows is the number of them
-	c = fgetc(fp);
+	c = gzgetc(fp);
 	int sep_count = 0; // for each row, count the columns to make sure they match and the file is valid
 	int has_length = FALSE;
 	while (c != EOF) {
@@ -198,7 +593,7 @@ struct TableSize get_file_dimensions(const char* filename, char sep) {
 			if (has_length && sep_count != details.num_columns-1) {
 				// we have a bad number of columns
 				details.num_columns = 0; 
-				fclose(fp);
+				gzclose(fp);
 				error("Bad columns on row %d\n", details.num_rows + 1);
 			}
 			sep_count = 0;
@@ -209,13 +604,13 @@ struct TableSize get_file_dimensions(const char* filename, char sep) {
 		} else if (has_length == FALSE) {
 			has_length = TRUE;
 		}
-		c = fgetc(fp);
+		c = gzgetc(fp);
 	}
 	if (has_length) {
 		details.num_rows += 1; // for the last row before EOF
 	}
 	
-	fclose(fp);
+	gzclose(fp);
 	return details;
 }
 
@@ -270,6 +665,371 @@ int get_from_unordered_str_list(char* target, char** list, int list_len) {
 	return -1; // did not find a match.
 }
 
+/** Hash a string with the 32-bit FNV-1a algorithm.
+ *
+ * @param key the null-terminated string to hash.
+ * @returns the hash of `key`.
+ */
+static unsigned int _string_hash(const char* key) {
+	unsigned int h = 2166136261u;
+	for (const unsigned char* c = (const unsigned char*) key; *c != '\0'; ++c) {
+		h ^= *c;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/** Create an empty StringIndex with room for a given number of entries 
+ * before it needs to grow.
+ *
+ * @param expected_entries the number of keys expected to be added. Can be 0,
+ * in which case no memory is allocated until the first key is added.
+ * @returns an empty StringIndex. Its heap memory should be released with 
+ * delete_string_index().
+ */
+StringIndex create_string_index(unsigned int expected_entries) {
+	StringIndex t = { .capacity = 0, .n_entries = 0, .keys = NULL, .values = NULL };
+	if (expected_entries > 0) {
+		// keep the load factor under one half
+		t.capacity = 16;
+		while (t.capacity < 2 * expected_entries) {
+			t.capacity <<= 1;
+		}
+		t.keys = get_malloc(sizeof(char*) * t.capacity);
+		t.values = get_malloc(sizeof(int) * t.capacity);
+		memset(t.keys, 0, sizeof(char*) * t.capacity);
+	}
+	return t;
+}
+
+/** Add a key and its value to a StringIndex, growing it if necessary. If the key 
+ * is already in the table its value is left unchanged, so that lookups find the 
+ * first value added, as get_from_unordered_str_list() does.
+ *
+ * @param t pointer to the StringIndex to add to.
+ * @param key the string to add. The table stores this pointer, not a copy.
+ * @param value the value to associate with `key`.
+ */
+void add_to_string_index(StringIndex* t, const char* key, int value) {
+	if (2 * (t->n_entries + 1) > t->capacity) {
+		StringIndex bigger = create_string_index(t->n_entries + 1 > 8 ? 2 * t->n_entries : 8);
+		for (unsigned int i = 0; i < t->capacity; ++i) {
+			if (t->keys[i] != NULL) {
+				add_to_string_index(&bigger, t->keys[i], t->values[i]);
+			}
+		}
+		delete_string_index(t);
+		*t = bigger;
+	}
+	
+	unsigned int mask = t->capacity - 1;
+	unsigned int i = _string_hash(key) & mask;
+	while (t->keys[i] != NULL) {
+		if (strcmp(t->keys[i], key) == 0) {
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	t->keys[i] = key;
+	t->values[i] = value;
+	++ t->n_entries;
+}
+
+/** Look up the value of a key in a StringIndex.
+ *
+ * @param t pointer to the StringIndex to search.
+ * @param key the string to look up.
+ * @returns the value associated with `key`, or -1 if it is not in the table.
+ */
+int get_from_string_index(const StringIndex* t, const char* key) {
+	if (t->n_entries == 0) {
+		return -1;
+	}
+	unsigned int mask = t->capacity - 1;
+	unsigned int i = _string_hash(key) & mask;
+	while (t->keys[i] != NULL) {
+		if (strcmp(t->keys[i], key) == 0) {
+			return t->values[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+/** Deletes a StringIndex and frees its memory. The keys themselves are not 
+ * freed. t will now refer to an empty table.
+ *
+ * @param t pointer to the StringIndex to be cleared.
+ */
+void delete_string_index(StringIndex* t) {
+	if (t->keys != NULL) {
+		free(t->keys);
+	}
+	if (t->values != NULL) {
+		free(t->values);
+	}
+	t->keys = NULL;
+	t->values = NULL;
+	t->capacity = 0;
+	t->n_entries = 0;
+}
+
+/** Combine an unordered pair of ids into a PairIndex key.
+ *
+ * @param id1 one id of the pair.
+ * @param id2 the other id of the pair.
+ * @returns the key of the pair, with the smaller id in the high 32 bits.
+ */
+static inline uint64_t _pair_key(unsigned int id1, unsigned int id2) {
+	if (id1 > id2) {
+		return ((uint64_t) id2 << 32) | id1;
+	}
+	return ((uint64_t) id1 << 32) | id2;
+}
+
+/** Hash a PairIndex key (using the splitmix64 finaliser).
+ *
+ * @param key the key to hash.
+ * @returns the hash of `key`.
+ */
+static inline unsigned int _pair_hash(uint64_t key) {
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+	return (unsigned int) (key ^ (key >> 31));
+}
+
+/** Create an empty PairIndex with room for a given number of entries 
+ * before it needs to grow.
+ *
+ * @param expected_entries the number of pairs expected to be added. Can be 0,
+ * in which case no memory is allocated until the first pair is added.
+ * @returns an empty PairIndex. Its heap memory should be released with 
+ * delete_pair_index().
+ */
+PairIndex create_pair_index(unsigned int expected_entries) {
+	PairIndex t = { .capacity = 0, .n_entries = 0, .keys = NULL, .values = NULL };
+	if (expected_entries > 0) {
+		// keep the load factor under one half
+		t.capacity = 16;
+		while (t.capacity < 2 * expected_entries) {
+			t.capacity <<= 1;
+		}
+		t.keys = get_malloc(sizeof(uint64_t) * t.capacity);
+		t.values = get_malloc(sizeof(unsigned int) * t.capacity);
+		memset(t.keys, 0, sizeof(uint64_t) * t.capacity);
+	}
+	return t;
+}
+
+/** Add an unordered pair of ids and its value to a PairIndex, growing it if 
+ * necessary. If the pair is already in the table its value is left unchanged, 
+ * so that lookups find the first value added. The pair (0,0) is ignored.
+ *
+ * @param t pointer to the PairIndex to add to.
+ * @param id1 one id of the pair.
+ * @param id2 the other id of the pair.
+ * @param value the value to associate with the pair.
+ */
+void add_to_pair_index(PairIndex* t, unsigned int id1, unsigned int id2, unsigned int value) {
+	uint64_t key = _pair_key(id1, id2);
+	if (key == 0) {
+		return;
+	}
+	
+	if (2 * (t->n_entries + 1) > t->capacity) {
+		PairIndex bigger = create_pair_index(t->n_entries + 1 > 8 ? 2 * t->n_entries : 8);
+		for (unsigned int i = 0; i < t->capacity; ++i) {
+			if (t->keys[i] != 0) {
+				add_to_pair_index(&bigger, t->keys[i] >> 32, (unsigned int) t->keys[i], t->values[i]);
+			}
+		}
+		delete_pair_index(t);
+		*t = bigger;
+	}
+	
+	unsigned int mask = t->capacity - 1;
+	unsigned int i = _pair_hash(key) & mask;
+	while (t->keys[i] != 0) {
+		if (t->keys[i] == key) {
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	t->keys[i] = key;
+	t->values[i] = value;
+	++ t->n_entries;
+}
+
+/** Look up the value of an unordered pair of ids in a PairIndex.
+ *
+ * @param t pointer to the PairIndex to search.
+ * @param id1 one id of the pair.
+ * @param id2 the other id of the pair.
+ * @returns the value associated with the pair, or 0 if it is not in the table.
+ */
+unsigned int get_from_pair_index(const PairIndex* t, unsigned int id1, unsigned int id2) {
+	uint64_t key = _pair_key(id1, id2);
+	if (t->n_entries == 0 || key == 0) {
+		return 0;
+	}
+	unsigned int mask = t->capacity - 1;
+	unsigned int i = _pair_hash(key) & mask;
+	while (t->keys[i] != 0) {
+		if (t->keys[i] == key) {
+			return t->values[i];
+		}
+		i = (i + 1) & mask;
+	}
+	return 0;
+}
+
+/** Deletes a PairIndex and frees its memory. t will now refer to an empty,
+ * unbuilt table.
+ *
+ * @param t pointer to the PairIndex to be cleared.
+ */
+void delete_pair_index(PairIndex* t) {
+	if (t->keys != NULL) {
+		free(t->keys);
+	}
+	if (t->values != NULL) {
+		free(t->values);
+	}
+	t->keys = NULL;
+	t->values = NULL;
+	t->capacity = 0;
+	t->n_entries = 0;
+}
+
+/** Create an empty PedigreeTable. No memory is allocated until the first 
+ * record is added.
+ *
+ * @returns an empty PedigreeTable. Its heap memory should be released with
+ * delete_pedigree_table().
+ */
+PedigreeTable create_pedigree_table() {
+	PedigreeTable t = { .capacity = 0, .parents = { NULL, NULL }, .name_offsets = NULL,
+			.names = NULL, .names_length = 0, .names_capacity = 0 };
+	return t;
+}
+
+/** Add the parents and name of a genotype to a PedigreeTable, growing it if
+ * necessary. If the id already has a record, it is replaced, though the space
+ * its old name took is not reused.
+ *
+ * @param t pointer to the PedigreeTable to add to.
+ * @param id the id of the genotype. Ids of 0 are ignored.
+ * @param parent1 the id of the genotype's first parent, or 0 if unknown.
+ * @param parent2 the id of the genotype's second parent, or 0 if unknown.
+ * @param name the genotype's name, which is copied into the table, or NULL
+ * if it has no name.
+ */
+void add_to_pedigree_table(PedigreeTable* t, unsigned int id, unsigned int parent1, 
+		unsigned int parent2, const char* name) {
+	if (id == 0) {
+		return;
+	}
+	if (id >= t->capacity) {
+		unsigned int new_capacity = (t->capacity > 0) ? t->capacity : 1024;
+		while (new_capacity <= id && new_capacity < UINT_MAX / 2) {
+			new_capacity *= 2;
+		}
+		if (new_capacity <= id) {
+			new_capacity = UINT_MAX;
+		}
+		t->parents[0] = get_realloc(t->parents[0], sizeof(unsigned int) * new_capacity);
+		t->parents[1] = get_realloc(t->parents[1], sizeof(unsigned int) * new_capacity);
+		t->name_offsets = get_realloc(t->name_offsets, sizeof(unsigned int) * new_capacity);
+		for (unsigned int i = t->capacity; i < new_capacity; ++i) {
+			t->name_offsets[i] = PEDIGREE_UNRECORDED;
+		}
+		t->capacity = new_capacity;
+	}
+	
+	t->parents[0][id] = parent1;
+	t->parents[1][id] = parent2;
+	if (name == NULL) {
+		t->name_offsets[id] = PEDIGREE_UNNAMED;
+		return;
+	}
+	
+	size_t length = strlen(name) + 1;
+	if (t->names_length + length >= PEDIGREE_UNNAMED) {
+		error("Too many names to record in the pedigree table.\n");
+	}
+	if (t->names_length + length > t->names_capacity) {
+		size_t new_capacity = (t->names_capacity > 0) ? t->names_capacity : 4096;
+		while (new_capacity < t->names_length + length) {
+			new_capacity *= 2;
+		}
+		t->names = get_realloc(t->names, sizeof(char) * new_capacity);
+		t->names_capacity = new_capacity;
+	}
+	memcpy(t->names + t->names_length, name, sizeof(char) * length);
+	t->name_offsets[id] = t->names_length;
+	t->names_length += length;
+}
+
+/** Look up the record of a genotype in a PedigreeTable.
+ *
+ * @param t pointer to the PedigreeTable to search.
+ * @param id the id of the genotype.
+ * @param parents array in which to save the ids of the genotype's two 
+ * parents, if it has a record.
+ * @param name location in which to save the genotype's name, if it has a 
+ * record. Set to NULL if it has no name. The name is stored inside the table,
+ * so it should not be freed, and may move when more records are added.
+ * @returns TRUE if the id has a record, FALSE otherwise.
+ */
+int get_from_pedigree_table(const PedigreeTable* t, unsigned int id, unsigned int parents[2], 
+		const char** name) {
+	if (id >= t->capacity || t->name_offsets[id] == PEDIGREE_UNRECORDED) {
+		return FALSE;
+	}
+	parents[0] = t->parents[0][id];
+	parents[1] = t->parents[1][id];
+	*name = (t->name_offsets[id] == PEDIGREE_UNNAMED) ? NULL : t->names + t->name_offsets[id];
+	return TRUE;
+}
+
+/** Free the heap memory of a PedigreeTable, leaving it empty.
+ *
+ * @param t pointer to the PedigreeTable to delete.
+ */
+void delete_pedigree_table(PedigreeTable* t) {
+	free(t->parents[0]);
+	free(t->parents[1]);
+	free(t->name_offsets);
+	free(t->names);
+	*t = create_pedigree_table();
+}
+
+/** Returns the index of the marker with a given name in `d->markers`, or
+ * -1 if there is no such marker.
+ *
+ * Uses the SimData's marker name hash table, building it first if it
+ * does not exist yet, so this takes constant time per lookup.
+ *
+ * @param d pointer to the SimData whose markers are to be searched.
+ * @param name the marker name to look for.
+ * @returns the index of the first marker named `name`, or -1 if no match is found.
+ */
+int get_index_of_marker(SimData* d, const char* name) {
+	if (d->markers == NULL) {
+		return -1;
+	}
+	if (d->marker_index.n_entries == 0) {
+		delete_string_index(&(d->marker_index));
+		d->marker_index = create_string_index(d->n_markers);
+		for (int i = 0; i < d->n_markers; ++i) {
+			if (d->markers[i] != NULL) {
+				add_to_string_index(&(d->marker_index), d->markers[i], i);
+			}
+		}
+	}
+	return get_from_string_index(&(d->marker_index), name);
+}
+
 /** Fills the designated section of the `.subject_names` array in an 
  * AlleleMatrix with the pattern `prefix`index.
  *
@@ -279,6 +1039,11 @@ int get_from_unordered_str_list(char* target, char** list, int list_len) {
  * WARNING: after this is run, n_subjects must be updated by n_new_subjects or
  * some of these strings will not be freed on delete.
  *
+ * Names should be set before the AlleleMatrix is linked into a SimData, so that
+ * index_subject_ids() can add them to the SimData's name index. If renaming
+ * genotypes already in a SimData, clear its name index afterwards with
+ * `delete_string_index(&(d->name_index))`, as the old names are freed here.
+ *
  * @param pointer to the AlleleMatrix whose `.subject_names` to modify
  * @param prefix the prefix to add to the suffix to make the new subject name
  * @param suffix suffixes start at this value and increment for each additional subject_name
@@ -326,6 +1091,58 @@ int get_integer_digits(int i) {
 	return digits;
 }
 
+/** Find the 2-bit code used to store a given allele at a marker when the 
+ * SimData's genotypes are packed. If the allele has not been seen at that 
+ * marker before, it is added to the marker's entry in `d->allele_dictionary`.
+ *
+ * Each marker can hold at most three distinct alleles (code 0 is reserved for
+ * missing values), which is plenty for biallelic SNP panels. 
+ *
+ * Exits if the marker already has three other alleles. 
+ * @see find_allele_code() for a version that does not exit.
+ *
+ * @param d the SimData struct containing the allele dictionary.
+ * @param marker index of the marker the allele belongs to.
+ * @param allele the allele to encode.
+ * @returns the code (0 to 3) for that allele at that marker.
+ */
+unsigned char get_allele_code(SimData* d, int marker, char allele) {
+	int code = find_allele_code(d, marker, allele);
+	if (code < 0) {
+		error("Marker %s has more than three alleles, so its genotypes cannot be stored packed.\n", 
+				d->markers != NULL && d->markers[marker] != NULL ? d->markers[marker] : "");
+	}
+	return code;
+}
+
+/** Find the 2-bit code used to store a given allele at a marker, adding the 
+ * allele to the marker's dictionary if it is new. @see get_allele_code()
+ *
+ * Does not exit on failure, so can be called from inside a parallel region
+ * as long as no other thread is working on the same marker.
+ *
+ * @param d the SimData struct containing the allele dictionary.
+ * @param marker index of the marker the allele belongs to.
+ * @param allele the allele to encode.
+ * @returns the code (0 to 3) for that allele at that marker, or -1 if the 
+ * marker already has three other alleles.
+ */
+int find_allele_code(SimData* d, int marker, char allele) {
+	if (allele == '\0') {
+		return 0;
+	}
+	char* entry = d->allele_dictionary + 3*marker;
+	for (int i = 0; i < 3; ++i) {
+		if (entry[i] == allele) {
+			return i + 1;
+		} else if (entry[i] == '\0') {
+			entry[i] = allele;
+			return i + 1;
+		}
+	}
+	return -1;
+}
+
 
 /** Comparator function for qsort. Used to compare an array of MarkerPosition**
  * @see sort_markers()
@@ -458,32 +1275,35 @@ int _ascending_int_dcomparer(const void* pp0, const void* pp1) {
  * end user - functions which require it should be calling it already.
  *
  * Ideally, we want all AlleleMatrix structs in the SimData's linked list
- * to have no gaps. That is, if there are more than 1000 genotypes, the
- * first AM should be full/contain 1000 genotypes, and so forth, and the 
+ * to have no gaps. That is, if there are more than `d->block_capacity` genotypes, the
+ * first AM should be full/contain `d->block_capacity` genotypes, and so forth, and the 
  * AM at the end should have its n genotypes having indexes < n (so all at
  * the start of the AM with no gaps in-between). 
  *
  * This function achieves the cleanup by using two pointers: a filler out
  * the front that identifies a genotype that needs to be shifted back/that
  * occurs after a gap, and a filler that identifies each gap and copies
- * the genotype at the filler back into it.
+ * the genotype at the filler back into it. Genotypes are copied into the
+ * slab of the AlleleMatrix that holds the gap, growing it if necessary.
  *
  * @param d The SimData struct on which to operate.
  */
 void condense_allele_matrix( SimData* d) {
 	int checker, filler;
+	size_t glen = get_genotype_length(d);
 	AlleleMatrix* checker_m = d->m, *filler_m = d->m;
 	
 	// find the first empty space with filler
 	while (1) {
-		if (filler_m->n_subjects < 1000) {
-			for (filler = 0; filler < 1000; ++filler) {
+		if (filler_m->n_subjects < d->block_capacity) {
+			// slots beyond an AM's allocated capacity count as empty
+			for (filler = 0; filler < filler_m->capacity; ++filler) {
 				// an individual is considered to not exist if it has no genome.
 				if (filler_m->alleles[filler] == NULL) {
 					break; // escape for loop
 				}
 			}
-			// assume we've found one, since n_subjects < 1000.
+			// assume we've found one, since n_subjects < block capacity.
 			break; // escape while loop
 		}
 		
@@ -497,12 +1317,12 @@ void condense_allele_matrix( SimData* d) {
 	
 	// loop through all subjects with checker, shifting them back when we find them.
 	while (1) {
-		for (checker = 0; checker < 1000; ++checker) {
-			if (checker_m->alleles[checker] == NULL) {
+		for (checker = 0; checker < d->block_capacity; ++checker) {
+			if (checker >= checker_m->capacity || checker_m->alleles[checker] == NULL) {
 				// check our filler has a substitute
-				while (filler_m->alleles[filler] == NULL) {
+				while (filler >= filler_m->capacity || filler_m->alleles[filler] == NULL) {
 					++filler;
-					if (filler >= 1000) {
+					if (filler >= filler_m->capacity) {
 						// move to the next AM
 						if (filler_m->next != NULL) {
 							filler_m = filler_m->next;
@@ -514,12 +1334,25 @@ void condense_allele_matrix( SimData* d) {
 				}
 				
 				// put in the substitute
-				checker_m->alleles[checker] = filler_m->alleles[filler];
+				if (checker >= checker_m->capacity) {
+					int new_capacity = checker_m->capacity * 2;
+					if (new_capacity <= checker) { new_capacity = checker + 1; }
+					if (new_capacity > d->block_capacity) { new_capacity = d->block_capacity; }
+					reserve_allelematrix_capacity(d, checker_m, new_capacity);
+				}
+				checker_m->alleles[checker] = checker_m->allele_slab + glen * checker;
+				memcpy(checker_m->alleles[checker], filler_m->alleles[filler], sizeof(char) * glen);
 				filler_m->alleles[filler] = NULL;
 				checker_m->subject_names[checker] = filler_m->subject_names[filler];
 				filler_m->subject_names[filler] = NULL;
 				checker_m->ids[checker] = filler_m->ids[filler];
 				filler_m->ids[filler] = -1;
+				{
+					IdLocation moved = get_location_of_id(d, checker_m->ids[checker]);
+					if (moved.block == filler_m && moved.slot == filler) {
+						set_id_location(d, checker_m->ids[checker], checker_m, checker);
+					}
+				}
 				checker_m->pedigrees[0][checker] = filler_m->pedigrees[0][filler];
 				checker_m->pedigrees[1][checker] = filler_m->pedigrees[1][filler];
 				filler_m->pedigrees[0][filler] = 0;
@@ -559,7 +1392,8 @@ void condense_allele_matrix( SimData* d) {
 		
 		// We're done with the AM, move on to the next one.
 		if (checker_m->next == NULL) {
-			error("During allele matrix condensing, checker got ahead of filler somehow\n");
+			// the last AM was exactly full, so there was nothing left to fill from.
+			return;
 		} else {
 			checker_m = checker_m->next;
 		}
@@ -570,129 +1404,110 @@ void condense_allele_matrix( SimData* d) {
 
 /*----------------------------------Locators---------------------------------*/
 
-/** Returns the name of the genotype with a given id.
+/** Find where the genotype with a given id is stored.
+ *
+ * The location is read from the SimData's id index, so this takes constant 
+ * time however many genotypes are stored, and stays correct after genotypes 
+ * are moved by condense_allele_matrix().
  *
- * The function uses a bisection search on the AlleleMatrix where it should be
- * found. Searching by id is therefore fast.
- * @see get_from_ordered_uint_list()
+ * @param d pointer to the SimData in which to look for the id.
+ * @param id the id of the genotype whose location is sought.
+ * @returns the location of the genotype that has id `id`. Its `block` is NULL 
+ * if no genotype with that id is currently stored in `d`.
+ */
+IdLocation get_location_of_id( const SimData* d, unsigned int id) {
+	if (id > 0 && id < d->id_index_capacity) {
+		return d->id_index[id];
+	}
+	IdLocation none = { .block = NULL, .slot = 0 };
+	return none;
+}
+
+/** Convert the location of a genotype to its index, by counting the genotypes
+ * stored in the AlleleMatrix blocks before it.
  *
- * This function assumes that ids are never reshuffled in the SimData. As of 
- * 2021.04.12 this condition is always true, but this function will need to 
- * be revisited if this is no longer the case.
+ * @param d pointer to the SimData in which the genotype is stored.
+ * @param loc the location of the genotype, eg from get_location_of_id(). Its 
+ * `block` must be part of `d`.
+ * @returns the index (0-based, starting at the start of `d->m`) of the genotype.
+ */
+int get_index_of_location( const SimData* d, IdLocation loc) {
+	int index = loc.slot;
+	for (AlleleMatrix* m = d->m; m != loc.block; m = m->next) {
+		index += m->n_subjects;
+	}
+	return index;
+}
+
+/** Returns the name of the genotype with a given id.
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the genotype with the provided id is assumed to be found.
+ * The genotype is found using the SimData's id index. @see get_location_of_id()
+ * If it has been deleted, the name recorded in `d->deleted_pedigrees` is returned.
+ *
+ * @param d pointer to the SimData in which the genotype with the provided id 
+ * is assumed to be found.
  * @param id the id of the genotype whose name is sought
  * @returns the name of the genotype that has id `id`, as a copy of the pointer
  * to the heap memory where the name is saved (so *don't* free the pointer returned
  * from this function)
  */
-char* get_name_of_id( AlleleMatrix* start, unsigned int id) {
+char* get_name_of_id( SimData* d, unsigned int id) {
 	if (id <= 0) {
 		warning("Invalid negative ID %d\n", id);
 		return NULL;	
 	}
-	if (start == NULL) {
+	if (d->m == NULL) {
 		error("Invalid nonexistent allelematrix\n");
 	}
-	AlleleMatrix* m = start;
 	
-	while (1) {
-		// try to find our id. Does this AM have the right range for it?
-		if (m->n_subjects != 0 && id >= m->ids[0] && id <= m->ids[m->n_subjects - 1]) {
-			// perform binary search to find the exact index.
-			int index = get_from_ordered_uint_list(id, m->ids, m->n_subjects);
-			
-			if (index < 0) {
-				// search failed
-				if (m->next == NULL) {
-					error("Could not find the ID %d\n", id);
-				} else {
-					m = m->next;
-				}
-			}
-			
-			return m->subject_names[index];
-
-		}
-		
-		if (m->next == NULL) {
-			error("Could not find the ID %d\n", id);
-		} else {
-			m = m->next;
+	IdLocation loc = get_location_of_id(d, id);
+	if (loc.block == NULL) {
+		unsigned int parents[2];
+		const char* name;
+		if (get_from_pedigree_table(&(d->deleted_pedigrees), id, parents, &name)) {
+			return (char*) name;
 		}
-	}	
+		error("Could not find the ID %d\n", id);
+	}
+	return loc.block->subject_names[loc.slot];
 }
 
 /** Returns the alleles at each marker of the genotype with a given id.
  *
- * The function uses a bisection search on the AlleleMatrix where it should be
- * found. Searching by id is therefore fast.
- * @see get_from_ordered_uint_list()
- *
- * This function assumes that ids are never reshuffled in the SimData. As of 
- * 2021.04.12 this condition is always true, but this function will need to 
- * be revisited if this is no longer the case.
+ * The genotype is found using the SimData's id index. @see get_location_of_id()
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the genotype with the provided id is assumed to be found.
+ * @param d pointer to the SimData in which the genotype with the provided id 
+ * is assumed to be found.
  * @param id the id of the genotype whose alleles are sought
  * @returns the alleles of the genotype that has id `id`, as a copy of the pointer
  * to the heap memory where the genotype is saved (so *don't* free the pointer returned
  * from this function). It points to a sequence of characters, ordered according to
  * the markers in the SimData to which the AlleleMatrix belongs.
  */
-char* get_genes_of_id ( AlleleMatrix* start, unsigned int id) {
+char* get_genes_of_id ( SimData* d, unsigned int id) {
 	if (id <= 0) {
 		warning("Invalid negative ID %d\n", id);
 		return NULL;
 	}
-	if (start == NULL) {
+	if (d->m == NULL) {
 		error("Invalid nonexistent allelematrix\n");
 	}
-	AlleleMatrix* m = start;
 	
-	while (1) {
-		// try to find our id. Does this AM have the right range for it?
-		if (m->n_subjects != 0 && id >= m->ids[0] && id <= m->ids[m->n_subjects - 1]) {
-			// perform binary search to find the exact index.
-			int index = get_from_ordered_uint_list(id, m->ids, m->n_subjects);
-			
-			if (index < 0) {
-				// search failed
-				if (m->next == NULL) {
-					error("Could not find the ID %d\n", id);
-				} else {
-					m = m->next;
-					continue;
-				}
-			}
-			
-			return m->alleles[index];
-
-		}
-		
-		if (m->next == NULL) {
-			error("Could not find the ID %d\n", id);
-		} else {
-			m = m->next;
-		}
-	}		
+	IdLocation loc = get_location_of_id(d, id);
+	if (loc.block == NULL) {
+		error("Could not find the ID %d\n", id);
+	}
+	return loc.block->alleles[loc.slot];
 }
 
 /** Saves the ids of the parents of a genotype with a particular id to
  * the output array `output`. 
  *
- * The function uses a bisection search on the AlleleMatrix where it should be
- * found. Searching by id is therefore fast.
- * @see get_from_ordered_uint_list()
- *
- * This function assumes that ids are never reshuffled in the SimData. As of 
- * 2021.04.12 this condition is always true, but this function will need to 
- * be revisited if this is no longer the case.
+ * The genotype is found using the SimData's id index. @see get_location_of_id()
+ * If it has been deleted, the parents recorded in `d->deleted_pedigrees` are used.
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the genotype with the provided id is assumed to be found.
+ * @param d pointer to the SimData in which the genotype with the provided id 
+ * is assumed to be found.
  * @param id the id of the genotype whose parents are sought
  * @param output An array which the calling function can access where this function
  * will put its results.
@@ -700,182 +1515,147 @@ char* get_genes_of_id ( AlleleMatrix* start, unsigned int id) {
  * id is known, 1 otherwise. The ids of both parents if at least one parent is 
  * known/nonzero are saved to the array `output`.
  */
-int get_parents_of_id( AlleleMatrix* start, unsigned int id, unsigned int output[2]) {
+int get_parents_of_id( SimData* d, unsigned int id, unsigned int output[2]) {
 	if (id <= 0) {
 		return 1;	
 	}
-	if (start == NULL) {
+	if (d->m == NULL) {
 		error("Invalid nonexistent allelematrix\n");
 	}
-	AlleleMatrix* m = start;
-	while (1) {
-		// try to find our id. Does this AM have the right range for it?
-		if (m->n_subjects != 0 && id >= m->ids[0] && id <= m->ids[m->n_subjects - 1]) {
-			// perform binary search to find the exact index.
-			int index = get_from_ordered_uint_list(id, m->ids, m->n_subjects);
-			
-			if (index < 0) {
-				// search failed
-				if (m->next == NULL) {
-					error("Could not find the ID %d\n", id);
-				} else {
-					m = m->next;
+	
+	IdLocation loc = get_location_of_id(d, id);
+	if (loc.block == NULL) {
+		const char* name;
+		if (get_from_pedigree_table(&(d->deleted_pedigrees), id, output, &name)) {
+			return (output[0] > 0 || output[1] > 0) ? 0 : 1;
+		}
+		error("Could not find the ID %d\n", id);
+	}
+	if (loc.block->pedigrees[0][loc.slot] > 0 || loc.block->pedigrees[1][loc.slot] > 0) {
+		output[0] = loc.block->pedigrees[0][loc.slot];
+		output[1] = loc.block->pedigrees[1][loc.slot];
+		return 0;
+	} 
+	return 1; // if neither parent's id is known
+}
+
+/** Find the id of the genotype with a given name.
+ *
+ * Uses the SimData's name hash table, building it first if it does not exist
+ * yet, so this takes constant time per lookup. If several genotypes share the
+ * name, the id of the first in the SimData is returned.
+ *
+ * @param d pointer to the SimData in which to look for the name.
+ * @param name the name of the genotype whose id is sought.
+ * @returns the id of the genotype named `name`, or 0 if there is none.
+ */
+unsigned int get_id_of_name( SimData* d, const char* name) {
+	if (d->name_index.n_entries == 0) {
+		for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+			for (int i = 0; i < m->n_subjects; ++i) {
+				if (m->subject_names[i] == NULL || m->ids[i] <= 0) {
+					continue;
+				}
+				// genotypes whose ids were not allocated by the SimData are left out
+				IdLocation loc = get_location_of_id(d, m->ids[i]);
+				if (loc.block == m && loc.slot == i) {
+					add_to_string_index(&(d->name_index), m->subject_names[i], (int) m->ids[i]);
 				}
 			}
-			
-			if (m->pedigrees[0][index] > 0 || m->pedigrees[1][index] > 0) {
-				output[0] = m->pedigrees[0][index];
-				output[1] = m->pedigrees[1][index];
-				return 0;
-			} 
-			return 1; // if neither parent's id is known
-
-		}
-		
-		if (m->next == NULL) {
-			error("Could not find the ID %d\n", id);
-		} else {
-			m = m->next;
 		}
-	}	
+	}
+	int id = get_from_string_index(&(d->name_index), name);
+	return (id < 0) ? 0 : (unsigned int) id;
 }
 
-/** Search for genotypes with certain names in a linked list of AlleleMatrix and
- * save the ids of those names. Exits if any name cannot be found.
+/** Search for genotypes with certain names in a SimData and save the ids of 
+ * those names. Exits if any name cannot be found.
  *
- * This function must check every name in the linked list for matches, so will be 
- * relatively slow.
+ * Names are looked up in the SimData's name hash table. @see get_id_of_name()
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the genotype with the provided id is assumed to be found.
+ * @param d pointer to the SimData in which the genotypes are assumed to be found.
  * @param n_names the length of the array of names which are being sought.
  * @param names an array of names whose ids are being sought.
  * @param output pointer to an array of length at least `n_names` which can
  * be accessed by the calling function. The ids of each name are saved to corresponding
  * indexes in the array this pointer points to.
  */
-void get_ids_of_names( AlleleMatrix* start, int n_names, char* names[n_names], unsigned int* output) {
-	int found;
-	//int ids = malloc(sizeof(int) * n_names);
-	AlleleMatrix* m = start;
-	int i, j;
-	
-	for (i = 0; i < n_names; ++i) {
-		found = FALSE;
-		output[i] = -1;
-		while (1) {
-			// try to identify the name in this AM
-			for (j = 0; j < m->n_subjects; ++j) {
-				if (strcmp(m->subject_names[j], names[i]) == 0) {
-					found = TRUE;
-					output[i] = m->ids[j];
-					break;
-				}
-			}
-			
-			if (found) {
-				break;
-			}
-			if ((m = m->next) == NULL) {
-				error("Didn't find the name %s\n", names[i]);
-				break;
-			}
+void get_ids_of_names( SimData* d, int n_names, char* names[n_names], unsigned int* output) {
+	for (int i = 0; i < n_names; ++i) {
+		output[i] = get_id_of_name(d, names[i]);
+		if (output[i] == 0) {
+			error("Didn't find the name %s\n", names[i]);
 		}
 	}
 }
 
-/** Search for a genotype with parentage matching two given parent ids in a linked 
- * list of AlleleMatrix, and return its id. Exits if such a child cannot be found.
+/** Find the id of a genotype whose parents are the two given ids.
  *
- * This function must check every genotype in the linked list for matches, so will be 
- * relatively slow.
+ * Uses the SimData's child hash table, building it first if it does not 
+ * exist yet, so this takes constant time per lookup. The order of the 
+ * parents does not matter.
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the child is assumed to be found.
+ * @param d pointer to the SimData in which to look for the child.
  * @param parent1id one of the parents of the genotype must have this id.
  * @param parent2id the other parent of the genotype must have this id.
  * @returns the id of the first sequentially located genotype whose parents match the
- * two parent ids provided
+ * two parent ids provided, or 0 if there is no such genotype.
  */
-unsigned int get_id_of_child( AlleleMatrix* start, unsigned int parent1id, unsigned int parent2id) {
-	AlleleMatrix* m = start;
-	int j;
-	
-	while (1) {
-		// try to identify the child in this AM
-		for (j = 0; j < m->n_subjects; ++j) {
-			if ((parent1id == m->pedigrees[0][j] && parent2id == m->pedigrees[1][j]) || 
-					(parent1id == m->pedigrees[1][j] && parent2id == m->pedigrees[0][j])) {
-				return m->ids[j];
+unsigned int get_id_of_child( SimData* d, unsigned int parent1id, unsigned int parent2id) {
+	if (d->child_index.capacity == 0) {
+		d->child_index = create_pair_index(1);
+		for (AlleleMatrix* m = d->m; m != NULL; m = m->next) {
+			for (int i = 0; i < m->n_subjects; ++i) {
+				if (m->ids[i] <= 0) {
+					continue;
+				}
+				// genotypes whose ids were not allocated by the SimData are left out
+				IdLocation loc = get_location_of_id(d, m->ids[i]);
+				if (loc.block == m && loc.slot == i) {
+					add_to_pair_index(&(d->child_index), m->pedigrees[0][i], m->pedigrees[1][i], m->ids[i]);
+				}
 			}
 		}
-
-		if ((m = m->next) == NULL) {
-			error("Didn't find the child of %d & %d\n", parent1id, parent2id);
-		}
 	}
+	return get_from_pair_index(&(d->child_index), parent1id, parent2id);
 }
 
-/** Search for a genotype with parentage matching two given parent ids in a linked 
- * list of AlleleMatrix, and return its index. Exits if such a child cannot be found.
+/** Find the index of a genotype whose parents are the two given ids.
+ * @see get_id_of_child()
  *
- * This function must check every genotype in the linked list for matches, so will be 
- * relatively slow.
- *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the child is assumed to be found.
+ * @param d pointer to the SimData in which to look for the child.
  * @param parent1id one of the parents of the genotype must have this id.
  * @param parent2id the other parent of the genotype must have this id.
- * @returns the index (0-based, starting at the start of `start`) of the first sequentially 
- * located genotype whose parents match the two parent ids provided
+ * @returns the index (0-based, starting at the start of `d->m`) of the first sequentially 
+ * located genotype whose parents match the two parent ids provided, or -1 if 
+ * there is no such genotype.
  */
-int get_index_of_child( AlleleMatrix* start, unsigned int parent1id, unsigned int parent2id) {
-	AlleleMatrix* m = start;
-	int j, total_j = 0;
-	
-	while (1) {
-		// try to identify the child in this AM
-		for (j = 0; j < m->n_subjects; ++j, ++total_j) {
-			if ((parent1id == m->pedigrees[0][j] && parent2id == m->pedigrees[1][j]) || 
-					(parent1id == m->pedigrees[1][j] && parent2id == m->pedigrees[0][j])) {
-				return total_j;
-			}
-		}
-
-		if ((m = m->next) == NULL) {
-			error( "Didn't find the child of %d & %d\n", parent1id, parent2id);
-		}
+int get_index_of_child( SimData* d, unsigned int parent1id, unsigned int parent2id) {
+	IdLocation loc = get_location_of_id(d, get_id_of_child(d, parent1id, parent2id));
+	if (loc.block == NULL) {
+		return -1;
 	}
+	return get_index_of_location(d, loc);
 }
 
-/** Search for a genotype with a particular name in a linked 
- * list of AlleleMatrix, and return its index. Exits if such a child cannot be found.
+/** Search for a genotype with a particular name in a SimData, and return 
+ * its index. Exits if such a genotype cannot be found.
  *
- * This function must check every genotype in the linked list for matches, so will be 
- * relatively slow.
+ * The name is looked up in the SimData's name hash table, and its index is
+ * then found from the id index by counting the genotypes in earlier 
+ * AlleleMatrix blocks. @see get_id_of_name()
  *
- * @param start Pointer to the first of a linked list of AlleleMatrixes in which
- * the genotype is assumed to be found.
+ * @param d pointer to the SimData in which the genotype is assumed to be found.
  * @param name a string to match to the subject_name of the target
- * @returns the index (0-based, starting at the start of `start`) of the first sequentially 
+ * @returns the index (0-based, starting at the start of `d->m`) of the first sequentially 
  * located genotype whose name is the same as the provided name.
  */
-int get_index_of_name( AlleleMatrix* start, char* name) {
-	AlleleMatrix* m = start;
-	int j, total_j = 0;
-	
-	while (1) {
-		// try to identify the child in this AM
-		for (j = 0; j < m->n_subjects; ++j, ++total_j) {
-			if (strcmp(m->subject_names[j], name) == 0) {
-				return total_j;
-			}
-		}
-
-		if ((m = m->next) == NULL) {
-			error( "Didn't find the name %s\n", name);
-		}
+int get_index_of_name( SimData* d, char* name) {
+	IdLocation loc = get_location_of_id(d, get_id_of_name(d, name));
+	if (loc.block == NULL) {
+		error( "Didn't find the name %s\n", name);
 	}
+	return get_index_of_location(d, loc);
 }
 
 /** Get the id of a genotype by its index. The index is assumed to be 0-based, 
@@ -1505,14 +2285,23 @@ void delete_group(SimData* d, int group_id) {
 		
 		for (i = 0, deleted = 0; i < m->n_subjects; ++i) {
 			if (m->groups[i] == group_id) {
-				// delete data
+				// genotypes generated without ids of their own (will_allocate_ids
+				// FALSE) carry ids that belong to someone else, so only the owner 
+				// of an id keeps its pedigree for its descendants.
+				IdLocation loc = get_location_of_id(d, m->ids[i]);
+				int owns_id = (loc.block == m && loc.slot == i);
+				if (owns_id) {
+					add_to_pedigree_table(&(d->deleted_pedigrees), m->ids[i], 
+							m->pedigrees[0][i], m->pedigrees[1][i], m->subject_names[i]);
+				}
 				if (m->subject_names[i] != NULL) {
 					free(m->subject_names[i]);
 					m->subject_names[i] = NULL;
 				}
-				if (m->alleles[i] != NULL) {
-					free(m->alleles[i]);
-					m->alleles[i] = NULL;
+				// the genotype's storage stays part of the slab.
+				m->alleles[i] = NULL;
+				if (owns_id) {
+					set_id_location(d, m->ids[i], NULL, 0);
 				}
 				++deleted;
 			}
@@ -1521,6 +2310,10 @@ void delete_group(SimData* d, int group_id) {
 		total_deleted += deleted;
 	
 		if (m->next == NULL) {
+			// the deleted names have been freed, so can't stay in the name index,
+			// and deleted children can't stay in the child index.
+			delete_string_index(&(d->name_index));
+			delete_pair_index(&(d->child_index));
 			condense_allele_matrix( d );
 			Rprintf("%d genotypes were deleted\n", total_deleted);
 			return;
@@ -1568,22 +2361,34 @@ void delete_allele_matrix(AlleleMatrix* m) {
 	AlleleMatrix* next;
 	do {
 		/* free the big data matrix */
-		if (m->alleles != NULL) {
-			for (int i = 0; i < m->n_subjects; i++) {
-				if (m->alleles[i] != NULL) {
-					free(m->alleles[i]);
-				}
-				
-			}
+		if (m->allele_slab != NULL && !m->slab_is_borrowed) {
+			free(m->allele_slab);
 		}
 		
 		// free subject names
 		if (m->subject_names != NULL) {
-			for (int i = 0; i < m->n_subjects; i++) {
+			for (int i = 0; i < m->capacity; i++) {
 				if (m->subject_names[i] != NULL) {
 					free(m->subject_names[i]);
 				}
 			}
+			free(m->subject_names);
+		}
+		
+		if (m->alleles != NULL) {
+			free(m->alleles);
+		}
+		if (m->ids != NULL) {
+			free(m->ids);
+		}
+		if (m->pedigrees[0] != NULL) {
+			free(m->pedigrees[0]);
+		}
+		if (m->pedigrees[1] != NULL) {
+			free(m->pedigrees[1]);
+		}
+		if (m->groups != NULL) {
+			free(m->groups);
 		}
 		
 		next = m->next;
@@ -1628,8 +2433,19 @@ void delete_simdata(SimData* m) {
 	delete_genmap(&(m->map));
 	delete_effect_matrix(&(m->e));
 	
-	// free tables of alleles across generations
+	// free tables of alleles across generations, then the file they may borrow from
 	delete_allele_matrix(m->m);
+	close_mapped_file(&(m->snapshot));
+	if (m->allele_dictionary != NULL) {
+		free(m->allele_dictionary);
+	}
+	if (m->id_index != NULL) {
+		free(m->id_index);
+	}
+	delete_string_index(&(m->marker_index));
+	delete_string_index(&(m->name_index));
+	delete_pair_index(&(m->child_index));
+	delete_pedigree_table(&(m->deleted_pedigrees));
 	
 	//m->current_id = 0;
 	free(m);
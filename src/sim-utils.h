@@ -2,12 +2,22 @@
 #define SIM_UTILS_H
 
 #include <string.h>
+#include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
+#include <zlib.h>
 #include <R.h>
 #include <Rinternals.h>
 #include <Rmath.h>
 #include <R_ext/Utils.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #define TRUE 1
 #define FALSE 0
 
@@ -37,6 +47,91 @@ typedef struct {
 	int** markers_in_block;
 } MarkerBlocks;
 
+/** An open-addressing hash table from strings to integers, used to look up
+ * names (eg of markers) in constant time instead of scanning a list.
+ *
+ * The table does not own its keys: they are pointers to strings stored 
+ * elsewhere (eg `SimData.markers`) which must outlive the table.
+ *
+ * @param capacity the number of slots in the table. Always zero or a power of two.
+ * @param n_entries the number of keys stored in the table.
+ * @param keys heap array of `capacity` pointers to the stored keys, with NULL
+ * marking an empty slot.
+ * @param values heap array of `capacity` values, one for each slot of `keys`.
+ */
+typedef struct {
+	unsigned int capacity;
+	unsigned int n_entries;
+	const char** keys;
+	int* values;
+} StringIndex;
+
+/** An open-addressing hash table from unordered pairs of parent ids to the 
+ * id of a child of that pair, used to find the offspring of a cross without 
+ * scanning every pedigree.
+ *
+ * Each pair is stored as one 64-bit key, with the smaller id in the high 32 bits.
+ * A key of 0 marks an empty slot, so the pair (0,0) of unknown parents is 
+ * never stored.
+ *
+ * @param capacity the number of slots in the table. Zero if the table has not 
+ * been built, otherwise a power of two.
+ * @param n_entries the number of keys stored in the table.
+ * @param keys heap array of `capacity` pair keys.
+ * @param values heap array of `capacity` child ids, one for each slot of `keys`.
+ */
+typedef struct {
+	unsigned int capacity;
+	unsigned int n_entries;
+	uint64_t* keys;
+	unsigned int* values;
+} PairIndex;
+
+/** Value of PedigreeTable.name_offsets for an id that has no record. */
+#define PEDIGREE_UNRECORDED UINT_MAX
+/** Value of PedigreeTable.name_offsets for a recorded genotype with no name. */
+#define PEDIGREE_UNNAMED (UINT_MAX - 1)
+
+/** An append-only record of the parents and names of genotypes that have been
+ * deleted from a SimData, so that the pedigrees of their descendants can still
+ * be traced. A record costs 12 bytes plus the length of the genotype's name,
+ * instead of a whole genotype. Records are never removed.
+ *
+ * @param capacity the length of the arrays indexed by id. Ids at or beyond
+ * it have no record.
+ * @param parents two heap arrays indexed by id, giving the ids of the two 
+ * parents of each recorded genotype (0 if unknown).
+ * @param name_offsets heap array indexed by id, giving the position in `names`
+ * of each recorded genotype's name, or PEDIGREE_UNNAMED or PEDIGREE_UNRECORDED.
+ * @param names heap buffer of the recorded names, one after another, each 
+ * null-terminated.
+ * @param names_length the number of characters used in `names`.
+ * @param names_capacity the size of `names`.
+ */
+typedef struct {
+	unsigned int capacity;
+	unsigned int* parents[2];
+	unsigned int* name_offsets;
+	char* names;
+	size_t names_length;
+	size_t names_capacity;
+} PedigreeTable;
+
+/** The whole contents of a file, held in memory for parsing. 
+ * @see open_mapped_file()
+ *
+ * @param data pointer to the first of `length` bytes of the file. Not 
+ * null-terminated. NULL if the file is empty.
+ * @param length the number of bytes in the file.
+ * @param is_mapped TRUE if `data` is a memory mapping of the file, FALSE if
+ * it is a heap copy.
+ */
+typedef struct {
+	const char* data;
+	size_t length;
+	int is_mapped;
+} MappedFile;
+
 /** A simple struct used for returning the dimensions of a matrix or table.*/
 struct TableSize {
 	int num_columns;
@@ -89,6 +184,11 @@ typedef struct {
  * even if the genotypes are not later saved to SimData.
  * @param will_save_to_simdata a boolean. If true, the offspring are retained in the 
  * SimData as a new group. If false, they are discarded after creation.
+ * @param will_compress_files a boolean. If true, the save-as-you-go files are 
+ * gzip-compressed, and ".gz" is added to the end of their names.
+ * @param n_threads the number of threads to use to generate offspring genotypes,
+ * if the package was built with OpenMP support. The offspring produced are the same
+ * whatever the number of threads.
 */
 typedef struct {
 	int will_name_subjects;
@@ -104,6 +204,9 @@ typedef struct {
 	int will_save_effects_to_file;
 	int will_save_genes_to_file;
 	int will_save_to_simdata;
+	int will_compress_files;
+	
+	int n_threads;
 } GenOptions;
 
 
@@ -147,10 +250,22 @@ typedef struct {
  * and subjects.
  *
  * @param alleles a matrix of SNP markers by subjects containing pairs of alleles
- * eg TT, TA. Use `alleles[subject index][marker index * 2]` to get the first allele
- * and `alleles[subject index][marker index * 2 + 1]` to get the second. In usual use
- * the char** alleles will point to an 1000-ptr-long piece of heap memory, and if you
- * need to add more than 100 subjects you will add another AlleleMatrix to the linked list
+ * eg TT, TA. Use `get_allele(d, alleles[subject index], marker index, 0)` to get the 
+ * first allele and `get_allele(d, alleles[subject index], marker index, 1)` to get the 
+ * second, as the storage format depends on the SimData's settings. Each non-NULL 
+ * `alleles[i]` points into `allele_slab`, at offset i * get_genotype_length(d). A
+ * NULL entry marks an empty slot. If you need to add more than `d->block_capacity` 
+ * subjects you will add another AlleleMatrix to the linked list
+ * @param allele_slab one contiguous heap block holding the genotypes of every slot 
+ * of this matrix, `capacity` genotypes long. Owned by the AlleleMatrix, unless
+ * `slab_is_borrowed` is set.
+ * @param slab_is_borrowed TRUE if `allele_slab` points into memory owned by 
+ * someone else (eg `SimData.snapshot`) and must not be freed or reallocated. 
+ * It is replaced by an owned copy the first time the AlleleMatrix is grown.
+ * @param capacity number of slots allocated for each of the per-genotype arrays
+ * (`alleles`, `subject_names`, `ids`, `pedigrees`, `groups`) and `allele_slab`.
+ * Slots at or beyond this index are empty and have no storage until 
+ * reserve_allelematrix_capacity() is called. Never more than `d->block_capacity`.
  * @param subject_names array of strings containing the names of the lines/subjects
  * whose data is stored in `alleles`. NULL if they do not have names.
  * @param ids unique ids for each subject in the matrix. If you use a creator function,
@@ -165,17 +280,33 @@ typedef struct {
 typedef struct AlleleMatrix AlleleMatrix;
 struct AlleleMatrix {
 	
-	char* alleles[1000];
-	char* subject_names[1000];
-	unsigned int ids[1000];
+	char** alleles;
+	char** subject_names;
+	unsigned int* ids;
 	int n_subjects;
 	int n_markers; // slight redundancy but allows this to stand alone
 	
-	unsigned int pedigrees[2][1000]; 
-	unsigned int groups[1000];
+	char* allele_slab;
+	int slab_is_borrowed;
+	int capacity;
+	
+	unsigned int* pedigrees[2]; 
+	unsigned int* groups;
 	AlleleMatrix* next;
 };
 
+/** The location of one genotype in a SimData's linked list of AlleleMatrix.
+ * @see SimData.id_index
+ *
+ * @param block pointer to the AlleleMatrix in which the genotype is stored, 
+ * or NULL if no genotype with this id is currently stored.
+ * @param slot the index of the genotype within `block`.
+ */
+typedef struct {
+	AlleleMatrix* block;
+	int slot;
+} IdLocation;
+
 /** A type that stores a matrix of effect values and their names.
  *
  * @param effects the effect of each marker. rows correspond to `effect_names`
@@ -202,6 +333,43 @@ typedef struct {
  * @param e EffectMatrix containing the effects at all markers.
  * @param current_id integer denoting the highest id that has been allocated to a 
  * subject. Used to track where we are in generating unique ids.
+ * @param packed_alleles a boolean. If FALSE, each allele in the AlleleMatrix genotypes
+ * is stored as a char. If TRUE, each allele is stored as a 2-bit code that indexes
+ * `allele_dictionary`, which cuts genotype memory use by a factor of 4. Must be set 
+ * before any genotypes are loaded. Genotypes should always be read and written through
+ * the accessor functions (get_allele(), set_allele(), copy_allele()) so that both
+ * storage modes are supported.
+ * @param allele_dictionary if `packed_alleles` is TRUE, a heap array of 3 chars per
+ * marker. The alleles with codes 1, 2 and 3 at marker i are found at indexes 3i, 
+ * 3i+1 and 3i+2. Code 0 is reserved for a missing/unloaded allele. Filled in by 
+ * the loaders as new alleles are encountered. NULL if `packed_alleles` is FALSE.
+ * @param block_capacity the greatest number of genotypes stored in any one 
+ * AlleleMatrix of the linked list `m`. Defaults to 1000. Larger values mean fewer
+ * list entries to step through for large populations. Must be set before any
+ * genotypes are loaded.
+ * @param n_threads the number of threads the genotype loaders may use to parse 
+ * rows of a file in parallel, and the GEBV calculators may use to score genotypes
+ * in parallel. Defaults to 1. Has no effect if the package was built without OpenMP.
+ * @param id_index heap array indexed by id, giving the location of the genotype
+ * with each id in `m`, so that genotypes can be found by id without searching.
+ * Kept up to date by set_subject_ids(), the crossers, delete_group() and 
+ * condense_allele_matrix(). @see get_location_of_id()
+ * @param id_index_capacity the length of `id_index`.
+ * @param marker_index hash table from each name in `markers` to its index. Built
+ * the first time it is needed by get_index_of_marker(), and cleared whenever 
+ * `markers` is replaced or reordered.
+ * @param name_index hash table from genotype names to ids. Built the first time
+ * it is needed by get_id_of_name(), extended as the crossers add named genotypes,
+ * and cleared when genotypes are loaded or deleted.
+ * @param snapshot the memory-mapped snapshot file this SimData was loaded from,
+ * if any. The genotypes of the loaded AlleleMatrix blocks are borrowed from it, 
+ * so it stays open until the SimData is deleted. @see load_simdata_snapshot()
+ * @param child_index hash table from pairs of parent ids to the id of their
+ * first child. Built the first time it is needed by get_id_of_child(), extended
+ * as the crossers add genotypes, and cleared when genotypes are deleted.
+ * @param deleted_pedigrees the parents and names of every genotype deleted by 
+ * delete_group(), which get_name_of_id() and get_parents_of_id() fall back on
+ * for ids no longer in `m`.
  */
 typedef struct {
 	int n_markers;
@@ -212,22 +380,65 @@ typedef struct {
 	EffectMatrix e;
 	
 	unsigned int current_id;
+	
+	int packed_alleles;
+	char* allele_dictionary;
+	
+	int block_capacity;
+	int n_threads;
+	
+	IdLocation* id_index;
+	unsigned int id_index_capacity;
+	
+	StringIndex marker_index;
+	StringIndex name_index;
+	PairIndex child_index;
+	
+	PedigreeTable deleted_pedigrees;
+	
+	MappedFile snapshot;
 } SimData; 
 
 const GenOptions BASIC_OPT;
 
 void* get_malloc(size_t size);
+void* get_realloc(void* ptr, size_t size);
 
-AlleleMatrix* create_empty_allelematrix(int n_markers, int n_subjects);
+AlleleMatrix* create_empty_allelematrix(const SimData* d, int n_subjects);
+void reserve_allelematrix_capacity(const SimData* d, AlleleMatrix* m, int capacity);
 SimData* create_empty_simdata();
+void create_allele_dictionary(SimData* d);
 
 /* Supporters */
 void set_subject_ids(SimData* d, int from_index, int to_index);
 struct TableSize get_file_dimensions(const char* filename, char sep);
+MappedFile open_mapped_file(const char* filename);
+void close_mapped_file(MappedFile* f);
+int has_file_extension(const char* filename, const char* extension);
+gzFile open_input_file(const char* filename);
+int read_file_word(gzFile f, char* word, int max_length);
+gzFile open_output_file(const char* filename, int compress);
 int get_from_ordered_uint_list(unsigned int target, unsigned int* list, unsigned int list_len);
 int get_from_unordered_str_list(char* target, char** list, int list_len) ;
+StringIndex create_string_index(unsigned int expected_entries);
+void add_to_string_index(StringIndex* t, const char* key, int value);
+int get_from_string_index(const StringIndex* t, const char* key);
+void delete_string_index(StringIndex* t);
+PairIndex create_pair_index(unsigned int expected_entries);
+void add_to_pair_index(PairIndex* t, unsigned int id1, unsigned int id2, unsigned int value);
+unsigned int get_from_pair_index(const PairIndex* t, unsigned int id1, unsigned int id2);
+void delete_pair_index(PairIndex* t);
+PedigreeTable create_pedigree_table();
+void add_to_pedigree_table(PedigreeTable* t, unsigned int id, unsigned int parent1, 
+		unsigned int parent2, const char* name);
+int get_from_pedigree_table(const PedigreeTable* t, unsigned int id, unsigned int parents[2], 
+		const char** name);
+void delete_pedigree_table(PedigreeTable* t);
+int get_index_of_marker(SimData* d, const char* name);
 void set_subject_names(AlleleMatrix* a, const char* prefix, int suffix, int from_index);
 int get_integer_digits(int i);
+unsigned char get_allele_code(SimData* d, int marker, char allele);
+int find_allele_code(SimData* d, int marker, char allele);
 
 int _simdata_pos_compare(const void *pp0, const void *pp1);
 int _descending_double_comparer(const void* pp0, const void* pp1);
@@ -238,14 +449,19 @@ int _ascending_int_dcomparer(const void* pp0, const void* pp1);
 
 void condense_allele_matrix( SimData* d); 
 
+void index_subject_ids(SimData* d, AlleleMatrix* m);
+void rebuild_id_index(SimData* d);
 
-char* get_name_of_id( AlleleMatrix* start, unsigned int id);
-char* get_genes_of_id ( AlleleMatrix* start, unsigned int id);
-int get_parents_of_id( AlleleMatrix* start, unsigned int id, unsigned int output[2]);
-void get_ids_of_names( AlleleMatrix* start, int n_names, char* names[n_names], unsigned int* output);
-unsigned int get_id_of_child( AlleleMatrix* start, unsigned int parent1id, unsigned int parent2id);
-int get_index_of_child( AlleleMatrix* start, unsigned int parent1id, unsigned int parent2id);
-int get_index_of_name( AlleleMatrix* start, char* name);
+IdLocation get_location_of_id( const SimData* d, unsigned int id);
+int get_index_of_location( const SimData* d, IdLocation loc);
+unsigned int get_id_of_name( SimData* d, const char* name);
+char* get_name_of_id( SimData* d, unsigned int id);
+char* get_genes_of_id ( SimData* d, unsigned int id);
+int get_parents_of_id( SimData* d, unsigned int id, unsigned int output[2]);
+void get_ids_of_names( SimData* d, int n_names, char* names[n_names], unsigned int* output);
+unsigned int get_id_of_child( SimData* d, unsigned int parent1id, unsigned int parent2id);
+int get_index_of_child( SimData* d, unsigned int parent1id, unsigned int parent2id);
+int get_index_of_name( SimData* d, char* name);
 unsigned int get_id_of_index( AlleleMatrix* start, int index);
 char* get_genes_of_index( AlleleMatrix* start, int index);
 
@@ -275,4 +491,175 @@ void delete_effect_matrix(EffectMatrix* m);
 void delete_simdata(SimData* m);
 void delete_markerblocks(MarkerBlocks* b);
 
+/* Genotype accessors */
+
+/* Each genotype is stored as two haplotype planes one after the other: the 
+ * first allele at every marker, in marker order, then the second allele at 
+ * every marker. A stretch of consecutive markers from one haplotype is therefore
+ * contiguous in memory. */
+
+/** Get the number of bytes of storage used by one haplotype plane of a genotype.
+ *
+ * @param d pointer to the SimData whose genotypes are being stored.
+ * @returns n_markers if alleles are stored as chars, or the number of bytes
+ * needed to hold n_markers 2-bit codes if `d->packed_alleles` is set.
+ */
+static inline size_t get_haplotype_length(const SimData* d) {
+	if (d->packed_alleles) {
+		return ((size_t) d->n_markers + 3) >> 2;
+	}
+	return (size_t) d->n_markers;
+}
+
+/** Get the number of bytes of storage used by each genotype in an AlleleMatrix.
+ *
+ * @param d pointer to the SimData whose genotypes are being stored.
+ * @returns the length of two haplotype planes. @see get_haplotype_length()
+ */
+static inline size_t get_genotype_length(const SimData* d) {
+	return get_haplotype_length(d) << 1;
+}
+
+/** Get a pointer to the start of one haplotype plane of a genotype.
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype, as returned by get_genes_of_index() or stored 
+ * in AlleleMatrix.alleles.
+ * @param copy 0 for the plane of first alleles, 1 for the plane of second alleles.
+ * @returns pointer into `genes` at the start of the requested plane.
+ */
+static inline char* get_haplotype(const SimData* d, const char* genes, int copy) {
+	return (char*) genes + (copy ? get_haplotype_length(d) : 0);
+}
+
+/** Read the raw stored value of one allele in a genotype. This is the allele 
+ * itself if alleles are stored as chars, or its 2-bit code if `d->packed_alleles`
+ * is set. Most code should use get_allele() instead.
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype, as returned by get_genes_of_index() or stored 
+ * in AlleleMatrix.alleles.
+ * @param marker index of the marker at which to read the allele.
+ * @param copy 0 to read the first allele at that marker, 1 to read the second.
+ * @returns the stored value of that allele.
+ */
+static inline unsigned char get_stored_allele(const SimData* d, const char* genes, int marker, int copy) {
+	const char* plane = get_haplotype(d, genes, copy);
+	if (d->packed_alleles) {
+		return (((unsigned char) plane[marker >> 2]) >> ((marker & 3) << 1)) & 3;
+	}
+	return (unsigned char) plane[marker];
+}
+
+/** Overwrite the raw stored value of one allele in a genotype. 
+ * @see get_stored_allele()
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype to modify.
+ * @param marker index of the marker at which to write the allele.
+ * @param copy 0 to write the first allele at that marker, 1 to write the second.
+ * @param value the char or 2-bit code to store.
+ */
+static inline void set_stored_allele(const SimData* d, char* genes, int marker, int copy, unsigned char value) {
+	char* plane = get_haplotype(d, genes, copy);
+	if (d->packed_alleles) {
+		int shift = (marker & 3) << 1;
+		plane[marker >> 2] = (char) ((((unsigned char) plane[marker >> 2]) & ~(3 << shift)) | (value << shift));
+	} else {
+		plane[marker] = (char) value;
+	}
+}
+
+/** Get one allele from a genotype, whatever the storage mode of the SimData.
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype, as returned by get_genes_of_index() or stored 
+ * in AlleleMatrix.alleles.
+ * @param marker index of the marker at which to read the allele.
+ * @param copy 0 to read the first allele at that marker, 1 to read the second.
+ * @returns the allele as a char, or '\0' if it was never set.
+ */
+static inline char get_allele(const SimData* d, const char* genes, int marker, int copy) {
+	unsigned char v = get_stored_allele(d, genes, marker, copy);
+	if (d->packed_alleles) {
+		return v ? d->allele_dictionary[3*marker + v - 1] : '\0';
+	}
+	return (char) v;
+}
+
+/** Set one allele of a genotype, whatever the storage mode of the SimData.
+ * In packed mode, new alleles are added to the marker's dictionary as needed.
+ *
+ * @param d pointer to the SimData that owns the genotype.
+ * @param genes the genotype to modify.
+ * @param marker index of the marker at which to write the allele.
+ * @param copy 0 to write the first allele at that marker, 1 to write the second.
+ * @param allele the allele to save.
+ */
+static inline void set_allele(SimData* d, char* genes, int marker, int copy, char allele) {
+	if (d->packed_alleles) {
+		set_stored_allele(d, genes, marker, copy, get_allele_code(d, marker, allele));
+	} else {
+		set_stored_allele(d, genes, marker, copy, (unsigned char) allele);
+	}
+}
+
+/** Copy one allele from one genotype to another without decoding it. Both 
+ * genotypes must belong to the same SimData.
+ *
+ * @param d pointer to the SimData that owns both genotypes.
+ * @param dest the genotype to write to.
+ * @param dest_copy 0 or 1, which of the two alleles in `dest` to write.
+ * @param src the genotype to read from.
+ * @param src_copy 0 or 1, which of the two alleles in `src` to read.
+ * @param marker index of the marker at which to copy.
+ */
+static inline void copy_allele(const SimData* d, char* dest, int dest_copy, const char* src, int src_copy, int marker) {
+	set_stored_allele(d, dest, marker, dest_copy, get_stored_allele(d, src, marker, src_copy));
+}
+
+/** Copy the alleles at a run of consecutive markers from one haplotype of a
+ * genotype to one haplotype of another, without decoding them. Both genotypes 
+ * must belong to the same SimData. If alleles are stored as chars this is a 
+ * single contiguous copy. If they are packed, the markers are at the same bit
+ * offsets in both planes, so only the partial bytes at either end of the run
+ * are copied allele by allele and the whole bytes in between are copied directly.
+ *
+ * @param d pointer to the SimData that owns both genotypes.
+ * @param dest the genotype to write to.
+ * @param dest_copy 0 or 1, which of the two haplotypes in `dest` to write.
+ * @param src the genotype to read from.
+ * @param src_copy 0 or 1, which of the two haplotypes in `src` to read.
+ * @param from_marker index of the first marker to copy.
+ * @param to_marker index one past the last marker to copy.
+ */
+static inline void copy_haplotype_segment(const SimData* d, char* dest, int dest_copy, 
+		const char* src, int src_copy, int from_marker, int to_marker) {
+	if (to_marker <= from_marker) {
+		return;
+	}
+	if (d->packed_alleles) {
+		// alleles before the first byte boundary
+		for (; (from_marker & 3) && from_marker < to_marker; ++from_marker) {
+			copy_allele(d, dest, dest_copy, src, src_copy, from_marker);
+		}
+		// whole bytes
+		int whole_end = to_marker & ~3;
+		if (whole_end > from_marker) {
+			memcpy(get_haplotype(d, dest, dest_copy) + (from_marker >> 2),
+					get_haplotype(d, src, src_copy) + (from_marker >> 2),
+					sizeof(char) * ((whole_end - from_marker) >> 2));
+			from_marker = whole_end;
+		}
+		// alleles after the last byte boundary
+		for (; from_marker < to_marker; ++from_marker) {
+			copy_allele(d, dest, dest_copy, src, src_copy, from_marker);
+		}
+	} else {
+		memcpy(get_haplotype(d, dest, dest_copy) + from_marker, 
+				get_haplotype(d, src, src_copy) + from_marker, 
+				sizeof(char) * (to_marker - from_marker));
+	}
+}
+
 #endif
\ No newline at end of file